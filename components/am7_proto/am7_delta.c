@@ -0,0 +1,291 @@
+#include "am7_delta.h"
+#include <string.h>
+
+_Static_assert(AM7_DELTA_BUF_SIZE >= AM7_DELTA_HEADER_LEN, "header is gathered in buf");
+
+enum {
+    ST_HEADER,
+    ST_DIFF_LEN,
+    ST_EXTRA_LEN,
+    ST_SEEK,
+    ST_ZEROS,
+    ST_COUNT,
+    ST_ADD,
+    ST_EXTRA,
+    ST_DONE,
+    ST_ERROR,
+};
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool fail(am7_delta_t *d, am7_delta_err_t err)
+{
+    d->error = err;
+    d->state = ST_ERROR;
+    return false;
+}
+
+void am7_delta_init(am7_delta_t *d, const am7_delta_ops_t *ops, void *ctx)
+{
+    memset(d, 0, sizeof(*d));
+    d->ops = ops;
+    d->ctx = ctx;
+    d->state = ST_HEADER;
+}
+
+bool am7_delta_is_patch(const uint8_t *data, size_t len)
+{
+    return len >= 4 && memcmp(data, AM7_DELTA_MAGIC, 4) == 0;
+}
+
+static bool flush(am7_delta_t *d)
+{
+    if (d->len > 0 && !d->ops->write(d->ctx, d->buf, d->len)) {
+        return fail(d, AM7_DELTA_ERR_IO);
+    }
+    d->len = 0;
+    return true;
+}
+
+// Append n old bytes to the output buffer; the caller keeps n within its room
+static bool take_old(am7_delta_t *d, size_t n)
+{
+    if (!d->ops->read_old(d->ctx, d->old_pos, d->buf + d->len, n)) {
+        return fail(d, AM7_DELTA_ERR_IO);
+    }
+    d->len += n;
+    d->old_pos += n;
+    d->new_pos += n;
+    return true;
+}
+
+// Old bytes copied unchanged
+static bool copy_old(am7_delta_t *d, uint32_t n)
+{
+    while (n > 0) {
+        if (d->len == sizeof(d->buf) && !flush(d)) {
+            return false;
+        }
+        size_t k = sizeof(d->buf) - d->len;
+        if (k > n) {
+            k = n;
+        }
+        if (!take_old(d, k)) {
+            return false;
+        }
+        n -= k;
+    }
+    return true;
+}
+
+static bool parse_header(am7_delta_t *d)
+{
+    const uint8_t *p = d->buf;
+    if (!am7_delta_is_patch(p, d->len)) {
+        return fail(d, AM7_DELTA_ERR_HEADER);
+    }
+    d->header.old_size = get_le32(p + 4);
+    d->header.new_size = get_le32(p + 8);
+    memcpy(d->header.old_sha256, p + 12, 32);
+    memcpy(d->header.new_sha256, p + 44, 32);
+    d->len = 0;
+    if (d->ops->begin && !d->ops->begin(d->ctx, &d->header)) {
+        return fail(d, AM7_DELTA_ERR_BASE);
+    }
+    d->state = d->header.new_size > 0 ? ST_DIFF_LEN : ST_DONE;
+    return true;
+}
+
+// Record finished: move the old position, then the next record or the end
+static bool end_record(am7_delta_t *d)
+{
+    int64_t pos = (int64_t)d->old_pos + d->seek;
+    if (pos < 0 || pos > d->header.old_size) {
+        return fail(d, AM7_DELTA_ERR_CORRUPT);
+    }
+    d->old_pos = (uint32_t)pos;
+    if (d->new_pos < d->header.new_size) {
+        d->state = ST_DIFF_LEN;
+        return true;
+    }
+    d->state = ST_DONE;
+    return flush(d);
+}
+
+static bool next_part(am7_delta_t *d)
+{
+    if (d->diff_left > 0) {
+        d->state = ST_ZEROS;
+        return true;
+    }
+    if (d->extra_left > 0) {
+        d->state = ST_EXTRA;
+        return true;
+    }
+    return end_record(d);
+}
+
+// A record field is complete
+static bool field(am7_delta_t *d, uint32_t v)
+{
+    switch (d->state) {
+        case ST_DIFF_LEN:
+            d->diff_left = v;
+            d->state = ST_EXTRA_LEN;
+            return true;
+        case ST_EXTRA_LEN:
+            d->extra_left = v;
+            d->state = ST_SEEK;
+            return true;
+        case ST_SEEK:
+            d->seek = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+            if ((uint64_t)d->new_pos + d->diff_left + d->extra_left > d->header.new_size ||
+                (uint64_t)d->old_pos + d->diff_left > d->header.old_size) {
+                return fail(d, AM7_DELTA_ERR_CORRUPT);
+            }
+            return next_part(d);
+        case ST_ZEROS:
+            if (v > d->diff_left) {
+                return fail(d, AM7_DELTA_ERR_CORRUPT);
+            }
+            d->diff_left -= v;
+            d->state = ST_COUNT;
+            return copy_old(d, v);
+        case ST_COUNT:
+            if (v > d->diff_left) {
+                return fail(d, AM7_DELTA_ERR_CORRUPT);
+            }
+            d->run_left = v;
+            if (v == 0) {
+                return next_part(d);
+            }
+            d->state = ST_ADD;
+            return true;
+        default:
+            return fail(d, AM7_DELTA_ERR_CORRUPT);
+    }
+}
+
+bool am7_delta_feed(am7_delta_t *d, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        switch (d->state) {
+            case ST_HEADER: {
+                size_t k = AM7_DELTA_HEADER_LEN - d->len;
+                if (k > len) {
+                    k = len;
+                }
+                memcpy(d->buf + d->len, data, k);
+                d->len += k;
+                data += k;
+                len -= k;
+                if (d->len == AM7_DELTA_HEADER_LEN && !parse_header(d)) {
+                    return false;
+                }
+                break;
+            }
+
+            case ST_DIFF_LEN:
+            case ST_EXTRA_LEN:
+            case ST_SEEK:
+            case ST_ZEROS:
+            case ST_COUNT: {
+                uint8_t b = *data++;
+                len--;
+                if (d->shift > 28 || (d->shift == 28 && (b & 0x70))) {
+                    return fail(d, AM7_DELTA_ERR_CORRUPT);
+                }
+                d->value |= (uint32_t)(b & 0x7f) << d->shift;
+                d->shift += 7;
+                if (b & 0x80) {
+                    break;
+                }
+                uint32_t v = d->value;
+                d->value = 0;
+                d->shift = 0;
+                if (!field(d, v)) {
+                    return false;
+                }
+                break;
+            }
+
+            case ST_ADD: {
+                if (d->len == sizeof(d->buf) && !flush(d)) {
+                    return false;
+                }
+                size_t k = sizeof(d->buf) - d->len;
+                if (k > len) {
+                    k = len;
+                }
+                if (k > d->run_left) {
+                    k = d->run_left;
+                }
+                uint8_t *out = d->buf + d->len;
+                if (!take_old(d, k)) {
+                    return false;
+                }
+                for (size_t i = 0; i < k; i++) {
+                    out[i] += data[i];
+                }
+                data += k;
+                len -= k;
+                d->run_left -= k;
+                d->diff_left -= k;
+                if (d->run_left == 0 && !next_part(d)) {
+                    return false;
+                }
+                break;
+            }
+
+            case ST_EXTRA: {
+                if (d->len == sizeof(d->buf) && !flush(d)) {
+                    return false;
+                }
+                size_t k = sizeof(d->buf) - d->len;
+                if (k > len) {
+                    k = len;
+                }
+                if (k > d->extra_left) {
+                    k = d->extra_left;
+                }
+                memcpy(d->buf + d->len, data, k);
+                d->len += k;
+                d->new_pos += k;
+                data += k;
+                len -= k;
+                d->extra_left -= k;
+                if (d->extra_left == 0 && !end_record(d)) {
+                    return false;
+                }
+                break;
+            }
+
+            case ST_DONE:
+                return fail(d, AM7_DELTA_ERR_CORRUPT);   // data past the end
+
+            default:
+                return false;
+        }
+    }
+    return d->state != ST_ERROR;
+}
+
+bool am7_delta_done(const am7_delta_t *d)
+{
+    return d->state == ST_DONE;
+}
+
+const char *am7_delta_strerror(am7_delta_err_t err)
+{
+    switch (err) {
+        case AM7_DELTA_OK: return "ok";
+        case AM7_DELTA_ERR_HEADER: return "not a delta patch";
+        case AM7_DELTA_ERR_BASE: return "patch is for another image";
+        case AM7_DELTA_ERR_CORRUPT: return "corrupt patch";
+        case AM7_DELTA_ERR_IO: return "read or write failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Delta firmware patch (made by host/tools/am7_delta.c), applied as a stream
+// against the image it was made from. bsdiff-style: the new image is built
+// from runs of old bytes with a difference added, which is mostly zero where
+// code only moved, and runs of bytes that are new. The decoder holds one
+// small output buffer; old bytes are read back through a callback.
+//
+// Layout, little-endian, record fields as unsigned LEB128 varints:
+//   header   "AMD1", u32 old_size, u32 new_size, old_sha256[32], new_sha256[32]
+//   records  until new_size bytes are produced:
+//              diff_len, extra_len, seek (zigzag-encoded signed)
+//              diff_len bytes of old data from the old position plus a
+//                difference, as pairs {zeros, count, count bytes}: a run of
+//                unchanged bytes, then count bytes to add
+//              extra_len bytes copied verbatim
+//              then the old position moves by seek
+#define AM7_DELTA_MAGIC "AMD1"
+#define AM7_DELTA_HEADER_LEN 76
+
+#ifndef AM7_DELTA_BUF_SIZE
+#define AM7_DELTA_BUF_SIZE 1024
+#endif
+
+typedef struct {
+    uint32_t old_size;
+    uint32_t new_size;
+    uint8_t old_sha256[32];
+    uint8_t new_sha256[32];
+} am7_delta_header_t;
+
+typedef enum {
+    AM7_DELTA_OK,
+    AM7_DELTA_ERR_HEADER,    // not a patch
+    AM7_DELTA_ERR_BASE,      // begin refused it (made from another image)
+    AM7_DELTA_ERR_CORRUPT,   // record out of range or data past the end
+    AM7_DELTA_ERR_IO,        // read_old or write failed
+} am7_delta_err_t;
+
+typedef struct {
+    // Header parsed, before any output; false refuses the patch
+    bool (*begin)(void *ctx, const am7_delta_header_t *hdr);
+    bool (*read_old)(void *ctx, uint32_t offset, uint8_t *buf, size_t len);
+    bool (*write)(void *ctx, const uint8_t *data, size_t len);
+} am7_delta_ops_t;
+
+typedef struct {
+    am7_delta_header_t header;
+    const am7_delta_ops_t *ops;
+    void *ctx;
+    uint8_t state;
+    uint8_t shift;           // varint being read
+    uint32_t value;
+    uint32_t diff_left;      // of the current record
+    uint32_t extra_left;
+    uint32_t run_left;       // bytes to add in the current pair
+    int64_t seek;
+    uint32_t old_pos;
+    uint32_t new_pos;        // bytes produced, including those in buf
+    size_t len;              // header bytes gathered, then bytes in buf
+    uint8_t buf[AM7_DELTA_BUF_SIZE];
+    am7_delta_err_t error;
+} am7_delta_t;
+
+void am7_delta_init(am7_delta_t *d, const am7_delta_ops_t *ops, void *ctx);
+// Consume patch bytes in pieces of any size; false once an error is set
+bool am7_delta_feed(am7_delta_t *d, const uint8_t *data, size_t len);
+// True when the whole new image has been produced and written
+bool am7_delta_done(const am7_delta_t *d);
+const char *am7_delta_strerror(am7_delta_err_t err);
+
+bool am7_delta_is_patch(const uint8_t *data, size_t len);
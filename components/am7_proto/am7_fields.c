@@ -0,0 +1,124 @@
+#include "am7_fields.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+const am7_field_info_t am7_field_info[AM7_FIELD_COUNT] = {
+    [AM7_FIELD_TEMP]           = {"temp", 1, 100},
+    [AM7_FIELD_HUMIDITY]       = {"humidity", 1, 100},
+    [AM7_FIELD_CO2]            = {"co2", 0, 1},
+    [AM7_FIELD_PM25]           = {"pm25", 0, 1},
+    [AM7_FIELD_PM10]           = {"pm10", 0, 1},
+    [AM7_FIELD_TVOC]           = {"tvoc", 2, 1000},
+    [AM7_FIELD_HCHO]           = {"hcho", 3, 1000},
+    [AM7_FIELD_BATTERY_STATUS] = {"battery_status", 0, 1},
+    [AM7_FIELD_BATTERY_LEVEL]  = {"battery_level", 0, 1},
+    [AM7_FIELD_PC03]           = {"pc03", 0, 1},
+    [AM7_FIELD_PC05]           = {"pc05", 0, 1},
+    [AM7_FIELD_PC10]           = {"pc10", 0, 1},
+    [AM7_FIELD_PC25]           = {"pc25", 0, 1},
+    [AM7_FIELD_PC50]           = {"pc50", 0, 1},
+    [AM7_FIELD_PC100]          = {"pc100", 0, 1},
+};
+
+double am7_field_get(const am7_data_t *data, am7_field_t field)
+{
+    switch (field) {
+        case AM7_FIELD_TEMP:           return data->temp;
+        case AM7_FIELD_HUMIDITY:       return data->humidity;
+        case AM7_FIELD_CO2:            return data->co2;
+        case AM7_FIELD_PM25:           return data->pm25;
+        case AM7_FIELD_PM10:           return data->pm10;
+        case AM7_FIELD_TVOC:           return data->tvoc;
+        case AM7_FIELD_HCHO:           return data->hcho;
+        case AM7_FIELD_BATTERY_STATUS: return data->battery_status;
+        case AM7_FIELD_BATTERY_LEVEL:  return data->battery_level;
+        case AM7_FIELD_PC03:           return data->pc03;
+        case AM7_FIELD_PC05:           return data->pc05;
+        case AM7_FIELD_PC10:           return data->pc10;
+        case AM7_FIELD_PC25:           return data->pc25;
+        case AM7_FIELD_PC50:           return data->pc50;
+        case AM7_FIELD_PC100:          return data->pc100;
+        default:                       return 0;
+    }
+}
+
+int am7_field_find(const char *name)
+{
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        if (strcmp(am7_field_info[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint16_t am7_field_raw(const am7_data_t *data, am7_field_t field)
+{
+    double raw = round(am7_field_get(data, field) * am7_field_info[field].scale);
+    return raw < 0 ? 0 : raw > 0xFFFF ? 0xFFFF : (uint16_t)raw;
+}
+
+int am7_field_format(char *buf, size_t size, const am7_data_t *data, am7_field_t field)
+{
+    if (am7_field_info[field].decimals != 0) {
+        return snprintf(buf, size, "%.*f", am7_field_info[field].decimals, am7_field_get(data, field));
+    }
+
+    // Integer fields skip the float formatter: digits are written backwards into tmp
+    char tmp[12];
+    int value = (int)am7_field_get(data, field);
+    unsigned int u = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (value < 0) {
+        tmp[n++] = '-';
+    }
+    if (size > 0) {
+        size_t len = (size_t)n < size ? (size_t)n : size - 1;
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = tmp[n - 1 - i];
+        }
+        buf[len] = '\0';
+    }
+    return n;
+}
+
+void am7_rbe_reset(am7_rbe_t *rbe)
+{
+    memset(rbe, 0, sizeof(*rbe));
+}
+
+uint32_t am7_rbe_changed(const am7_rbe_t *rbe, const am7_data_t *data,
+                         const am7_deadband_t bands[AM7_FIELD_COUNT])
+{
+    if (!rbe->valid) {
+        return AM7_FIELD_MASK_ALL;
+    }
+
+    uint32_t mask = 0;
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        double value = am7_field_get(data, (am7_field_t)i);
+        double diff = fabs(value - rbe->last[i]);
+        double band = fmax(bands[i].abs, bands[i].rel * fabs(rbe->last[i]));
+        if (diff > band) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+void am7_rbe_commit(am7_rbe_t *rbe, const am7_data_t *data, uint32_t mask)
+{
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        if (mask & (1u << i)) {
+            rbe->last[i] = am7_field_get(data, (am7_field_t)i);
+        }
+    }
+    if (mask == AM7_FIELD_MASK_ALL) {
+        rbe->valid = true;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "am7_proto.h"
+
+// Sensor fields published over MQTT, in payload order.
+// runtime_hours is intentionally not listed (always 0 on AM7).
+typedef enum {
+    AM7_FIELD_TEMP,
+    AM7_FIELD_HUMIDITY,
+    AM7_FIELD_CO2,
+    AM7_FIELD_PM25,
+    AM7_FIELD_PM10,
+    AM7_FIELD_TVOC,
+    AM7_FIELD_HCHO,
+    AM7_FIELD_BATTERY_STATUS,
+    AM7_FIELD_BATTERY_LEVEL,
+    AM7_FIELD_PC03,
+    AM7_FIELD_PC05,
+    AM7_FIELD_PC10,
+    AM7_FIELD_PC25,
+    AM7_FIELD_PC50,
+    AM7_FIELD_PC100,
+    AM7_FIELD_COUNT
+} am7_field_t;
+
+#define AM7_FIELD_MASK_ALL ((1u << AM7_FIELD_COUNT) - 1)
+
+typedef struct {
+    const char *name;     // JSON key
+    uint8_t decimals;     // digits after the decimal point in payloads
+    uint16_t scale;       // raw frame units per unit of the parsed value
+} am7_field_info_t;
+
+extern const am7_field_info_t am7_field_info[AM7_FIELD_COUNT];
+
+double am7_field_get(const am7_data_t *data, am7_field_t field);
+int am7_field_find(const char *name);  // field index or -1
+// Value in raw frame units (value * scale), clamped to 0..65535
+uint16_t am7_field_raw(const am7_data_t *data, am7_field_t field);
+// Bare numeric value with the field's payload precision, snprintf semantics
+int am7_field_format(char *buf, size_t size, const am7_data_t *data, am7_field_t field);
+
+// Report-by-exception: a field is reported once it moved further than its
+// deadband from the last reported value. The effective band is the larger of
+// abs and rel * |last|; with both zero every change is reported.
+typedef struct {
+    float abs;
+    float rel;   // fraction of the last reported value, e.g. 0.05 = 5%
+} am7_deadband_t;
+
+typedef struct {
+    double last[AM7_FIELD_COUNT];
+    bool valid;   // false until the first full report
+} am7_rbe_t;
+
+void am7_rbe_reset(am7_rbe_t *rbe);
+// Bitmask (1 << field) of fields outside their deadband; all fields when !valid
+uint32_t am7_rbe_changed(const am7_rbe_t *rbe, const am7_data_t *data,
+                         const am7_deadband_t bands[AM7_FIELD_COUNT]);
+// Record the fields in mask as reported
+void am7_rbe_commit(am7_rbe_t *rbe, const am7_data_t *data, uint32_t mask);
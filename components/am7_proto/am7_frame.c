@@ -0,0 +1,170 @@
+#include "am7_frame.h"
+#include <string.h>
+
+#define AM7_RING_MASK (AM7_RING_SIZE - 1)
+
+_Static_assert((AM7_RING_SIZE & AM7_RING_MASK) == 0, "AM7_RING_SIZE must be a power of two");
+_Static_assert(AM7_ASSEMBLER_SIZE >= 2 * AM7_FRAME_WIRE_LEN, "assembler must hold two wire frames");
+
+void am7_ring_init(am7_ring_t *ring)
+{
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+}
+
+size_t am7_ring_write(am7_ring_t *ring, const uint8_t *data, size_t len)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = AM7_RING_SIZE - (head - tail);
+
+    if (len > space) {
+        atomic_fetch_add_explicit(&ring->dropped, (uint_least32_t)(len - space), memory_order_relaxed);
+        len = space;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    // Copy in at most two pieces (up to the end of the buffer, then from the start)
+    size_t offset = head & AM7_RING_MASK;
+    size_t first = AM7_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&ring->buf[offset], data, first);
+    memcpy(&ring->buf[0], data + first, len - first);
+
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+    return len;
+}
+
+size_t am7_ring_read(am7_ring_t *ring, uint8_t *out, size_t max_len)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t len = head - tail;
+
+    if (len > max_len) {
+        len = max_len;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    size_t offset = tail & AM7_RING_MASK;
+    size_t first = AM7_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(out, &ring->buf[offset], first);
+    memcpy(out + first, &ring->buf[0], len - first);
+
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+    return len;
+}
+
+size_t am7_ring_used(am7_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+// Sum bytes four at a time: each 32-bit word is split into two 16-bit lanes
+// holding the even and odd bytes. Lanes are folded every 64 words, well before
+// a lane (max 510 per word) can carry into its neighbour.
+uint16_t am7_frame_checksum(const uint8_t *data, size_t len)
+{
+    uint32_t sum = 0;
+    size_t i = 0;
+
+    while (len - i >= 4) {
+        size_t block_end = i + 64 * 4;
+        if (block_end > len) {
+            block_end = len;
+        }
+        uint32_t lanes = 0;
+        for (; i + 4 <= block_end; i += 4) {
+            uint32_t w;
+            memcpy(&w, data + i, sizeof(w));
+            lanes += (w & 0x00FF00FFu) + ((w >> 8) & 0x00FF00FFu);
+        }
+        sum += (lanes & 0xFFFFu) + (lanes >> 16);
+    }
+    for (; i < len; i++) {
+        sum += data[i];
+    }
+    return (uint16_t)sum;
+}
+
+bool am7_frame_checksum_ok(const uint8_t *frame)
+{
+    uint16_t expected = ((uint16_t)frame[AM7_FRAME_SUM_LEN] << 8) | (uint16_t)frame[AM7_FRAME_SUM_LEN + 1];
+    return am7_frame_checksum(frame, AM7_FRAME_SUM_LEN) == expected;
+}
+
+void am7_assembler_init(am7_assembler_t *as)
+{
+    memset(as, 0, sizeof(*as));
+}
+
+size_t am7_assembler_space(const am7_assembler_t *as)
+{
+    return sizeof(as->buf) - as->len;
+}
+
+size_t am7_assembler_push(am7_assembler_t *as, const uint8_t *data, size_t len)
+{
+    size_t space = am7_assembler_space(as);
+    if (len > space) {
+        len = space;
+    }
+    memcpy(&as->buf[as->len], data, len);
+    as->len += len;
+    return len;
+}
+
+static void assembler_consume(am7_assembler_t *as, size_t n)
+{
+    as->len -= n;
+    if (as->len > 0) {
+        memmove(as->buf, &as->buf[n], as->len);
+    }
+}
+
+bool am7_assembler_next(am7_assembler_t *as, uint8_t frame[AM7_FRAME_LEN])
+{
+    while (as->len > 0) {
+        // Drop everything in front of the next marker in one go
+        const uint8_t *marker = memchr(as->buf, AM7_FRAME_MARKER, as->len);
+        size_t junk = marker ? (size_t)(marker - as->buf) : as->len;
+        if (junk > 0) {
+            as->skipped_bytes += junk;
+            assembler_consume(as, junk);
+            continue;
+        }
+
+        // Marker at buf[0]: wait until a whole wire frame is buffered
+        if (as->len < AM7_FRAME_WIRE_LEN) {
+            return false;
+        }
+
+        if (as->buf[AM7_FRAME_LEN] == '\r' && as->buf[AM7_FRAME_LEN + 1] == '\n') {
+            if (am7_frame_checksum_ok(as->buf)) {
+                memcpy(frame, as->buf, AM7_FRAME_LEN);
+                assembler_consume(as, AM7_FRAME_WIRE_LEN);
+                as->frames++;
+                return true;
+            }
+            as->checksum_errors++;
+        } else {
+            as->resyncs++;
+        }
+
+        // Not a frame start after all, hunt for the next marker
+        assembler_consume(as, 1);
+    }
+    return false;
+}
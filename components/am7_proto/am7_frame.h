@@ -0,0 +1,52 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// AM7 binary frame: 0xAA marker + 35 data bytes + big-endian checksum (38 bytes),
+// followed by CRLF on the wire. Checksum is the 16-bit sum of bytes 0-35.
+#define AM7_FRAME_MARKER    0xAA
+#define AM7_FRAME_LEN       38
+#define AM7_FRAME_WIRE_LEN  (AM7_FRAME_LEN + 2)
+#define AM7_FRAME_SUM_LEN   36
+
+// RX ring size in bytes (must be a power of two)
+#define AM7_RING_SIZE 1024
+
+// Single-producer/single-consumer byte ring.
+// The USB host data callback is the only writer, the AM7 task the only reader,
+// so head and tail need no lock - each side owns one index.
+typedef struct {
+    uint8_t buf[AM7_RING_SIZE];
+    atomic_size_t head;             // advanced by producer
+    atomic_size_t tail;             // advanced by consumer
+    atomic_uint_least32_t dropped;  // bytes dropped because the ring was full
+} am7_ring_t;
+
+void am7_ring_init(am7_ring_t *ring);
+size_t am7_ring_write(am7_ring_t *ring, const uint8_t *data, size_t len);  // producer side
+size_t am7_ring_read(am7_ring_t *ring, uint8_t *out, size_t max_len);      // consumer side
+size_t am7_ring_used(am7_ring_t *ring);
+
+// Frame assembler: linear window fed from the ring by the consumer.
+// Scans for the 0xAA marker, checks length/CRLF and validates the checksum.
+#define AM7_ASSEMBLER_SIZE 128
+
+typedef struct {
+    uint8_t buf[AM7_ASSEMBLER_SIZE];
+    size_t len;
+    uint32_t frames;            // valid frames emitted
+    uint32_t checksum_errors;   // marker and CRLF matched, checksum did not
+    uint32_t resyncs;           // marker without a valid frame behind it
+    uint32_t skipped_bytes;     // junk bytes skipped while hunting for a marker
+} am7_assembler_t;
+
+void am7_assembler_init(am7_assembler_t *as);
+size_t am7_assembler_space(const am7_assembler_t *as);
+size_t am7_assembler_push(am7_assembler_t *as, const uint8_t *data, size_t len);
+// Returns true and copies the next validated frame (without CRLF) into frame
+bool am7_assembler_next(am7_assembler_t *as, uint8_t frame[AM7_FRAME_LEN]);
+
+uint16_t am7_frame_checksum(const uint8_t *data, size_t len);
+bool am7_frame_checksum_ok(const uint8_t *frame);
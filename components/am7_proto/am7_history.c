@@ -0,0 +1,98 @@
+#include "am7_history.h"
+#include <string.h>
+
+size_t am7_hist_tier_size(uint32_t cap)
+{
+    size_t tags = (size_t)cap * sizeof(uint32_t);
+    size_t column = (size_t)cap * AM7_FIELD_COUNT * sizeof(uint16_t);
+    return tags + 3 * column;
+}
+
+void am7_hist_tier_init(am7_hist_tier_t *tier, uint32_t res, uint32_t cap, void *mem)
+{
+    memset(tier, 0, sizeof(*tier));
+    memset(mem, 0, am7_hist_tier_size(cap));
+    tier->res = res;
+    tier->cap = cap;
+    tier->tag = (uint32_t *)mem;
+    tier->min = (uint16_t *)(tier->tag + cap);
+    tier->max = tier->min + (size_t)cap * AM7_FIELD_COUNT;
+    tier->avg = tier->max + (size_t)cap * AM7_FIELD_COUNT;
+}
+
+static inline size_t column_index(const am7_hist_tier_t *tier, int field, uint32_t slot)
+{
+    return (size_t)field * tier->cap + slot;
+}
+
+bool am7_hist_tier_add(am7_hist_tier_t *tier, uint32_t t, const uint16_t raw[AM7_FIELD_COUNT], uint32_t *closed)
+{
+    uint32_t b = t / tier->res;
+    uint32_t slot = b % tier->cap;
+    bool was_open = tier->count > 0;
+    bool rolled = false;
+
+    if (!was_open || b != tier->open) {
+        rolled = was_open;
+        if (rolled && closed) {
+            *closed = tier->open;
+        }
+        tier->open = b;
+        tier->count = 0;
+        memset(tier->sum, 0, sizeof(tier->sum));
+        tier->tag[slot] = b + 1;
+    }
+
+    tier->count++;
+    for (int f = 0; f < AM7_FIELD_COUNT; f++) {
+        size_t i = column_index(tier, f, slot);
+        tier->sum[f] += raw[f];
+        if (tier->count == 1 || raw[f] < tier->min[i]) {
+            tier->min[i] = raw[f];
+        }
+        if (tier->count == 1 || raw[f] > tier->max[i]) {
+            tier->max[i] = raw[f];
+        }
+        tier->avg[i] = (uint16_t)((tier->sum[f] + tier->count / 2) / tier->count);
+    }
+    return rolled;
+}
+
+bool am7_hist_tier_get(const am7_hist_tier_t *tier, uint32_t b, am7_field_t field, am7_hist_stat_t *out)
+{
+    uint32_t slot = b % tier->cap;
+    if (tier->tag[slot] != b + 1) {
+        return false;
+    }
+    size_t i = column_index(tier, field, slot);
+    out->min = tier->min[i];
+    out->max = tier->max[i];
+    out->avg = tier->avg[i];
+    return true;
+}
+
+bool am7_hist_tier_get_all(const am7_hist_tier_t *tier, uint32_t b, am7_hist_stat_t out[AM7_FIELD_COUNT])
+{
+    for (int f = 0; f < AM7_FIELD_COUNT; f++) {
+        if (!am7_hist_tier_get(tier, b, (am7_field_t)f, &out[f])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void am7_hist_tier_put(am7_hist_tier_t *tier, uint32_t b, const am7_hist_stat_t stats[AM7_FIELD_COUNT])
+{
+    uint32_t slot = b % tier->cap;
+    // Never clobber the bucket that is currently accumulating
+    if (tier->count > 0 && slot == tier->open % tier->cap) {
+        return;
+    }
+    tier->tag[slot] = b + 1;
+    for (int f = 0; f < AM7_FIELD_COUNT; f++) {
+        size_t i = column_index(tier, f, slot);
+        tier->min[i] = stats[f].min;
+        tier->max[i] = stats[f].max;
+        tier->avg[i] = stats[f].avg;
+    }
+}
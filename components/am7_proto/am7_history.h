@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "am7_fields.h"
+
+// One downsampling tier of the sensor history: a ring of fixed-width time
+// buckets, each holding min/max/avg of every field in raw frame units (see
+// am7_field_raw). Storage is columnar, one array per statistic and field, so
+// a range query for one field reads contiguous memory. The bucket that is
+// still filling is kept up to date on every sample and is visible to readers.
+typedef struct {
+    uint32_t res;           // bucket width in seconds
+    uint32_t cap;           // number of buckets kept
+    uint32_t *tag;          // [cap] bucket number + 1 held by each slot, 0 = empty
+    uint16_t *min;          // [AM7_FIELD_COUNT][cap]
+    uint16_t *max;
+    uint16_t *avg;
+    uint32_t open;          // bucket number being accumulated
+    uint32_t count;         // samples in the open bucket
+    uint32_t sum[AM7_FIELD_COUNT];
+} am7_hist_tier_t;
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint16_t avg;
+} am7_hist_stat_t;
+
+// Bytes of backing memory needed for a tier of cap buckets
+size_t am7_hist_tier_size(uint32_t cap);
+// mem must be am7_hist_tier_size(cap) bytes, 4-byte aligned; it is cleared
+void am7_hist_tier_init(am7_hist_tier_t *tier, uint32_t res, uint32_t cap, void *mem);
+
+// Add a sample taken at t seconds. When it starts a new bucket and the
+// previous one held samples, the previous bucket number is stored in *closed
+// and true is returned.
+bool am7_hist_tier_add(am7_hist_tier_t *tier, uint32_t t, const uint16_t raw[AM7_FIELD_COUNT], uint32_t *closed);
+
+// Statistics of one field for bucket number b; false if the bucket is not held
+bool am7_hist_tier_get(const am7_hist_tier_t *tier, uint32_t b, am7_field_t field, am7_hist_stat_t *out);
+
+// All fields of bucket number b (e.g. to persist a closed bucket)
+bool am7_hist_tier_get_all(const am7_hist_tier_t *tier, uint32_t b, am7_hist_stat_t out[AM7_FIELD_COUNT]);
+
+// Store a complete bucket, e.g. restored from flash
+void am7_hist_tier_put(am7_hist_tier_t *tier, uint32_t b, const am7_hist_stat_t stats[AM7_FIELD_COUNT]);
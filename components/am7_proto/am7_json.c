@@ -0,0 +1,198 @@
+#include "am7_json.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void am7_json_init(am7_json_t *w, char *buf, size_t size, am7_json_flush_fn flush, void *ctx)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    w->flush = flush;
+    w->ctx = ctx;
+}
+
+static bool json_flush(am7_json_t *w)
+{
+    if (!w->flush || !w->flush(w->ctx, w->buf, w->len)) {
+        w->error = true;
+        return false;
+    }
+    w->flushed += w->len;
+    w->len = 0;
+    return true;
+}
+
+static void json_put(am7_json_t *w, const char *s, size_t n)
+{
+    while (n > 0 && !w->error) {
+        if (w->len == w->size && !json_flush(w)) {
+            return;
+        }
+        size_t room = w->size - w->len;
+        size_t k = n < room ? n : room;
+        memcpy(w->buf + w->len, s, k);
+        w->len += k;
+        s += k;
+        n -= k;
+    }
+}
+
+static void json_put_string(am7_json_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    json_put(w, "\"", 1);
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        json_put(w, run, (size_t)(s - run));
+        run = s + 1;
+        char esc[6] = {'\\', (char)c};
+        size_t len = 2;
+        switch (c) {
+            case '"': case '\\': break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            default:
+                memcpy(esc + 1, "u00", 3);
+                esc[4] = hex[c >> 4];
+                esc[5] = hex[c & 0xf];
+                len = 6;
+                break;
+        }
+        json_put(w, esc, len);
+    }
+    json_put(w, run, (size_t)(s - run));
+    json_put(w, "\"", 1);
+}
+
+// Separator and key ahead of a value in the current container
+static void json_member(am7_json_t *w, const char *key)
+{
+    uint32_t bit = 1u << w->depth;
+    if (w->nonempty & bit) {
+        json_put(w, ",", 1);
+    }
+    w->nonempty |= bit;
+    if (key) {
+        json_put_string(w, key);
+        json_put(w, ":", 1);
+    }
+}
+
+static void json_open(am7_json_t *w, const char *key, char c)
+{
+    json_member(w, key);
+    if (w->depth >= AM7_JSON_MAX_DEPTH) {
+        w->error = true;
+        return;
+    }
+    w->depth++;
+    w->nonempty &= ~(1u << w->depth);
+    json_put(w, &c, 1);
+}
+
+static void json_close(am7_json_t *w, char c)
+{
+    if (w->depth > 0) {
+        w->depth--;
+    }
+    json_put(w, &c, 1);
+}
+
+void am7_json_object_begin(am7_json_t *w, const char *key) { json_open(w, key, '{'); }
+void am7_json_object_end(am7_json_t *w) { json_close(w, '}'); }
+void am7_json_array_begin(am7_json_t *w, const char *key) { json_open(w, key, '['); }
+void am7_json_array_end(am7_json_t *w) { json_close(w, ']'); }
+
+void am7_json_raw(am7_json_t *w, const char *key, const char *json)
+{
+    json_member(w, key);
+    json_put(w, json, strlen(json));
+}
+
+void am7_json_string(am7_json_t *w, const char *key, const char *value)
+{
+    if (!value) {
+        am7_json_null(w, key);
+        return;
+    }
+    json_member(w, key);
+    json_put_string(w, value);
+}
+
+void am7_json_int(am7_json_t *w, const char *key, int64_t value)
+{
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%lld", (long long)value);
+    json_member(w, key);
+    json_put(w, num, (size_t)n);
+}
+
+void am7_json_uint(am7_json_t *w, const char *key, uint64_t value)
+{
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%llu", (unsigned long long)value);
+    json_member(w, key);
+    json_put(w, num, (size_t)n);
+}
+
+void am7_json_number(am7_json_t *w, const char *key, double value, int decimals)
+{
+    if (!isfinite(value)) {
+        am7_json_null(w, key);
+        return;
+    }
+    char num[32];
+    int n = snprintf(num, sizeof(num), "%.*f", decimals, value);
+    if (n < 0 || (size_t)n >= sizeof(num)) {
+        am7_json_null(w, key);
+        return;
+    }
+    json_member(w, key);
+    json_put(w, num, (size_t)n);
+}
+
+void am7_json_float(am7_json_t *w, const char *key, float value)
+{
+    if (!isfinite(value)) {
+        am7_json_null(w, key);
+        return;
+    }
+    // %.7g reads back exactly for most values; every float needs at most 9
+    char num[24];
+    int n = 0;
+    for (int digits = 7; digits <= 9; digits++) {
+        n = snprintf(num, sizeof(num), "%.*g", digits, (double)value);
+        if (strtof(num, NULL) == value) {
+            break;
+        }
+    }
+    json_member(w, key);
+    json_put(w, num, (size_t)n);
+}
+
+void am7_json_bool(am7_json_t *w, const char *key, bool value)
+{
+    json_member(w, key);
+    json_put(w, value ? "true" : "false", value ? 4 : 5);
+}
+
+void am7_json_null(am7_json_t *w, const char *key)
+{
+    json_member(w, key);
+    json_put(w, "null", 4);
+}
+
+bool am7_json_finish(am7_json_t *w)
+{
+    if (!w->error && w->flush && w->len > 0) {
+        json_flush(w);
+    }
+    return !w->error;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming JSON emitter: output goes straight into a caller-provided buffer
+// and, when that fills up, to the flush callback (an HTTP chunk, a socket).
+// Nothing is allocated and no tree is built. Without a flush callback the
+// buffer must hold the whole document; running out of room sets error.
+//
+// Values take the member key as their second argument: pass a key inside
+// objects and NULL inside arrays or for the top-level value. Commas are
+// inserted automatically. Keys and strings are escaped.
+
+#define AM7_JSON_MAX_DEPTH 31
+
+// Write len bytes out; false aborts the document
+typedef bool (*am7_json_flush_fn)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;            // bytes in buf not yet flushed
+    size_t flushed;        // bytes handed to flush so far
+    am7_json_flush_fn flush;
+    void *ctx;
+    uint32_t nonempty;     // bit d set once the container at depth d has a member
+    uint8_t depth;
+    bool error;            // out of room, flush failed or nesting too deep
+} am7_json_t;
+
+void am7_json_init(am7_json_t *w, char *buf, size_t size, am7_json_flush_fn flush, void *ctx);
+
+void am7_json_object_begin(am7_json_t *w, const char *key);
+void am7_json_object_end(am7_json_t *w);
+void am7_json_array_begin(am7_json_t *w, const char *key);
+void am7_json_array_end(am7_json_t *w);
+
+void am7_json_string(am7_json_t *w, const char *key, const char *value);   // NULL writes null
+void am7_json_int(am7_json_t *w, const char *key, int64_t value);
+void am7_json_uint(am7_json_t *w, const char *key, uint64_t value);
+// Fixed-point with the given digits after the decimal point; NaN/Inf write null
+void am7_json_number(am7_json_t *w, const char *key, double value, int decimals);
+// Fewest significant digits (7 to 9) that read back as the same float
+void am7_json_float(am7_json_t *w, const char *key, float value);
+void am7_json_bool(am7_json_t *w, const char *key, bool value);
+void am7_json_null(am7_json_t *w, const char *key);
+// Pre-formatted JSON value, written verbatim
+void am7_json_raw(am7_json_t *w, const char *key, const char *json);
+
+// Flush what is buffered (if there is a flush callback); false on any error
+bool am7_json_finish(am7_json_t *w);
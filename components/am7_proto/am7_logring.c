@@ -0,0 +1,83 @@
+#include "am7_logring.h"
+#include <stdio.h>
+#include <string.h>
+
+void am7_logring_init(am7_logring_t *ring, am7_logring_slot_t *slots, uint32_t cap)
+{
+    memset(slots, 0, cap * sizeof(*slots));
+    for (uint32_t i = 0; i < cap; i++) {
+        atomic_init(&slots[i].seq, 0);
+    }
+    ring->slots = slots;
+    ring->cap = cap;
+    atomic_init(&ring->head, 0);
+}
+
+void am7_logring_vwrite(am7_logring_t *ring, uint32_t uptime_ms, const char *fmt, va_list args)
+{
+    uint32_t seq = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed) + 1;
+    am7_logring_slot_t *slot = &ring->slots[seq % ring->cap];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->uptime_ms = uptime_ms;
+    vsnprintf(slot->text, sizeof(slot->text), fmt, args);
+
+    atomic_store_explicit(&slot->seq, seq, memory_order_release);
+}
+
+uint32_t am7_logring_head(am7_logring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+bool am7_logring_read(am7_logring_t *ring, uint32_t *seq, am7_logring_slot_t *out)
+{
+    for (;;) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (*seq == 0) {
+            *seq = 1;
+        }
+        if (*seq > head) {
+            return false;
+        }
+        if (head - *seq >= ring->cap) {
+            *seq = head - ring->cap + 1;  // Overwritten, start at the oldest slot
+        }
+
+        am7_logring_slot_t *slot = &ring->slots[*seq % ring->cap];
+        uint32_t held = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (held == *seq) {
+            *out = *slot;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == held) {
+                atomic_init(&out->seq, held);
+                return true;
+            }
+            continue;   // Overwritten while copying
+        }
+        if (held > *seq) {
+            continue;   // Lapped by the writers, head has moved on
+        }
+        // Claimed but still being written: stop here so it is not skipped
+        return false;
+    }
+}
+
+const char *am7_logring_message(const char *text, size_t *len)
+{
+    const char *msg = strchr(text, ')');
+    if (msg) {
+        msg++;
+        while (*msg == ' ') msg++;
+    } else {
+        msg = text;
+    }
+    size_t n = strlen(msg);
+    if (n > 0 && msg[n - 1] == '\n') {
+        n--;
+    }
+    *len = n;
+    return msg;
+}
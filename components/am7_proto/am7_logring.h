@@ -0,0 +1,41 @@
+#pragma once
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw log line as handed to the vprintf hook: "I (1772) TAG: message\n"
+#ifndef AM7_LOGRING_TEXT_LEN
+#define AM7_LOGRING_TEXT_LEN 232
+#endif
+
+typedef struct {
+    atomic_uint_least32_t seq;   // entry seq once complete, 0 while being written
+    uint32_t uptime_ms;
+    char text[AM7_LOGRING_TEXT_LEN];
+} am7_logring_slot_t;
+
+// Lossy log ring for any number of writers and readers, without locks.
+// A writer claims the next sequence number with one atomic add and formats
+// straight into slot seq % cap; the newest entries overwrite the oldest.
+// Each slot carries the seq it holds as a sequence lock, so a reader copies
+// an entry and keeps it only if the slot still holds that seq afterwards.
+// Two writers can only collide on a slot if one is preempted for a whole lap
+// of the ring mid-entry; the reader then drops the torn entry.
+typedef struct {
+    am7_logring_slot_t *slots;
+    uint32_t cap;
+    atomic_uint_least32_t head;  // seq of the newest claimed entry, 0 = none
+} am7_logring_t;
+
+void am7_logring_init(am7_logring_t *ring, am7_logring_slot_t *slots, uint32_t cap);
+void am7_logring_vwrite(am7_logring_t *ring, uint32_t uptime_ms, const char *fmt, va_list args);
+uint32_t am7_logring_head(am7_logring_t *ring);
+
+// Oldest complete entry with seq >= *seq. *seq is moved to the entry returned,
+// skipping entries that were overwritten. False if there is none yet.
+bool am7_logring_read(am7_logring_t *ring, uint32_t *seq, am7_logring_slot_t *out);
+
+// "TAG: message" part of a raw line (after "I (1772) "), without the newline
+const char *am7_logring_message(const char *text, size_t *len);
@@ -0,0 +1,72 @@
+#include "am7_payload.h"
+#include <stdio.h>
+
+int am7_payload_mqtt_json(char *buf, size_t size, const am7_data_t *data,
+                          uint64_t uptime_sec, int last_update_sec)
+{
+    // runtime_hours intentionally omitted from MQTT payload (always 0 on AM7)
+    return snprintf(buf, size,
+                    "{\"temp\":%.1f,\"humidity\":%.1f,\"co2\":%d,\"pm25\":%d,\"pm10\":%d,\"tvoc\":%.2f,\"hcho\":%.3f,"
+                    "\"battery_status\":%d,\"battery_level\":%d,"
+                    "\"pc03\":%d,\"pc05\":%d,\"pc10\":%d,\"pc25\":%d,\"pc50\":%d,\"pc100\":%d,"
+                    "\"uptime\":%llu,\"last_update\":%d}",
+                    data->temp, data->humidity,
+                    data->co2, data->pm25, data->pm10, data->tvoc, data->hcho,
+                    data->battery_status, data->battery_level,
+                    data->pc03, data->pc05, data->pc10, data->pc25, data->pc50, data->pc100,
+                    (unsigned long long)uptime_sec, last_update_sec);
+}
+
+// Advance pos, clamping so later snprintf calls only compute the length
+#define APPEND(...) do { \
+    n = snprintf(buf + (pos < size ? pos : size), pos < size ? size - pos : 0, __VA_ARGS__); \
+    if (n < 0) return n; \
+    pos += (size_t)n; \
+} while (0)
+
+int am7_payload_mqtt_fields_json(char *buf, size_t size, const am7_data_t *data, uint32_t mask,
+                                 uint64_t uptime_sec, int last_update_sec)
+{
+    size_t pos = 0;
+    int n;
+
+    APPEND("{");
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        if (mask & (1u << i)) {
+            APPEND("\"%s\":%.*f,", am7_field_info[i].name, am7_field_info[i].decimals,
+                   am7_field_get(data, (am7_field_t)i));
+        }
+    }
+    APPEND("\"uptime\":%llu,\"last_update\":%d}", (unsigned long long)uptime_sec, last_update_sec);
+    return (int)pos;
+}
+
+int am7_payload_backfill_json(char *buf, size_t size, const am7_data_t *data, uint32_t ts)
+{
+    size_t pos = 0;
+    int n;
+
+    APPEND("{");
+    if (ts != 0) {
+        APPEND("\"ts\":%lu,", (unsigned long)ts);
+    }
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        APPEND("%s\"%s\":%.*f", i ? "," : "", am7_field_info[i].name, am7_field_info[i].decimals,
+               am7_field_get(data, (am7_field_t)i));
+    }
+    APPEND("}");
+    return (int)pos;
+}
+
+#undef APPEND
+
+void am7_payload_sensor_write(am7_json_t *w, const char *key, const am7_data_t *data)
+{
+    am7_json_object_begin(w, key);
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        am7_json_number(w, am7_field_info[i].name, am7_field_get(data, (am7_field_t)i),
+                        am7_field_info[i].decimals);
+    }
+    am7_json_int(w, "runtime_hours", data->runtime_hours);
+    am7_json_object_end(w);
+}
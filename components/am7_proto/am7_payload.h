@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "am7_fields.h"
+#include "am7_json.h"
+
+struct cJSON;
+
+// MQTT state payload (compact JSON, same keys as the HA discovery templates).
+// Returns the snprintf() result: the length the payload needs, excluding NUL.
+int am7_payload_mqtt_json(char *buf, size_t size, const am7_data_t *data,
+                          uint64_t uptime_sec, int last_update_sec);
+
+// Partial state payload with only the fields in mask (see am7_fields.h),
+// followed by uptime and last_update. Same formatting as the full payload.
+int am7_payload_mqtt_fields_json(char *buf, size_t size, const am7_data_t *data, uint32_t mask,
+                                 uint64_t uptime_sec, int last_update_sec);
+
+// Backlog payload for samples replayed from the offline queue: every field
+// plus "ts" (Unix seconds of capture), which is left out when ts is 0.
+int am7_payload_backfill_json(char *buf, size_t size, const am7_data_t *data, uint32_t ts);
+
+// "data" object of /api/sensor. Caller owns the returned tree.
+struct cJSON *am7_payload_sensor_json(const am7_data_t *data);
+
+// Same object streamed as member key of the current container
+void am7_payload_sensor_write(am7_json_t *w, const char *key, const am7_data_t *data);
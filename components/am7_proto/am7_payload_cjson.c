@@ -0,0 +1,27 @@
+#include "am7_payload.h"
+#include "cJSON.h"
+
+cJSON *am7_payload_sensor_json(const am7_data_t *data)
+{
+    cJSON *obj = cJSON_CreateObject();
+    if (!obj) {
+        return NULL;
+    }
+    cJSON_AddNumberToObject(obj, "temp", data->temp);
+    cJSON_AddNumberToObject(obj, "humidity", data->humidity);
+    cJSON_AddNumberToObject(obj, "co2", data->co2);
+    cJSON_AddNumberToObject(obj, "pm25", data->pm25);
+    cJSON_AddNumberToObject(obj, "pm10", data->pm10);
+    cJSON_AddNumberToObject(obj, "tvoc", data->tvoc);
+    cJSON_AddNumberToObject(obj, "hcho", data->hcho);
+    cJSON_AddNumberToObject(obj, "battery_status", data->battery_status);
+    cJSON_AddNumberToObject(obj, "battery_level", data->battery_level);
+    cJSON_AddNumberToObject(obj, "runtime_hours", data->runtime_hours);
+    cJSON_AddNumberToObject(obj, "pc03", data->pc03);
+    cJSON_AddNumberToObject(obj, "pc05", data->pc05);
+    cJSON_AddNumberToObject(obj, "pc10", data->pc10);
+    cJSON_AddNumberToObject(obj, "pc25", data->pc25);
+    cJSON_AddNumberToObject(obj, "pc50", data->pc50);
+    cJSON_AddNumberToObject(obj, "pc100", data->pc100);
+    return obj;
+}
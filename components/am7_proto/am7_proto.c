@@ -0,0 +1,51 @@
+#include "am7_proto.h"
+#include "am7_frame.h"
+
+static inline uint16_t be16(const uint8_t *p)
+{
+    return ((uint16_t)p[0] << 8) | (uint16_t)p[1];
+}
+
+// Response format: 0xaa (1 byte) + 7 uint16_t values (14 bytes)
+// Extended format: + battery, runtime, particle counts (+ checksum at bytes 36-37)
+// Values: PM2.5, PM10, HCHO, TVOC, CO2, Temp, Humidity (all big-endian uint16_t)
+bool am7_parse_frame(const uint8_t *data, size_t len, am7_data_t *out)
+{
+    // Full frame: 0xAA + 14 bytes sensors + 21 bytes extended + 2 bytes checksum = 38 bytes (CRLF stripped)
+    if (!data || !out || len < AM7_FRAME_LEN) {
+        return false;
+    }
+
+    // Must start with 0xaa marker
+    if (data[0] != AM7_FRAME_MARKER) {
+        return false;
+    }
+
+    // Reject frames with invalid data (CO2 reads 0 while the sensor warms up)
+    uint16_t co2 = be16(&data[9]);
+    if (co2 == 0) {
+        return false;
+    }
+
+    // Convert to sensor readings with appropriate scaling
+    out->pm25 = be16(&data[1]);              // PM2.5 in µg/m³
+    out->pm10 = be16(&data[3]);              // PM10 in µg/m³
+    out->hcho = be16(&data[5]) / 1000.0;     // HCHO in mg/m³
+    out->tvoc = be16(&data[7]) / 1000.0;     // TVOC in mg/m³
+    out->co2 = co2;                          // CO2 in ppm
+    out->temp = be16(&data[11]) / 100.0;     // Temperature in °C
+    out->humidity = be16(&data[13]) / 100.0;  // Humidity in %
+
+    // Extended fields
+    out->battery_status = data[15];
+    out->battery_level = data[16];
+    out->runtime_hours = be16(&data[17]);
+    out->pc03 = be16(&data[19]);
+    out->pc05 = be16(&data[21]);
+    out->pc10 = be16(&data[23]);
+    out->pc25 = be16(&data[25]);
+    out->pc50 = be16(&data[27]);
+    out->pc100 = be16(&data[29]);
+
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    float temp;
+    float humidity;
+    int co2;
+    int pm25;
+    int pm10;
+    float tvoc;
+    float hcho;
+    int battery_status;   // 0 = battery, 1 = charging
+    int battery_level;    // 1-4 bars
+    int runtime_hours;    // cumulative runtime
+    int pc03;             // >0.3 µm particle count
+    int pc05;             // >0.5 µm particle count
+    int pc10;             // >1.0 µm particle count
+    int pc25;             // >2.5 µm particle count
+    int pc50;             // >5.0 µm particle count
+    int pc100;            // >10 µm particle count
+} am7_data_t;
+
+// Decode a validated 38-byte frame (see am7_frame.h) into sensor readings.
+// Returns false for frames that carry no valid measurement.
+bool am7_parse_frame(const uint8_t *data, size_t len, am7_data_t *out);
@@ -0,0 +1,81 @@
+#include "am7_record.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+static uint16_t raw16(double value, double scale)
+{
+    double raw = round(value * scale);
+    return raw < 0 ? 0 : raw > 0xFFFF ? 0xFFFF : (uint16_t)raw;
+}
+
+uint16_t am7_crc16(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint16_t crc = 0xFFFF;
+
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t am7_record_crc(const am7_record_t *rec)
+{
+    return am7_crc16((const uint8_t *)rec + offsetof(am7_record_t, timestamp),
+                     sizeof(*rec) - offsetof(am7_record_t, timestamp));
+}
+
+void am7_record_encode(am7_record_t *rec, const am7_data_t *data, uint32_t timestamp, uint8_t flags, uint8_t boot)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->state = AM7_RECORD_WRITTEN;
+    rec->flags = flags;
+    rec->timestamp = timestamp;
+    rec->pm25 = raw16(data->pm25, 1);
+    rec->pm10 = raw16(data->pm10, 1);
+    rec->hcho = raw16(data->hcho, 1000);
+    rec->tvoc = raw16(data->tvoc, 1000);
+    rec->co2 = raw16(data->co2, 1);
+    rec->temp = raw16(data->temp, 100);
+    rec->humidity = raw16(data->humidity, 100);
+    rec->pc[0] = raw16(data->pc03, 1);
+    rec->pc[1] = raw16(data->pc05, 1);
+    rec->pc[2] = raw16(data->pc10, 1);
+    rec->pc[3] = raw16(data->pc25, 1);
+    rec->pc[4] = raw16(data->pc50, 1);
+    rec->pc[5] = raw16(data->pc100, 1);
+    rec->battery = (uint8_t)((data->battery_status & 0x0F) << 4 | (data->battery_level & 0x0F));
+    rec->boot = boot;
+    rec->crc = am7_record_crc(rec);
+}
+
+bool am7_record_decode(const am7_record_t *rec, am7_data_t *data)
+{
+    if ((rec->state != AM7_RECORD_WRITTEN && rec->state != AM7_RECORD_SENT) ||
+        rec->crc != am7_record_crc(rec)) {
+        return false;
+    }
+
+    // Same scaling as am7_parse_frame
+    memset(data, 0, sizeof(*data));
+    data->pm25 = rec->pm25;
+    data->pm10 = rec->pm10;
+    data->hcho = rec->hcho / 1000.0;
+    data->tvoc = rec->tvoc / 1000.0;
+    data->co2 = rec->co2;
+    data->temp = rec->temp / 100.0;
+    data->humidity = rec->humidity / 100.0;
+    data->battery_status = rec->battery >> 4;
+    data->battery_level = rec->battery & 0x0F;
+    data->pc03 = rec->pc[0];
+    data->pc05 = rec->pc[1];
+    data->pc10 = rec->pc[2];
+    data->pc25 = rec->pc[3];
+    data->pc50 = rec->pc[4];
+    data->pc100 = rec->pc[5];
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "am7_proto.h"
+
+// Compact fixed-size sample record for flash logs. Sensor values are kept in
+// the raw integer units of the AM7 frame, so decoding reproduces the parsed
+// values exactly; runtime_hours (always 0 on AM7) is not kept. Records are
+// written to NOR flash, where bits can only be cleared without an erase: the
+// state byte walks FF -> FE -> FC in place.
+#define AM7_RECORD_ERASED   0xFF
+#define AM7_RECORD_WRITTEN  0xFE
+#define AM7_RECORD_SENT     0xFC
+
+#define AM7_RECORD_F_UPTIME 0x01   // timestamp is seconds since boot, not Unix time
+
+typedef struct {
+    uint8_t state;        // AM7_RECORD_*
+    uint8_t flags;        // AM7_RECORD_F_*
+    uint16_t crc;         // CRC-16/CCITT over everything after this field
+    uint32_t timestamp;   // Unix seconds, or uptime seconds with AM7_RECORD_F_UPTIME
+    uint16_t pm25;
+    uint16_t pm10;
+    uint16_t hcho;        // µg/m³ (mg/m³ * 1000)
+    uint16_t tvoc;        // µg/m³ (mg/m³ * 1000)
+    uint16_t co2;
+    uint16_t temp;        // °C * 100
+    uint16_t humidity;    // % * 100
+    uint16_t pc[6];       // pc03, pc05, pc10, pc25, pc50, pc100
+    uint8_t battery;      // status << 4 | level
+    uint8_t boot;         // low byte of the boot counter that captured the sample
+} am7_record_t;
+
+_Static_assert(sizeof(am7_record_t) == 36, "am7_record_t layout changed");
+
+void am7_record_encode(am7_record_t *rec, const am7_data_t *data, uint32_t timestamp, uint8_t flags, uint8_t boot);
+// false if the record is not WRITTEN/SENT or fails its CRC
+bool am7_record_decode(const am7_record_t *rec, am7_data_t *data);
+uint16_t am7_record_crc(const am7_record_t *rec);
+uint16_t am7_crc16(const void *data, size_t len);  // CRC-16/CCITT-FALSE
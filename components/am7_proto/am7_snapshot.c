@@ -0,0 +1,54 @@
+#include "am7_snapshot.h"
+#include <string.h>
+
+void am7_snapshot_init(am7_snapshot_t *snap)
+{
+    memset(snap, 0, sizeof(*snap));
+    atomic_init(&snap->slots[0].lock, 0);
+    atomic_init(&snap->slots[1].lock, 0);
+    atomic_init(&snap->seq, 0);
+}
+
+void am7_snapshot_publish(am7_snapshot_t *snap, const am7_data_t *data, int64_t captured_us)
+{
+    uint32_t seq = atomic_load_explicit(&snap->seq, memory_order_relaxed) + 1;
+    am7_snapshot_slot_t *slot = &snap->slots[seq & 1];
+
+    uint32_t lock = atomic_load_explicit(&slot->lock, memory_order_relaxed);
+    atomic_store_explicit(&slot->lock, lock + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->sample.data = *data;
+    slot->sample.seq = seq;
+    slot->sample.captured_us = captured_us;
+
+    atomic_store_explicit(&slot->lock, lock + 2, memory_order_release);
+    atomic_store_explicit(&snap->seq, seq, memory_order_release);
+}
+
+bool am7_snapshot_acquire(am7_snapshot_t *snap, am7_sample_t *out)
+{
+    for (;;) {
+        uint32_t seq = atomic_load_explicit(&snap->seq, memory_order_acquire);
+        if (seq == 0) {
+            return false;
+        }
+
+        am7_snapshot_slot_t *slot = &snap->slots[seq & 1];
+        uint32_t lock = atomic_load_explicit(&slot->lock, memory_order_acquire);
+        if ((lock & 1) == 0) {
+            *out = slot->sample;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->lock, memory_order_relaxed) == lock) {
+                return true;
+            }
+        }
+        // Writer lapped us and is refilling this slot: the other one is now
+        // the latest complete sample, so retry with a fresh seq
+    }
+}
+
+uint32_t am7_snapshot_seq(am7_snapshot_t *snap)
+{
+    return atomic_load_explicit(&snap->seq, memory_order_acquire);
+}
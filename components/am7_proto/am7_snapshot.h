@@ -0,0 +1,32 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "am7_proto.h"
+
+// One published sensor sample
+typedef struct {
+    am7_data_t data;
+    uint32_t seq;           // monotonic publish counter, starts at 1
+    int64_t captured_us;    // capture timestamp (caller's clock)
+} am7_sample_t;
+
+typedef struct {
+    atomic_uint_least32_t lock;  // odd while the writer is filling this slot
+    am7_sample_t sample;
+} am7_snapshot_slot_t;
+
+// Double-buffered snapshot with one writer and any number of readers.
+// The writer fills the slot not holding the latest sample, so readers copy a
+// complete sample without a mutex and never wait for an update in progress.
+// Each slot carries its own sequence lock to detect the writer lapping a
+// reader; the reader then simply retries on the newer slot.
+typedef struct {
+    am7_snapshot_slot_t slots[2];
+    atomic_uint_least32_t seq;   // seq of the latest complete sample, 0 = none
+} am7_snapshot_t;
+
+void am7_snapshot_init(am7_snapshot_t *snap);
+void am7_snapshot_publish(am7_snapshot_t *snap, const am7_data_t *data, int64_t captured_us);
+bool am7_snapshot_acquire(am7_snapshot_t *snap, am7_sample_t *out);  // false until first publish
+uint32_t am7_snapshot_seq(am7_snapshot_t *snap);
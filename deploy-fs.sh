@@ -9,7 +9,8 @@ echo "Building SPIFFS image..."
 cmake --build build --target spiffs_image
 
 echo "Deploying SPIFFS to $DEVICE_IP..."
-curl -X POST "http://$DEVICE_IP/api/ota/spiffs" --data-binary @build/spiffs.bin
+SHA256=$(sha256sum build/spiffs.bin | cut -d' ' -f1)
+curl -X POST "http://$DEVICE_IP/api/ota/spiffs" -H "X-Content-SHA256: $SHA256" --data-binary @build/spiffs.bin
 
 echo ""
 echo "SPIFFS deployment complete!"
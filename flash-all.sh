@@ -2,12 +2,11 @@
 # Flash firmware and SPIFFS (web interface)
 
 DEVICE="/dev/tty.usbmodem1101"
-SPIFFS_SIZE=983040  # 960KB in bytes
 SPIFFS_OFFSET=0x2A0000  # From partitions.csv (after ota_0 + ota_1)
 
 echo "Building SPIFFS image..."
 . ~/esp/esp-idf/export.sh && \
-python ~/esp/esp-idf/components/spiffs/spiffsgen.py $SPIFFS_SIZE spiffs build/spiffs.bin && \
+python tools/www_pack.py spiffs build/spiffs.bin && \
 echo "" && \
 echo "Flashing firmware and SPIFFS..." && \
 idf.py -p $DEVICE flash && \
@@ -0,0 +1,347 @@
+// Host micro-benchmarks for the AM7 hot paths: frame assembly, parsing and
+// payload serialization. Usage: am7_bench [corpus.hex] [min_ms]
+#define _POSIX_C_SOURCE 199309L
+#include "am7_frame.h"
+#include "am7_proto.h"
+#include "am7_payload.h"
+#include "am7_snapshot.h"
+#include "am7_history.h"
+#include "am7_logring.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef AM7_PROTO_HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#ifndef AM7_BENCH_CORPUS
+#define AM7_BENCH_CORPUS "am7_frames.hex"
+#endif
+
+#define MAX_FRAMES 4096
+#define USB_PACKET_SIZE 64  // CDC bulk IN transfers arrive in 64-byte packets
+
+static uint8_t wire[MAX_FRAMES * AM7_FRAME_WIRE_LEN];
+static size_t wire_len = 0;
+static uint8_t frames[MAX_FRAMES][AM7_FRAME_LEN];
+static am7_data_t samples[MAX_FRAMES];
+static size_t frame_count = 0;
+static double min_ms = 200.0;
+
+// Keeps results observable so the compiler cannot drop the work
+static volatile uint32_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool load_corpus(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot open corpus %s\n", path);
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f) && frame_count < MAX_FRAMES) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        size_t start = wire_len;
+        for (char *p = line; hex_nibble(p[0]) >= 0 && hex_nibble(p[1]) >= 0; p += 2) {
+            if (wire_len >= sizeof(wire)) {
+                break;
+            }
+            wire[wire_len++] = (uint8_t)(hex_nibble(p[0]) << 4 | hex_nibble(p[1]));
+        }
+        if (wire_len - start >= AM7_FRAME_LEN && am7_frame_checksum_ok(&wire[start])) {
+            memcpy(frames[frame_count], &wire[start], AM7_FRAME_LEN);
+            am7_parse_frame(frames[frame_count], AM7_FRAME_LEN, &samples[frame_count]);
+            frame_count++;
+        }
+    }
+    fclose(f);
+    return frame_count > 0;
+}
+
+static void report(const char *name, double elapsed_ns, size_t ops, const char *unit)
+{
+    printf("%-28s %10.1f ns/%s  (%zu ops)\n", name, elapsed_ns / (double)ops, unit, ops);
+}
+
+// Full RX path: USB-sized chunks through the ring, assembler and parser
+static void bench_rx_path(void)
+{
+    static am7_ring_t ring;
+    am7_assembler_t as;
+    uint8_t chunk[AM7_ASSEMBLER_SIZE];
+    uint8_t frame[AM7_FRAME_LEN];
+    am7_data_t out;
+    size_t parsed = 0;
+
+    am7_ring_init(&ring);
+    am7_assembler_init(&as);
+
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t off = 0; off < wire_len; off += USB_PACKET_SIZE) {
+            size_t len = wire_len - off < USB_PACKET_SIZE ? wire_len - off : USB_PACKET_SIZE;
+            am7_ring_write(&ring, &wire[off], len);
+
+            size_t n;
+            while ((n = am7_ring_read(&ring, chunk, am7_assembler_space(&as))) > 0) {
+                am7_assembler_push(&as, chunk, n);
+                while (am7_assembler_next(&as, frame)) {
+                    parsed += am7_parse_frame(frame, sizeof(frame), &out);
+                }
+            }
+        }
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+
+    sink += (uint32_t)out.co2;
+    report("rx_path (ring+sync+parse)", elapsed, parsed, "frame");
+    if (as.checksum_errors || as.resyncs) {
+        printf("  warning: %u checksum errors, %u resyncs\n", (unsigned)as.checksum_errors, (unsigned)as.resyncs);
+    }
+}
+
+static void bench_checksum(void)
+{
+    size_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            sink += am7_frame_checksum_ok(frames[i]);
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("frame_checksum", elapsed, ops, "frame");
+}
+
+static void bench_parse(void)
+{
+    am7_data_t out;
+    size_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            sink += am7_parse_frame(frames[i], AM7_FRAME_LEN, &out);
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("parse_frame", elapsed, ops, "frame");
+}
+
+static void bench_snapshot(void)
+{
+    static am7_snapshot_t snap;
+    am7_sample_t sample;
+    size_t ops = 0;
+
+    am7_snapshot_init(&snap);
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            am7_snapshot_publish(&snap, &samples[i], (int64_t)i);
+            sink += am7_snapshot_acquire(&snap, &sample);
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("snapshot publish+acquire", elapsed, ops, "sample");
+}
+
+static void bench_mqtt_payload(void)
+{
+    char payload[512];
+    size_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            sink += (uint32_t)am7_payload_mqtt_json(payload, sizeof(payload), &samples[i], 123456 + i, 10);
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("mqtt_payload (snprintf)", elapsed, ops, "payload");
+}
+
+// History ingest: one sample into the 1 s / 1 min / 15 min tiers
+static void bench_history(void)
+{
+    static const uint32_t res[3] = {1, 60, 900};
+    static const uint32_t cap[3] = {3600, 1440, 2880};
+    am7_hist_tier_t tiers[3];
+    void *mem[3];
+    uint16_t raw[AM7_FIELD_COUNT];
+    uint32_t t = 1700000000, closed;
+    size_t ops = 0;
+
+    for (int i = 0; i < 3; i++) {
+        mem[i] = malloc(am7_hist_tier_size(cap[i]));
+        am7_hist_tier_init(&tiers[i], res[i], cap[i], mem[i]);
+    }
+
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            for (int f = 0; f < AM7_FIELD_COUNT; f++) {
+                raw[f] = am7_field_raw(&samples[i], (am7_field_t)f);
+            }
+            for (int k = 0; k < 3; k++) {
+                sink += am7_hist_tier_add(&tiers[k], t, raw, &closed);
+            }
+            t += 5;
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("history_add (3 tiers)", elapsed, ops, "sample");
+
+    for (int i = 0; i < 3; i++) {
+        free(mem[i]);
+    }
+}
+
+// Field topic layout: one bare value per field, as published on <topic>/<field>
+static void bench_field_values(void)
+{
+    char value[24];
+    size_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            for (int f = 0; f < AM7_FIELD_COUNT; f++) {
+                sink += (uint32_t)am7_field_format(value, sizeof(value), &samples[i], (am7_field_t)f);
+            }
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("field_values (all fields)", elapsed, ops, "sample");
+}
+
+static void logring_write(am7_logring_t *ring, uint32_t uptime_ms, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    am7_logring_vwrite(ring, uptime_ms, fmt, args);
+    va_end(args);
+}
+
+// Log capture hook: one typical ESP_LOG line into the ring, plus reading it back
+static void bench_logring(void)
+{
+    static am7_logring_slot_t slots[100];
+    am7_logring_t ring;
+    am7_logring_slot_t out;
+    uint32_t seq = 0;
+    size_t ops = 0;
+
+    am7_logring_init(&ring, slots, 100);
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            logring_write(&ring, (uint32_t)i, "I (%lu) %s: CO2=%d ppm, PM2.5=%d\n",
+                          (unsigned long)i, "AM7", samples[i].co2, samples[i].pm25);
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("log_capture (format+ring)", elapsed, ops, "line");
+
+    ops = 0;
+    start = now_ns();
+    do {
+        seq = 0;
+        while (am7_logring_read(&ring, &seq, &out)) {
+            sink += (uint32_t)out.text[0];
+            seq++;
+            ops++;
+        }
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("log_read (ring copy)", elapsed, ops, "line");
+}
+
+static void bench_sensor_stream(void)
+{
+    char buf[512];
+    am7_json_t w;
+    size_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            am7_json_init(&w, buf, sizeof(buf), NULL, NULL);
+            am7_payload_sensor_write(&w, NULL, &samples[i]);
+            sink += (uint32_t)w.len;
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("api_sensor (stream)", elapsed, ops, "payload");
+}
+
+#ifdef AM7_PROTO_HAVE_CJSON
+static void bench_sensor_json(void)
+{
+    size_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < frame_count; i++) {
+            cJSON *obj = am7_payload_sensor_json(&samples[i]);
+            char *str = cJSON_Print(obj);
+            sink += (uint32_t)strlen(str);
+            cJSON_free(str);
+            cJSON_Delete(obj);
+        }
+        ops += frame_count;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_ms * 1e6);
+    report("api_sensor (cJSON)", elapsed, ops, "payload");
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    const char *corpus = argc > 1 ? argv[1] : AM7_BENCH_CORPUS;
+    if (argc > 2) {
+        min_ms = atof(argv[2]);
+    }
+    if (!load_corpus(corpus)) {
+        fprintf(stderr, "No valid frames in %s\n", corpus);
+        return 1;
+    }
+    printf("corpus: %s (%zu frames, %zu bytes)\n", corpus, frame_count, wire_len);
+
+    bench_rx_path();
+    bench_checksum();
+    bench_parse();
+    bench_snapshot();
+    bench_mqtt_payload();
+    bench_field_values();
+    bench_history();
+    bench_logring();
+    bench_sensor_stream();
+#ifdef AM7_PROTO_HAVE_CJSON
+    bench_sensor_json();
+#endif
+    return 0;
+}
@@ -0,0 +1,498 @@
+// Delta firmware patches (format in components/am7_proto/am7_delta.h).
+//
+//   am7_delta diff OLD.bin NEW.bin PATCH    make a patch, then check it applies
+//   am7_delta apply OLD.bin PATCH NEW.bin   rebuild NEW from OLD and a patch
+//
+// OLD is the image the devices run now (build/airmaster-adapter-esp32.bin of
+// that release), NEW the one to roll out. Matching is bsdiff's: exact seeds
+// (here from a hash index of OLD instead of a suffix array) extended in both
+// directions while at least half the bytes agree, so moved code with shifted
+// addresses becomes a mostly zero difference.
+#include "am7_delta.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEED_LEN 8          // bytes hashed per old position
+#define HASH_BITS 20
+#define CHAIN_LIMIT 64      // candidates tried per new position
+#define ZERO_BREAK 3        // zero runs at least this long end a pair's bytes
+
+// --- SHA-256 (FIPS 180-4), for the header ---------------------------------
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;
+    uint8_t block[64];
+    size_t used;
+} sha256_t;
+
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(sha256_t *s, const uint8_t *p)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3];
+    uint32_t e = s->h[4], f = s->h[5], g = s->h[6], h = s->h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + sha_k[i] + w[i];
+        uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s->h[0] += a;
+    s->h[1] += b;
+    s->h[2] += c;
+    s->h[3] += d;
+    s->h[4] += e;
+    s->h[5] += f;
+    s->h[6] += g;
+    s->h[7] += h;
+}
+
+static void sha256(const uint8_t *data, size_t len, uint8_t out[32])
+{
+    sha256_t s = {.h = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19}};
+    s.len = len;
+    for (; len >= 64; data += 64, len -= 64) {
+        sha256_block(&s, data);
+    }
+    if (len > 0) {
+        memcpy(s.block, data, len);
+    }
+    s.used = len;
+    s.block[s.used++] = 0x80;
+    if (s.used > 56) {
+        memset(s.block + s.used, 0, 64 - s.used);
+        sha256_block(&s, s.block);
+        s.used = 0;
+    }
+    memset(s.block + s.used, 0, 56 - s.used);
+    for (int i = 0; i < 8; i++) {
+        s.block[56 + i] = (uint8_t)((s.len * 8) >> (56 - 8 * i));
+    }
+    sha256_block(&s, s.block);
+    for (int i = 0; i < 8; i++) {
+        out[4 * i] = (uint8_t)(s.h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(s.h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(s.h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)s.h[i];
+    }
+}
+
+// --- Files and output -------------------------------------------------------
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} bytes_t;
+
+static bool read_file(const char *path, bytes_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        if (out->len + n > out->cap) {
+            out->cap = (out->len + n) * 2;
+            out->data = realloc(out->data, out->cap);
+            if (!out->data) {
+                fclose(f);
+                return false;
+            }
+        }
+        memcpy(out->data + out->len, chunk, n);
+        out->len += n;
+    }
+    fclose(f);
+    return true;
+}
+
+static bool write_file(const char *path, const uint8_t *data, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(data, 1, len, f) != len || fclose(f) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+static void put(bytes_t *b, const void *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    if (b->len + len > b->cap) {
+        b->cap = (b->len + len) * 2 + 256;
+        b->data = realloc(b->data, b->cap);
+        if (!b->data) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void put_varint(bytes_t *b, uint32_t v)
+{
+    uint8_t buf[5];
+    size_t n = 0;
+    do {
+        buf[n] = v & 0x7f;
+        v >>= 7;
+        if (v) {
+            buf[n] |= 0x80;
+        }
+        n++;
+    } while (v);
+    put(b, buf, n);
+}
+
+static void put_le32(bytes_t *b, uint32_t v)
+{
+    uint8_t buf[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    put(b, buf, 4);
+}
+
+// --- Diff -------------------------------------------------------------------
+
+typedef struct {
+    const uint8_t *old;
+    size_t old_len;
+    int32_t *head;      // newest old position per hash
+    int32_t *prev;      // next older position with the same hash
+} index_t;
+
+static uint32_t seed_hash(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+}
+
+static void index_build(index_t *ix, const uint8_t *old, size_t old_len)
+{
+    ix->old = old;
+    ix->old_len = old_len;
+    ix->head = malloc(sizeof(int32_t) << HASH_BITS);
+    ix->prev = malloc(sizeof(int32_t) * (old_len + 1));
+    if (!ix->head || !ix->prev) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memset(ix->head, 0xff, sizeof(int32_t) << HASH_BITS);
+    for (size_t i = 0; i + SEED_LEN <= old_len; i++) {
+        uint32_t h = seed_hash(old + i);
+        ix->prev[i] = ix->head[h];
+        ix->head[h] = (int32_t)i;
+    }
+}
+
+// Longest exact match for new[scan...] among the indexed old positions
+static size_t index_search(const index_t *ix, const uint8_t *new, size_t new_len, size_t scan, size_t *pos)
+{
+    if (scan + SEED_LEN > new_len) {
+        return 0;
+    }
+    size_t best = 0;
+    int32_t cand = ix->head[seed_hash(new + scan)];
+    for (int tries = 0; cand >= 0 && tries < CHAIN_LIMIT; tries++, cand = ix->prev[cand]) {
+        size_t n = 0;
+        size_t max = ix->old_len - (size_t)cand;
+        if (max > new_len - scan) {
+            max = new_len - scan;
+        }
+        while (n < max && ix->old[cand + n] == new[scan + n]) {
+            n++;
+        }
+        if (n > best) {
+            best = n;
+            *pos = (size_t)cand;
+        }
+    }
+    return best >= SEED_LEN ? best : 0;
+}
+
+// diff_len bytes of new[] minus old[] as {zeros, count, bytes} pairs
+static void put_diff(bytes_t *out, const uint8_t *old, const uint8_t *new, size_t len)
+{
+    size_t i = 0;
+    while (i < len) {
+        size_t zeros = 0;
+        while (i + zeros < len && old[i + zeros] == new[i + zeros]) {
+            zeros++;
+        }
+        i += zeros;
+        size_t count = 0;
+        for (size_t run = 0; i + count + run < len;) {
+            if (old[i + count + run] == new[i + count + run]) {
+                if (++run == ZERO_BREAK) {
+                    break;
+                }
+            } else {
+                count += run + 1;
+                run = 0;
+            }
+        }
+        put_varint(out, (uint32_t)zeros);
+        put_varint(out, (uint32_t)count);
+        for (size_t k = 0; k < count; k++) {
+            uint8_t d = (uint8_t)(new[i + k] - old[i + k]);
+            put(out, &d, 1);
+        }
+        i += count;
+    }
+}
+
+static void put_record(bytes_t *out, const uint8_t *old, const uint8_t *new, size_t lastscan, size_t lastpos,
+                       size_t lenf, size_t extra, int64_t seek)
+{
+    put_varint(out, (uint32_t)lenf);
+    put_varint(out, (uint32_t)extra);
+    put_varint(out, (uint32_t)(((uint64_t)seek << 1) ^ (uint64_t)(seek >> 63)));
+    put_diff(out, old + lastpos, new + lastscan, lenf);
+    put(out, new + lastscan + lenf, extra);
+}
+
+// bsdiff's scan, with index_search in place of the suffix array search
+static void diff(const uint8_t *old, size_t old_len, const uint8_t *new, size_t new_len, bytes_t *out)
+{
+    index_t ix;
+    index_build(&ix, old, old_len);
+
+    size_t scan = 0, len = 0, pos = 0;
+    size_t lastscan = 0, lastpos = 0;
+    int64_t lastoffset = 0;
+    while (scan < new_len) {
+        int64_t oldscore = 0;
+        size_t scsc;
+        for (scsc = scan += len; scan < new_len; scan++) {
+            len = index_search(&ix, new, new_len, scan, &pos);
+            for (; scsc < scan + len; scsc++) {
+                int64_t o = (int64_t)scsc + lastoffset;
+                if (o >= 0 && (size_t)o < old_len && old[o] == new[scsc]) {
+                    oldscore++;
+                }
+            }
+            if (((int64_t)len == oldscore && len != 0) || (int64_t)len > oldscore + 8) {
+                break;
+            }
+            int64_t o = (int64_t)scan + lastoffset;
+            if (o >= 0 && (size_t)o < old_len && old[o] == new[scan]) {
+                oldscore--;
+            }
+        }
+        if ((int64_t)len == oldscore && scan != new_len) {
+            continue;
+        }
+
+        // Extend the previous match forward and this one backward while at
+        // least half the bytes agree, then split any overlap between them
+        size_t lenf = 0;
+        {
+            int64_t s = 0, best = 0;
+            for (size_t i = 0; lastscan + i < scan && lastpos + i < old_len;) {
+                if (old[lastpos + i] == new[lastscan + i]) {
+                    s++;
+                }
+                i++;
+                if (s * 2 - (int64_t)i > best * 2 - (int64_t)lenf) {
+                    best = s;
+                    lenf = i;
+                }
+            }
+        }
+        size_t lenb = 0;
+        if (scan < new_len) {
+            int64_t s = 0, best = 0;
+            for (size_t i = 1; scan >= lastscan + i && pos >= i; i++) {
+                if (old[pos - i] == new[scan - i]) {
+                    s++;
+                }
+                if (s * 2 - (int64_t)i > best * 2 - (int64_t)lenb) {
+                    best = s;
+                    lenb = i;
+                }
+            }
+        }
+        if (lastscan + lenf > scan - lenb) {
+            size_t overlap = (lastscan + lenf) - (scan - lenb);
+            int64_t s = 0, best = 0;
+            size_t lens = 0;
+            for (size_t i = 0; i < overlap; i++) {
+                if (new[lastscan + lenf - overlap + i] == old[lastpos + lenf - overlap + i]) {
+                    s++;
+                }
+                if (new[scan - lenb + i] == old[pos - lenb + i]) {
+                    s--;
+                }
+                if (s > best) {
+                    best = s;
+                    lens = i + 1;
+                }
+            }
+            lenf += lens - overlap;
+            lenb -= lens;
+        }
+
+        size_t extra = (scan - lenb) - (lastscan + lenf);
+        int64_t seek = scan < new_len ? (int64_t)(pos - lenb) - (int64_t)(lastpos + lenf) : 0;
+        put_record(out, old, new, lastscan, lastpos, lenf, extra, seek);
+
+        lastscan = scan - lenb;
+        lastpos = pos - lenb;
+        lastoffset = (int64_t)pos - (int64_t)scan;
+    }
+
+    free(ix.head);
+    free(ix.prev);
+}
+
+// --- Apply, through the same decoder the firmware uses ----------------------
+
+typedef struct {
+    const bytes_t *old;
+    bytes_t *out;
+} apply_ctx_t;
+
+static bool apply_begin(void *ctx, const am7_delta_header_t *hdr)
+{
+    apply_ctx_t *a = ctx;
+    uint8_t digest[32];
+    sha256(a->old->data, a->old->len, digest);
+    return hdr->old_size == a->old->len && memcmp(digest, hdr->old_sha256, 32) == 0;
+}
+
+static bool apply_read_old(void *ctx, uint32_t offset, uint8_t *buf, size_t len)
+{
+    apply_ctx_t *a = ctx;
+    if (offset + len > a->old->len) {
+        return false;
+    }
+    memcpy(buf, a->old->data + offset, len);
+    return true;
+}
+
+static bool apply_write(void *ctx, const uint8_t *data, size_t len)
+{
+    apply_ctx_t *a = ctx;
+    put(a->out, data, len);
+    return true;
+}
+
+static const am7_delta_ops_t apply_ops = {
+    .begin = apply_begin,
+    .read_old = apply_read_old,
+    .write = apply_write,
+};
+
+static bool apply(const bytes_t *old, const bytes_t *patch, bytes_t *out)
+{
+    static am7_delta_t d;
+    apply_ctx_t ctx = {old, out};
+    memset(out, 0, sizeof(*out));
+    am7_delta_init(&d, &apply_ops, &ctx);
+    am7_delta_feed(&d, patch->data, patch->len);
+    if (!am7_delta_done(&d)) {
+        fprintf(stderr, "apply: %s\n", d.error ? am7_delta_strerror(d.error) : "patch truncated");
+        return false;
+    }
+    uint8_t digest[32];
+    sha256(out->data, out->len, digest);
+    if (memcmp(digest, d.header.new_sha256, 32) != 0) {
+        fprintf(stderr, "apply: result does not match the patch's SHA-256\n");
+        return false;
+    }
+    return true;
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: am7_delta diff OLD NEW PATCH\n"
+                    "       am7_delta apply OLD PATCH NEW\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 5) {
+        return usage();
+    }
+    bytes_t old, in, out = {0};
+    if (!read_file(argv[2], &old) || !read_file(argv[3], &in)) {
+        return 1;
+    }
+
+    if (strcmp(argv[1], "diff") == 0) {
+        if (old.len > UINT32_MAX || in.len > UINT32_MAX) {
+            fprintf(stderr, "images larger than 4 GB\n");
+            return 1;
+        }
+        put(&out, AM7_DELTA_MAGIC, 4);
+        put_le32(&out, (uint32_t)old.len);
+        put_le32(&out, (uint32_t)in.len);
+        uint8_t digest[32];
+        sha256(old.data, old.len, digest);
+        put(&out, digest, 32);
+        sha256(in.data, in.len, digest);
+        put(&out, digest, 32);
+        diff(old.data, old.len, in.data, in.len, &out);
+
+        bytes_t check;
+        if (!apply(&old, &out, &check) || check.len != in.len ||
+            (in.len > 0 && memcmp(check.data, in.data, in.len) != 0)) {
+            fprintf(stderr, "diff: patch does not reproduce %s\n", argv[3]);
+            return 1;
+        }
+        if (!write_file(argv[4], out.data, out.len)) {
+            return 1;
+        }
+        printf("%s: %zu bytes, %.1f%% of %zu\n", argv[4], out.len, 100.0 * out.len / (in.len ? in.len : 1),
+               in.len);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "apply") == 0) {
+        if (!apply(&old, &in, &out) || !write_file(argv[4], out.data, out.len)) {
+            return 1;
+        }
+        printf("%s: %zu bytes\n", argv[4], out.len);
+        return 0;
+    }
+    return usage();
+}
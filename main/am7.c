@@ -1,4 +1,9 @@
 #include "am7.h"
+#include "am7_frame.h"
+#include "am7_snapshot.h"
+#include "history.h"
+#include "perf.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -39,20 +44,33 @@ static uint32_t am7_baud_rate = 19200;
 // AM7 protocol expects 28 hex characters: 7 values * 4 chars each
 #define AM7_RESPONSE_LEN 28
 
-// Global sensor data
-am7_data_t am7_data = {0};
+// Latest sensor sample, published by am7_task and read lock-free by consumers
+static am7_snapshot_t am7_snapshot;
+
+// Tasks notified on every new sample
+#define AM7_MAX_LISTENERS 4
+static TaskHandle_t listeners[AM7_MAX_LISTENERS];
+static int listener_count = 0;
 bool am7_connected = false;
 int last_rx_sec = 0;
 
+static uint32_t frames_parsed = 0;
+static uint32_t frames_rejected = 0;
+
 static bool usb_initialized = false;
 static cdc_acm_dev_hdl_t cdc_dev = NULL;
-// DMA-aligned RX buffer (must be aligned to 32-byte cache line for DMA)
-// Static allocation ensures proper memory alignment for direct memory access
-static uint8_t rx_buffer[256] __attribute__((aligned(32))) = {0};
-static size_t rx_buffer_pos = 0;
+static TaskHandle_t am7_task_handle = NULL;
+
+// RX path: USB callback appends raw bytes to the ring and wakes am7_task,
+// which assembles and parses frames outside of USB host context
+static am7_ring_t rx_ring;
+static am7_assembler_t rx_assembler;
 
-// Forward declaration
-static bool am7_parse_data(const uint8_t *data, size_t len, am7_data_t *out);
+PERF_HIST(perf_rx_to_frame, "usb_rx_to_frame");
+PERF_HIST(perf_parse, "frame_parse");
+#if CONFIG_PERF_ENABLED
+static volatile uint32_t rx_first_us = 0;   // arrival of the oldest unparsed bytes, 0 = none
+#endif
 
 static esp_err_t cp210x_configure(uint16_t iface_index)
 {
@@ -103,94 +121,96 @@ static esp_err_t cp210x_configure(uint16_t iface_index)
 }
 
 // USB CDC-ACM data callback
-// Look for frames: 'aa' hex prefix + data, terminated by \r or \n
-// Frame can be 15 bytes (0xaa + 14 binary) or longer (hex format)
+// Runs in USB host context: only append to the RX ring and wake the AM7 task
 static bool cdc_rx_callback(const uint8_t *data, size_t len, void *arg)
 {
-    // Log all received chunks in debug mode
-    if (am7_debug_mode && data && len > 0) {
-        char hex_str[256] = {0};
-        size_t max_bytes = (len > 64) ? 64 : len;
-        for (size_t j = 0; j < max_bytes; j++) {
-            snprintf(hex_str + strlen(hex_str), sizeof(hex_str) - strlen(hex_str) - 1,
-                     "%02X ", data[j]);
+    if (data && len > 0) {
+        am7_ring_write(&rx_ring, data, len);
+#if CONFIG_PERF_ENABLED
+        if (rx_first_us == 0) {
+            rx_first_us = (uint32_t)esp_timer_get_time() | 1;
         }
-        ESP_LOGI(TAG, "[DEBUG] RX chunk: %s (len=%d)", hex_str, (int)len);
-    }
-
-    // Accumulate raw bytes in buffer
-    for (size_t i = 0; i < len; i++) {
-        uint8_t b = data[i];
-
-        // Check buffer state: if empty, only accept 0xaa (binary frame start)
-        if (rx_buffer_pos == 0) {
-            if (b != 0xaa) {
-                // Skip junk bytes
-                continue;
-            }
+#endif
+        if (am7_task_handle) {
+            xTaskNotifyGive(am7_task_handle);
         }
+    }
+    return true;
+}
 
-        // Check if we're about to overflow
-        if (rx_buffer_pos >= sizeof(rx_buffer) - 1) {
-            ESP_LOGW(TAG, "RX buffer overflow, discarding frame");
-            rx_buffer_pos = 0;
-            memset(rx_buffer, 0, sizeof(rx_buffer));
-            continue;
-        }
+static void am7_notify_listeners(void)
+{
+    for (int i = 0; i < listener_count; i++) {
+        xTaskNotifyGive(listeners[i]);
+    }
+}
 
-        // Accumulate byte
-        rx_buffer[rx_buffer_pos++] = b;
+// Log bytes as hex in debug mode (first 64 bytes)
+static void am7_debug_hex(const char *what, const uint8_t *data, size_t len)
+{
+    char hex_str[256] = {0};
+    size_t max_bytes = (len > 64) ? 64 : len;
+    for (size_t j = 0; j < max_bytes; j++) {
+        snprintf(hex_str + strlen(hex_str), sizeof(hex_str) - strlen(hex_str) - 1,
+                 "%02X ", data[j]);
+    }
+    ESP_LOGI(TAG, "[DEBUG] %s: %s (len=%d)", what, hex_str, (int)len);
+}
 
-        // Check for frame completion:
-        bool should_parse = false;
-        
-        // Binary frame: 0xaa prefix + data ending with \r\n
-        // Only parse on proper CRLF termination
-        if (b == '\n' && rx_buffer_pos >= 3) {
-            if (rx_buffer[0] == 0xaa) {
-                // Require \r before \n (proper CRLF)
-                if (rx_buffer_pos >= 2 && rx_buffer[rx_buffer_pos - 2] == '\r') {
-                    should_parse = true;
-                }
-            } else {
-                // Not a valid frame, discard
-                rx_buffer_pos = 0;
-                memset(rx_buffer, 0, sizeof(rx_buffer));
-                continue;
-            }
+// Drain the RX ring through the frame assembler and parse complete frames
+static void am7_process_rx(void)
+{
+    uint8_t chunk[AM7_ASSEMBLER_SIZE];
+    uint8_t frame[AM7_FRAME_LEN];
+    uint32_t checksum_errors = rx_assembler.checksum_errors;
+
+    size_t n;
+    while ((n = am7_ring_read(&rx_ring, chunk, am7_assembler_space(&rx_assembler))) > 0) {
+        if (am7_debug_mode) {
+            am7_debug_hex("RX chunk", chunk, n);
         }
+        am7_assembler_push(&rx_assembler, chunk, n);
 
-        if (should_parse) {
-            // Log raw data in debug mode
+        while (am7_assembler_next(&rx_assembler, frame)) {
             if (am7_debug_mode) {
-                char hex_str[256] = {0};
-                for (size_t j = 0; j < rx_buffer_pos && j < 64; j++) {
-                    snprintf(hex_str + strlen(hex_str), sizeof(hex_str) - strlen(hex_str) - 1, 
-                             "%02X ", rx_buffer[j]);
-                }
-                ESP_LOGI(TAG, "[DEBUG] Raw RX: %s (len=%d)", hex_str, (int)rx_buffer_pos);
+                am7_debug_hex("Raw RX", frame, sizeof(frame));
             }
-            
-            // Trim CR/LF terminators before parsing
-            size_t frame_len = rx_buffer_pos;
-            while (frame_len > 0 && (rx_buffer[frame_len - 1] == '\r' || rx_buffer[frame_len - 1] == '\n')) {
-                frame_len--;
-            }
-
-            // Try to parse this frame
-            if (am7_parse_data(rx_buffer, frame_len, &am7_data)) {
+            am7_data_t data;
+            PERF_BEGIN(parse_start);
+            bool parsed = am7_parse_frame(frame, sizeof(frame), &data);
+            PERF_END(perf_parse, parse_start);
+            if (parsed) {
+                frames_parsed++;
+#if CONFIG_PERF_ENABLED
+                if (rx_first_us != 0) {
+                    PERF_RECORD_US(perf_rx_to_frame, (uint32_t)esp_timer_get_time() - rx_first_us);
+                    rx_first_us = 0;
+                }
+#endif
+                am7_snapshot_publish(&am7_snapshot, &data, esp_timer_get_time());
                 last_rx_sec = 0;
                 am7_connected = true;
+                am7_notify_listeners();
+                history_add(&data);
                 ESP_LOGI(TAG, "Parsed: PM2.5=%d PM10=%d HCHO=%.3f TVOC=%.2f CO2=%d Temp=%.1f Hum=%.1f",
-                         am7_data.pm25, am7_data.pm10, am7_data.hcho, am7_data.tvoc, am7_data.co2, am7_data.temp, am7_data.humidity);
+                         data.pm25, data.pm10, data.hcho, data.tvoc, data.co2, data.temp, data.humidity);
+            } else {
+                frames_rejected++;
+                ESP_LOGD(TAG, "Rejecting incorrect frame (wrong data)");
             }
-
-            // Reset for next frame
-            rx_buffer_pos = 0;
-            memset(rx_buffer, 0, sizeof(rx_buffer));
         }
     }
-    return true;
+
+    if (rx_assembler.checksum_errors != checksum_errors) {
+        ESP_LOGW(TAG, "Checksum failed on %u frame(s)", (unsigned)(rx_assembler.checksum_errors - checksum_errors));
+    }
+
+    static uint32_t dropped_reported = 0;
+    uint32_t dropped = atomic_load(&rx_ring.dropped);
+    if (dropped != dropped_reported) {
+        ESP_LOGW(TAG, "RX ring overflow, %u byte(s) dropped", (unsigned)(dropped - dropped_reported));
+        dropped_reported = dropped;
+    }
 }
 
 // USB Host library event handler task
@@ -335,74 +355,17 @@ static bool am7_send_request(void)
     return true;
 }
 
-// Parse AM7 sensor data from binary response
-// Response format: 0xaa (1 byte) + 7 uint16_t values (14 bytes)
-// Extended format: + battery, runtime, particle counts (+ checksum at bytes 36-37)
-// Values: PM2.5, PM10, HCHO, TVOC, CO2, Temp, Humidity (all big-endian uint16_t)
-static bool am7_parse_data(const uint8_t *data, size_t len, am7_data_t *out)
-{
-    // Full frame: 0xAA + 14 bytes sensors + 22 bytes extended + 2 bytes checksum = 39 bytes (38 after CRLF trim)
-    if (!data || !out || len < 38) {
-        return false;
-    }
-
-    // Must start with 0xaa marker
-    if (data[0] != 0xaa) {
-        return false;
-    }
-
-    // Validate checksum (always present in full frame)
-    uint16_t calculated_sum = 0;
-    // Sum bytes 0-35 (includes 0xAA header through reserved fields)
-    for (int i = 0; i < 36; i++) {
-        calculated_sum += data[i];
-    }
-    uint16_t frame_checksum = ((uint16_t)data[36] << 8) | (uint16_t)data[37];
-    if (calculated_sum != frame_checksum) {
-        ESP_LOGW(TAG, "Checksum failed: calculated=0x%04X, frame=0x%04X", calculated_sum, frame_checksum);
-        return false;
-    }
-
-    // Extract up to 7 uint16_t values starting at byte 1 (big-endian)
-    uint16_t values[7] = {0};
-    size_t available_pairs = 7;
-    for (size_t i = 0; i < available_pairs; i++) {
-        values[i] = ((uint16_t)data[1 + i*2] << 8) | (uint16_t)data[1 + i*2 + 1];
-    }
-    
-    // Validate: reject frames with invalid data
-    if (values[4] == 0) {
-        ESP_LOGD(TAG, "Rejecting incorrect frame (wrong data)");
-        return false;
-    }
-    
-    // Convert to sensor readings with appropriate scaling
-    out->pm25 = values[0];           // PM2.5 in µg/m³
-    out->pm10 = values[1];           // PM10 in µg/m³
-    out->hcho = values[2] / 1000.0;  // HCHO in mg/m³
-    out->tvoc = values[3] / 1000.0;  // TVOC in mg/m³
-    out->co2 = values[4];            // CO2 in ppm
-    out->temp = values[5] / 100.0;   // Temperature in °C
-    out->humidity = values[6] / 100.0; // Humidity in %
-
-    // Extended fields
-    out->battery_status = data[15];
-    out->battery_level = data[16];
-    out->runtime_hours = ((uint16_t)data[17] << 8) | (uint16_t)data[18];
-    out->pc03 = ((uint16_t)data[19] << 8) | (uint16_t)data[20];
-    out->pc05 = ((uint16_t)data[21] << 8) | (uint16_t)data[22];
-    out->pc10 = ((uint16_t)data[23] << 8) | (uint16_t)data[24];
-    out->pc25 = ((uint16_t)data[25] << 8) | (uint16_t)data[26];
-    out->pc50 = ((uint16_t)data[27] << 8) | (uint16_t)data[28];
-    out->pc100 = ((uint16_t)data[29] << 8) | (uint16_t)data[30];
-
-    return true;
-}
-
 // AM7 polling task
 void am7_task(void *arg)
 {
     ESP_LOGI(TAG, "AM7 task started");
+
+    am7_snapshot_init(&am7_snapshot);
+    am7_ring_init(&rx_ring);
+    am7_assembler_init(&rx_assembler);
+    am7_task_handle = xTaskGetCurrentTaskHandle();
+    PERF_REGISTER(perf_rx_to_frame);
+    PERF_REGISTER(perf_parse);
     
     // Initialize USB Host
     if (!am7_usb_init()) {
@@ -438,9 +401,20 @@ void am7_task(void *arg)
     // Device connected, start polling loop
     ESP_LOGI(TAG, "Starting AM7 polling loop");
     uint32_t poll_counter = 0;
+    TickType_t last_tick = xTaskGetTickCount();
     
     while (1) {
-        // Send request every 3 seconds
+        // Sleep until RX data arrives or the next 1 s tick is due
+        TickType_t elapsed = xTaskGetTickCount() - last_tick;
+        if (elapsed < pdMS_TO_TICKS(1000)) {
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000) - elapsed) > 0) {
+                am7_process_rx();
+            }
+            continue;
+        }
+        last_tick += pdMS_TO_TICKS(1000);
+
+        // Send request every 5 seconds
         if (poll_counter % 5 == 0) {
             if (am7_send_request()) {
                 ESP_LOGD(TAG, "Request sent");
@@ -457,33 +431,49 @@ void am7_task(void *arg)
         }
         
         poll_counter++;
-        vTaskDelay(pdMS_TO_TICKS(1000));
     }
 
 simulated_mode:
     ESP_LOGW(TAG, "Using simulated data (all zeros)");
     
-    // Initialize simulated data
-    am7_data.temp = 0.0;
-    am7_data.humidity = 0.0;
-    am7_data.co2 = 0;
-    am7_data.pm25 = 0;
-    am7_data.pm10 = 0;
-    am7_data.tvoc = 0.0;
-    am7_data.hcho = 0.0;
-    am7_data.battery_status = 0;
-    am7_data.battery_level = 0;
-    am7_data.runtime_hours = 0;
-    am7_data.pc03 = 0;
-    am7_data.pc05 = 0;
-    am7_data.pc10 = 0;
-    am7_data.pc25 = 0;
-    am7_data.pc50 = 0;
-    am7_data.pc100 = 0;
+    // Publish a single all-zero sample
+    am7_data_t simulated = {0};
+    am7_snapshot_publish(&am7_snapshot, &simulated, esp_timer_get_time());
     am7_connected = true;
     last_rx_sec = 0;
+    am7_notify_listeners();
     
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
+
+bool am7_get_sample(am7_sample_t *out)
+{
+    return am7_snapshot_acquire(&am7_snapshot, out);
+}
+
+uint32_t am7_get_sample_seq(void)
+{
+    return am7_snapshot_seq(&am7_snapshot);
+}
+
+void am7_add_listener(TaskHandle_t task)
+{
+    // Listeners register once at task start-up, before any concurrent notify matters
+    if (listener_count < AM7_MAX_LISTENERS) {
+        listeners[listener_count] = task;
+        listener_count++;
+    } else {
+        ESP_LOGW(TAG, "Too many sample listeners");
+    }
+}
+
+void am7_get_stats(am7_stats_t *out)
+{
+    out->frames = frames_parsed;
+    out->rejected = frames_rejected;
+    out->checksum_errors = rx_assembler.checksum_errors;
+    out->resyncs = rx_assembler.resyncs;
+    out->rx_dropped = atomic_load(&rx_ring.dropped);
+}
@@ -1,29 +1,30 @@
 #pragma once
 #include <stdbool.h>
 #include <stdint.h>
+#include "am7_snapshot.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
-typedef struct {
-    float temp;
-    float humidity;
-    int co2;
-    int pm25;
-    int pm10;
-    float tvoc;
-    float hcho;
-    int battery_status;   // 0 = battery, 1 = charging
-    int battery_level;    // 1-4 bars
-    int runtime_hours;    // cumulative runtime
-    int pc03;             // >0.3 µm particle count
-    int pc05;             // >0.5 µm particle count
-    int pc10;             // >1.0 µm particle count
-    int pc25;             // >2.5 µm particle count
-    int pc50;             // >5.0 µm particle count
-    int pc100;            // >10 µm particle count
-} am7_data_t;
-
-extern am7_data_t am7_data;
 extern bool am7_connected;
 extern int last_rx_sec;
 extern bool am7_debug_mode;  // Runtime debug toggle (not persisted)
 
 void am7_task(void *arg); // FreeRTOS task
+
+// Consistent copy of the latest sample; false until the first frame arrives
+bool am7_get_sample(am7_sample_t *out);
+// Sequence of the latest sample: cheap check whether anything new arrived
+uint32_t am7_get_sample_seq(void);
+// Wake a task (xTaskNotifyGive) whenever a new sample is published
+void am7_add_listener(TaskHandle_t task);
+
+// Receive path counters since boot
+typedef struct {
+    uint32_t frames;            // parsed successfully
+    uint32_t rejected;          // valid checksum, implausible values
+    uint32_t checksum_errors;
+    uint32_t resyncs;           // frame markers without a valid frame behind them
+    uint32_t rx_dropped;        // bytes lost to RX ring overflow
+} am7_stats_t;
+
+void am7_get_stats(am7_stats_t *out);
@@ -11,13 +11,52 @@
 #define CONFIG_SPIFFS_BASE_PATH "/spiffs"
 #define CONFIG_SPIFFS_MAX_FILES 10
 
+// Web UI bundle (tools/www_pack.py): the raw content of the partition, or
+// for images from older builds a file in SPIFFS
+#define CONFIG_WWW_PARTITION_LABEL "spiffs"
+#define CONFIG_WWW_BUNDLE_PATH "/spiffs/www.bin"
+#define CONFIG_WWW_MAX_FILES 32
+#define CONFIG_WWW_CHUNK_SIZE 1024         // Bundle read size per response chunk
+
 // Logging Configuration
 #define CONFIG_MAX_LOG_LINES 100
 #define CONFIG_MAX_LOG_MESSAGE_LENGTH 200
 
+// Persistent log journal (lines at or above the level are written to flash)
+#define CONFIG_LOGSTORE_PARTITION_LABEL "logs"
+#define CONFIG_LOGSTORE_LEVEL 3            // ESP_LOG_INFO
+#define CONFIG_LOGSTORE_FLUSH_MS 10000     // Longest a line waits in RAM before it is written
+#define CONFIG_LOGSTORE_PAGE_SIZE 512      // Journal write size
+#define CONFIG_LOGSTORE_TAIL_LINES 200     // Default /api/logs/previous length
+
 // Crash Logging Configuration
 #define CONFIG_CRASHLOG_NAMESPACE "crashlog"
 #define CONFIG_CRASHLOG_MAX_ENTRIES 10
+#define CONFIG_COREDUMP_CHUNK_SIZE 2048    // /api/coredump read size
+
+// Home Assistant discovery
+#define CONFIG_MQTT_DISCOVERY_BUF_SIZE 768  // Longest discovery config payload
+
+// Store-and-forward queue (MQTT samples buffered in flash while offline)
+#define CONFIG_SFQ_PARTITION_LABEL "sfq"
+#define CONFIG_SFQ_DRAIN_BATCH 10          // Backlog records published per drain step
+#define CONFIG_SFQ_DRAIN_PERIOD_MS 1000    // Pause between drain steps
+
+// Sensor history
+#define CONFIG_HISTORY_PARTITION_LABEL "history"
+#define CONFIG_HISTORY_MAX_POINTS 3600     // Largest /api/history response (buckets)
+#define CONFIG_HISTORY_JOURNAL_QUEUE 4     // Closed 15 min buckets waiting for flash
+#define CONFIG_HISTORY_JOURNAL_STACK 3072
+
+// Runtime metrics (/api/metrics)
+#define CONFIG_METRICS_MAX_TASKS 32
+
+// Hot-path latency probes (perf.h); 0 compiles them out
+#define CONFIG_PERF_ENABLED 1
+#define CONFIG_PERF_MQTT_PERIOD_S 300      // <topic>/diagnostics publish period
+
+// Time Configuration
+#define CONFIG_SNTP_SERVER "pool.ntp.org"
 
 // DNS/Captive Portal Configuration
 #define CONFIG_DNS_PORT 53
@@ -29,6 +68,34 @@
 #define CONFIG_AM7_PID 0xEA60  // CP2102
 
 // HTTP Server Configuration
-#define CONFIG_HTTPD_MAX_URI_HANDLERS 24
+#define CONFIG_HTTPD_MAX_URI_HANDLERS 8   // Routes live in webserver.c's table; httpd sees the catch-alls
+#define CONFIG_HTTPD_MAX_PATH_LEN 64
+#define CONFIG_HTTPD_WORKERS 2            // Tasks running slow handlers (OTA, history, reboot)
+#define CONFIG_HTTPD_WORKER_QUEUE 2       // Slow requests waiting for a worker before 503
+#define CONFIG_HTTPD_WORKER_STACK 4096
+#define CONFIG_HTTPD_MAX_BODY_LEN 2048  // Largest JSON body accepted by API handlers
+#define CONFIG_HTTPD_MAX_OPEN_SOCKETS 7  // Includes WebSocket clients and requests held by workers
+#define CONFIG_HTTPD_JSON_CHUNK_SIZE 512  // Stack buffer of streamed JSON responses
+
+// Live push (/ws)
+#define CONFIG_LIVE_PERIOD_MS 1000       // Status/log delta check interval
+#define CONFIG_LIVE_RSSI_DELTA 3         // dBm change before RSSI is pushed
+#define CONFIG_LIVE_MSG_SIZE 2048        // Static buffer of one pushed message
+
+// Firmware upload pipeline (/api/ota): receive into one buffer while the
+// previous one is written to flash
+#define CONFIG_OTA_PIPE_BUFS 2
+#define CONFIG_OTA_PIPE_BUF_SIZE 16384   // Multiple of the 4 KB flash sector
+#define CONFIG_OTA_PIPE_STACK 4096
+
+// Pull updates (ota_pull.c): manifest polled from settings' ota_url
+#define CONFIG_OTA_PULL_FIRST_S 300        // First check after boot, plus jitter
+#define CONFIG_OTA_PULL_PERIOD_S 21600     // Between checks, plus jitter
+#define CONFIG_OTA_PULL_JITTER_S 3600      // Random spread so a fleet doesn't poll in step
+#define CONFIG_OTA_PULL_RETRIES 5          // Reconnects without progress before giving up
+#define CONFIG_OTA_PULL_RETRY_MS 5000      // First reconnect delay, doubled each time
+#define CONFIG_OTA_PULL_TIMEOUT_MS 10000
+#define CONFIG_OTA_PULL_MANIFEST_LEN 1024
+#define CONFIG_OTA_PULL_STACK 6144
 
 #endif // CONFIG_H
@@ -1,15 +1,21 @@
 #include "crashlog.h"
 #include "esp_log.h"
+#include "esp_core_dump.h"
 #include "esp_system.h"
 #include "esp_timer.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "config.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 
 static const char *TAG = "CRASHLOG";
 
+static uint32_t current_boot_count = 0;
+static crashlog_coredump_t coredump;
+
 typedef struct {
     uint32_t boot_count;
     uint32_t reset_reason;
@@ -29,6 +35,38 @@ static bool is_crash_reset(esp_reset_reason_t reason)
     }
 }
 
+// The image stays in flash until erased, so the summary describes the last
+// crash that produced a dump, not necessarily the last reset
+static void load_coredump_summary(void)
+{
+    size_t addr = 0;
+    size_t size = 0;
+    if (esp_core_dump_image_check() != ESP_OK || esp_core_dump_image_get(&addr, &size) != ESP_OK) {
+        return;
+    }
+
+    esp_core_dump_summary_t *summary = malloc(sizeof(*summary));
+    if (!summary) {
+        return;
+    }
+    if (esp_core_dump_get_summary(summary) == ESP_OK) {
+        coredump.present = true;
+        coredump.size = size;
+        strlcpy(coredump.task, summary->exc_task, sizeof(coredump.task));
+        coredump.pc = summary->exc_pc;
+        coredump.depth = summary->exc_bt_info.depth;
+        if (coredump.depth > CRASHLOG_BACKTRACE_DEPTH) {
+            coredump.depth = CRASHLOG_BACKTRACE_DEPTH;
+        }
+        memcpy(coredump.backtrace, summary->exc_bt_info.bt, coredump.depth * sizeof(uint32_t));
+        coredump.corrupted = summary->exc_bt_info.corrupted;
+        strlcpy(coredump.app_sha256, (const char *)summary->app_elf_sha256, sizeof(coredump.app_sha256));
+        ESP_LOGW(TAG, "Core dump present: task %s, PC 0x%08" PRIx32 " (%u bytes)",
+                 coredump.task, coredump.pc, (unsigned)size);
+    }
+    free(summary);
+}
+
 void crashlog_init(void)
 {
     esp_reset_reason_t reason = esp_reset_reason();
@@ -47,6 +85,7 @@ void crashlog_init(void)
     }
     boot_count++;
     nvs_set_u32(nvs, "boot_count", boot_count);
+    current_boot_count = boot_count;
 
     if (is_crash_reset(reason)) {
         uint32_t crash_count = 0;
@@ -73,4 +112,24 @@ void crashlog_init(void)
 
     nvs_commit(nvs);
     nvs_close(nvs);
+
+    load_coredump_summary();
+}
+
+uint32_t crashlog_get_boot_count(void)
+{
+    return current_boot_count;
+}
+
+const crashlog_coredump_t *crashlog_get_coredump(void)
+{
+    return &coredump;
+}
+
+void crashlog_erase_coredump(void)
+{
+    if (esp_core_dump_image_erase() == ESP_OK) {
+        memset(&coredump, 0, sizeof(coredump));
+        ESP_LOGI(TAG, "Core dump erased");
+    }
 }
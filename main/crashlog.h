@@ -1,6 +1,27 @@
 #ifndef CRASHLOG_H
 #define CRASHLOG_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRASHLOG_BACKTRACE_DEPTH 16
+
+// Summary of the core dump stored in the coredump partition, read at boot
+typedef struct {
+    bool present;
+    size_t size;                 // ELF image bytes
+    char task[16];               // task that crashed
+    uint32_t pc;
+    uint32_t backtrace[CRASHLOG_BACKTRACE_DEPTH];
+    uint32_t depth;
+    bool corrupted;              // backtrace stopped at a corrupted frame
+    char app_sha256[9];          // ELF hash prefix of the firmware that crashed
+} crashlog_coredump_t;
+
 void crashlog_init(void);
+uint32_t crashlog_get_boot_count(void);
+const crashlog_coredump_t *crashlog_get_coredump(void);
+void crashlog_erase_coredump(void);
 
 #endif // CRASHLOG_H
@@ -0,0 +1,228 @@
+#include "gunzip.h"
+#include "rom/miniz.h"
+#include "esp_rom_crc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// gzip member (RFC 1952): 10-byte header, optional fields by flag, deflate
+// data, then CRC-32 and size of the output, both little-endian
+#define GZ_FHCRC    0x02
+#define GZ_FEXTRA   0x04
+#define GZ_FNAME    0x08
+#define GZ_FCOMMENT 0x10
+#define GZ_RESERVED 0xe0
+
+enum {
+    GZ_HEADER,
+    GZ_EXTRA_LEN,
+    GZ_EXTRA,
+    GZ_NAME,
+    GZ_COMMENT,
+    GZ_HCRC,
+    GZ_DATA,
+    GZ_TRAILER,
+    GZ_DONE,
+    GZ_ERROR,
+};
+
+struct gunzip {
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE];   // output goes round this; tinfl needs it whole
+    size_t window_pos;
+    gunzip_out_fn out;
+    void *ctx;
+    uint8_t state;
+    uint8_t flags;          // optional header fields still to skip
+    uint8_t field[10];      // fixed header, extra length or trailer being gathered
+    size_t field_len;
+    uint32_t skip;          // FEXTRA bytes left
+    uint32_t crc;
+    uint32_t size;
+};
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool gunzip_is_gzip(const uint8_t *data, size_t len)
+{
+    return len >= 3 && data[0] == 0x1f && data[1] == 0x8b && data[2] == 8;
+}
+
+gunzip_t *gunzip_new(gunzip_out_fn out, void *ctx)
+{
+    // The window needs no clearing and the inflator is set up after the header
+    gunzip_t *gz = malloc(sizeof(*gz));
+    if (!gz) {
+        return NULL;
+    }
+    gz->window_pos = 0;
+    gz->out = out;
+    gz->ctx = ctx;
+    gz->state = GZ_HEADER;
+    gz->flags = 0;
+    gz->field_len = 0;
+    gz->skip = 0;
+    gz->crc = 0;
+    gz->size = 0;
+    return gz;
+}
+
+void gunzip_free(gunzip_t *gz)
+{
+    free(gz);
+}
+
+// Copy up to want bytes into field; true once it holds want
+static bool gather(gunzip_t *gz, size_t want, const uint8_t **data, size_t *len)
+{
+    size_t k = want - gz->field_len;
+    if (k > *len) {
+        k = *len;
+    }
+    memcpy(gz->field + gz->field_len, *data, k);
+    gz->field_len += k;
+    *data += k;
+    *len -= k;
+    if (gz->field_len < want) {
+        return false;
+    }
+    gz->field_len = 0;
+    return true;
+}
+
+// The next optional header field, or the deflate data
+static void next_field(gunzip_t *gz)
+{
+    if (gz->flags & GZ_FEXTRA) {
+        gz->flags &= ~GZ_FEXTRA;
+        gz->state = GZ_EXTRA_LEN;
+    } else if (gz->flags & GZ_FNAME) {
+        gz->flags &= ~GZ_FNAME;
+        gz->state = GZ_NAME;
+    } else if (gz->flags & GZ_FCOMMENT) {
+        gz->flags &= ~GZ_FCOMMENT;
+        gz->state = GZ_COMMENT;
+    } else if (gz->flags & GZ_FHCRC) {
+        gz->flags &= ~GZ_FHCRC;
+        gz->state = GZ_HCRC;
+    } else {
+        tinfl_init(&gz->inflator);
+        gz->state = GZ_DATA;
+    }
+}
+
+static esp_err_t inflate_some(gunzip_t *gz, const uint8_t **data, size_t *len)
+{
+    for (;;) {
+        size_t in = *len;
+        size_t out = sizeof(gz->window) - gz->window_pos;
+        tinfl_status status = tinfl_decompress(&gz->inflator, *data, &in, gz->window, gz->window + gz->window_pos,
+                                               &out, TINFL_FLAG_HAS_MORE_INPUT);
+        *data += in;
+        *len -= in;
+        if (out > 0) {
+            const uint8_t *produced = gz->window + gz->window_pos;
+            gz->crc = esp_rom_crc32_le(gz->crc, produced, out);
+            gz->size += out;
+            gz->window_pos = (gz->window_pos + out) & (sizeof(gz->window) - 1);
+            esp_err_t ret = gz->out(gz->ctx, produced, out);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+        if (status == TINFL_STATUS_DONE) {
+            gz->state = GZ_TRAILER;
+            return ESP_OK;
+        }
+        if (status < 0) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return ESP_OK;
+        }
+    }
+}
+
+esp_err_t gunzip_feed(gunzip_t *gz, const uint8_t *data, size_t len)
+{
+    esp_err_t ret = ESP_OK;
+    while (len > 0 && ret == ESP_OK) {
+        switch (gz->state) {
+            case GZ_HEADER:
+                if (gather(gz, 10, &data, &len)) {
+                    if (!gunzip_is_gzip(gz->field, 10) || (gz->field[3] & GZ_RESERVED)) {
+                        ret = ESP_ERR_INVALID_RESPONSE;
+                        break;
+                    }
+                    gz->flags = gz->field[3];
+                    next_field(gz);
+                }
+                break;
+
+            case GZ_EXTRA_LEN:
+                if (gather(gz, 2, &data, &len)) {
+                    gz->skip = gz->field[0] | gz->field[1] << 8;
+                    gz->state = GZ_EXTRA;
+                }
+                break;
+
+            case GZ_EXTRA: {
+                size_t k = gz->skip < len ? gz->skip : len;
+                data += k;
+                len -= k;
+                gz->skip -= k;
+                if (gz->skip == 0) {
+                    next_field(gz);
+                }
+                break;
+            }
+
+            case GZ_NAME:
+            case GZ_COMMENT: {
+                const uint8_t *end = memchr(data, 0, len);
+                size_t k = end ? (size_t)(end - data) + 1 : len;
+                data += k;
+                len -= k;
+                if (end) {
+                    next_field(gz);
+                }
+                break;
+            }
+
+            case GZ_HCRC:
+                if (gather(gz, 2, &data, &len)) {
+                    next_field(gz);
+                }
+                break;
+
+            case GZ_DATA:
+                ret = inflate_some(gz, &data, &len);
+                break;
+
+            case GZ_TRAILER:
+                if (gather(gz, 8, &data, &len)) {
+                    if (get_le32(gz->field) != gz->crc || get_le32(gz->field + 4) != gz->size) {
+                        ret = ESP_ERR_INVALID_RESPONSE;
+                        break;
+                    }
+                    gz->state = GZ_DONE;
+                }
+                break;
+
+            default:
+                ret = ESP_ERR_INVALID_RESPONSE;   // data past the end, or an earlier error
+                break;
+        }
+    }
+    if (ret != ESP_OK) {
+        gz->state = GZ_ERROR;
+    }
+    return ret;
+}
+
+esp_err_t gunzip_finish(const gunzip_t *gz)
+{
+    return gz->state == GZ_DONE ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming gunzip for uploads: a gzip stream fed in pieces of any size is
+// inflated by the ROM's tinfl into a fixed 32 KB window (the deflate maximum)
+// and handed to a callback as it is produced. CRC-32 and length from the
+// gzip trailer are checked. About 43 KB, allocated per stream.
+
+typedef esp_err_t (*gunzip_out_fn)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct gunzip gunzip_t;
+
+bool gunzip_is_gzip(const uint8_t *data, size_t len);
+
+gunzip_t *gunzip_new(gunzip_out_fn out, void *ctx);   // NULL when out of memory
+// ESP_ERR_INVALID_RESPONSE on malformed data, else what out returned
+esp_err_t gunzip_feed(gunzip_t *gz, const uint8_t *data, size_t len);
+// ESP_OK once the whole stream, trailer included, has been fed
+esp_err_t gunzip_finish(const gunzip_t *gz);
+void gunzip_free(gunzip_t *gz);
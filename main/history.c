@@ -0,0 +1,295 @@
+#include "history.h"
+#include "am7_record.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "HISTORY";
+
+#define HISTORY_TIERS 3
+#define HISTORY_PERSIST_TIER 2
+
+// Clock counts as set once it is past this point (2020-01-01)
+#define HISTORY_MIN_VALID_TIME 1577836800
+
+typedef struct {
+    uint32_t res;
+    uint32_t span;        // seconds covered with PSRAM
+    uint32_t span_lite;   // seconds covered from internal RAM
+} history_tier_cfg_t;
+
+static const history_tier_cfg_t tier_cfg[HISTORY_TIERS] = {
+    {1,   3600,         120},
+    {60,  24 * 3600,    3 * 3600},
+    {900, 30 * 86400,   86400},
+};
+
+static am7_hist_tier_t tiers[HISTORY_TIERS];
+static SemaphoreHandle_t history_mutex = NULL;
+
+// Flash journal of closed buckets of the persisted tier: a ring of sectors,
+// each with a sequence-numbered header, filled with fixed-size records and
+// erased in rotation (same scheme as the offline MQTT queue).
+#define HISTORY_SECTOR_SIZE 4096
+#define HISTORY_MAGIC 0x31545348  // "HST1"
+#define HISTORY_RECORDS_PER_SECTOR ((HISTORY_SECTOR_SIZE - sizeof(history_sector_hdr_t)) / sizeof(history_record_t))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t reserved[2];
+} history_sector_hdr_t;
+
+typedef struct {
+    uint32_t bucket;
+    uint16_t crc;         // over stats
+    uint16_t reserved;
+    am7_hist_stat_t stats[AM7_FIELD_COUNT];
+} history_record_t;
+
+static const esp_partition_t *part = NULL;
+static uint32_t sector_count = 0;
+static uint32_t head_sector = 0;
+static uint32_t head_seq = 0;
+static uint32_t head_index = 0;
+
+// Closed buckets go to the journal from their own task: starting a sector
+// erases 4 KB, which can stall the caller for tens of milliseconds, and
+// history_add runs on am7_task between USB reads
+static QueueHandle_t journal_queue = NULL;
+
+static bool read_header(uint32_t sector, history_sector_hdr_t *hdr)
+{
+    return esp_partition_read(part, sector * HISTORY_SECTOR_SIZE, hdr, sizeof(*hdr)) == ESP_OK &&
+           hdr->magic == HISTORY_MAGIC;
+}
+
+static esp_err_t start_sector(uint32_t sector, uint32_t seq)
+{
+    esp_err_t ret = esp_partition_erase_range(part, sector * HISTORY_SECTOR_SIZE, HISTORY_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    history_sector_hdr_t hdr = {.magic = HISTORY_MAGIC, .seq = seq};
+    return esp_partition_write(part, sector * HISTORY_SECTOR_SIZE, &hdr, sizeof(hdr));
+}
+
+// Replay the journal, oldest sector first, into the persisted tier
+static void journal_restore(void)
+{
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                    CONFIG_HISTORY_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "No '%s' partition, history is not persisted", CONFIG_HISTORY_PARTITION_LABEL);
+        return;
+    }
+    sector_count = part->size / HISTORY_SECTOR_SIZE;
+
+    bool found = false;
+    history_sector_hdr_t hdr;
+    for (uint32_t s = 0; s < sector_count; s++) {
+        if (read_header(s, &hdr) && (!found || (int32_t)(hdr.seq - head_seq) > 0)) {
+            head_sector = s;
+            head_seq = hdr.seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        head_sector = 0;
+        head_seq = 1;
+        head_index = 0;
+        start_sector(0, head_seq);
+        return;
+    }
+
+    uint32_t oldest = head_sector;
+    for (uint32_t back = 1; back < sector_count; back++) {
+        uint32_t s = (head_sector + sector_count - back) % sector_count;
+        if (!read_header(s, &hdr) || hdr.seq != head_seq - back) {
+            break;
+        }
+        oldest = s;
+    }
+
+    uint32_t restored = 0;
+    history_record_t rec;
+    head_index = HISTORY_RECORDS_PER_SECTOR;
+    for (uint32_t s = oldest;; s = (s + 1) % sector_count) {
+        for (uint32_t i = 0; i < HISTORY_RECORDS_PER_SECTOR; i++) {
+            size_t offset = s * HISTORY_SECTOR_SIZE + sizeof(history_sector_hdr_t) + i * sizeof(rec);
+            if (esp_partition_read(part, offset, &rec, sizeof(rec)) != ESP_OK || rec.bucket == 0xFFFFFFFF) {
+                if (s == head_sector) {
+                    head_index = i;
+                }
+                break;
+            }
+            if (rec.crc == am7_crc16(rec.stats, sizeof(rec.stats))) {
+                am7_hist_tier_put(&tiers[HISTORY_PERSIST_TIER], rec.bucket, rec.stats);
+                restored++;
+            }
+        }
+        if (s == head_sector) {
+            break;
+        }
+    }
+    ESP_LOGI(TAG, "Restored %lu buckets from flash", (unsigned long)restored);
+}
+
+static void journal_append(const history_record_t *rec)
+{
+    if (head_index == HISTORY_RECORDS_PER_SECTOR) {
+        uint32_t next = (head_sector + 1) % sector_count;
+        if (start_sector(next, head_seq + 1) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start sector %lu", (unsigned long)next);
+            return;
+        }
+        head_sector = next;
+        head_seq++;
+        head_index = 0;
+    }
+
+    size_t offset = head_sector * HISTORY_SECTOR_SIZE + sizeof(history_sector_hdr_t) + head_index * sizeof(*rec);
+    if (esp_partition_write(part, offset, rec, sizeof(*rec)) != ESP_OK) {
+        ESP_LOGE(TAG, "Journal write failed");
+    }
+    head_index++;
+}
+
+static void journal_task(void *arg)
+{
+    history_record_t rec;
+    for (;;) {
+        xQueueReceive(journal_queue, &rec, portMAX_DELAY);
+        journal_append(&rec);
+    }
+}
+
+esp_err_t history_init(void)
+{
+    history_mutex = xSemaphoreCreateMutex();
+    if (!history_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Full-size tiers need PSRAM; internal RAM gets the short spans
+    bool psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+    uint32_t caps = psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    size_t total = 0;
+
+    for (int i = 0; i < HISTORY_TIERS; i++) {
+        uint32_t cap = (psram ? tier_cfg[i].span : tier_cfg[i].span_lite) / tier_cfg[i].res;
+        size_t size = am7_hist_tier_size(cap);
+        void *mem = heap_caps_malloc(size, caps);
+        if (!mem) {
+            ESP_LOGE(TAG, "No memory for %lu s tier (%u bytes)", (unsigned long)tier_cfg[i].res, (unsigned)size);
+            tiers[0].cap = 0;  // Disables history_add/history_query
+            return ESP_ERR_NO_MEM;
+        }
+        am7_hist_tier_init(&tiers[i], tier_cfg[i].res, cap, mem);
+        total += size;
+    }
+    ESP_LOGI(TAG, "History tiers: %u KB in %s", (unsigned)(total / 1024), psram ? "PSRAM" : "internal RAM");
+
+    journal_restore();
+    if (part) {
+        journal_queue = xQueueCreate(CONFIG_HISTORY_JOURNAL_QUEUE, sizeof(history_record_t));
+        if (!journal_queue ||
+            xTaskCreate(journal_task, "history_jrnl", CONFIG_HISTORY_JOURNAL_STACK, NULL, 2, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start journal task, history is not persisted");
+            journal_queue = NULL;
+        }
+    }
+    return ESP_OK;
+}
+
+uint32_t history_now(void)
+{
+    time_t now = time(NULL);
+    if (now >= HISTORY_MIN_VALID_TIME) {
+        return (uint32_t)now;
+    }
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+void history_add(const am7_data_t *data)
+{
+    if (!history_mutex || !tiers[0].cap) {
+        return;
+    }
+
+    uint16_t raw[AM7_FIELD_COUNT];
+    for (int f = 0; f < AM7_FIELD_COUNT; f++) {
+        raw[f] = am7_field_raw(data, (am7_field_t)f);
+    }
+
+    uint32_t t = history_now();
+    uint32_t closed = 0;
+    bool persist = false;
+    am7_hist_stat_t stats[AM7_FIELD_COUNT];
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    for (int i = 0; i < HISTORY_TIERS; i++) {
+        if (am7_hist_tier_add(&tiers[i], t, raw, &closed) && i == HISTORY_PERSIST_TIER) {
+            persist = am7_hist_tier_get_all(&tiers[i], closed, stats);
+        }
+    }
+    xSemaphoreGive(history_mutex);
+
+    // Uptime-based buckets are meaningless after a reboot, keep them in RAM
+    // only. Judged by the bucket itself: the one closed when SNTP first sets
+    // the clock is still an uptime bucket.
+    if (persist && closed * tiers[HISTORY_PERSIST_TIER].res >= HISTORY_MIN_VALID_TIME && journal_queue) {
+        history_record_t rec = {.bucket = closed, .reserved = 0xFFFF};
+        memcpy(rec.stats, stats, sizeof(rec.stats));
+        rec.crc = am7_crc16(rec.stats, sizeof(rec.stats));
+        if (xQueueSend(journal_queue, &rec, 0) != pdTRUE) {
+            ESP_LOGW(TAG, "Journal busy, bucket %lu not persisted", (unsigned long)closed);
+        }
+    }
+}
+
+bool history_query(am7_field_t field, uint32_t from, uint32_t to, uint32_t res, uint32_t max,
+                   am7_hist_stat_t *out, bool *present, history_range_t *range)
+{
+    if (!history_mutex || !tiers[0].cap || field >= AM7_FIELD_COUNT || to <= from || max == 0) {
+        return false;
+    }
+
+    // Finest tier that is coarse enough and still holds the start of the range
+    uint32_t now = history_now();
+    const am7_hist_tier_t *tier = &tiers[HISTORY_TIERS - 1];
+    for (int i = 0; i < HISTORY_TIERS; i++) {
+        uint32_t span = tiers[i].res * tiers[i].cap;
+        uint32_t buckets = (to - from + tiers[i].res - 1) / tiers[i].res;
+        if (tiers[i].res >= res && (now < span || from >= now - span) && buckets <= max) {
+            tier = &tiers[i];
+            break;
+        }
+    }
+
+    uint32_t first = from / tier->res;
+    uint32_t last = (to - 1) / tier->res;
+    if (last - first + 1 > max) {
+        first = last - max + 1;
+    }
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    for (uint32_t b = first; b <= last; b++) {
+        present[b - first] = am7_hist_tier_get(tier, b, field, &out[b - first]);
+    }
+    xSemaphoreGive(history_mutex);
+
+    range->from = first * tier->res;
+    range->res = tier->res;
+    range->count = last - first + 1;
+    return true;
+}
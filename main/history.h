@@ -0,0 +1,32 @@
+#pragma once
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "am7_history.h"
+
+// Sensor history: 1 s buckets for the last hour, 1 min for a day and 15 min
+// for a month (about 1 MB of PSRAM). Without PSRAM: 2 min, 3 h and 1 day,
+// 396 buckets of 82 bytes, about 32 KB of internal RAM; each /api/history
+// request takes another 25 KB while it runs. Closed 15 min buckets are
+// persisted to the "history" flash partition by a low-priority task and
+// restored at boot. Its sector erases (one per ~47 buckets, about every
+// 12 h) still pause code running from flash on both cores for tens of ms,
+// but no longer hold up am7_task's USB reads for their whole length.
+
+typedef struct {
+    uint32_t from;    // start of the first bucket, seconds
+    uint32_t res;     // bucket width of the tier that answered
+    uint32_t count;   // buckets returned
+} history_range_t;
+
+esp_err_t history_init(void);
+void history_add(const am7_data_t *data);   // single writer (am7_task)
+
+// Seconds on the history clock: Unix time once SNTP has set it, uptime before
+uint32_t history_now(void);
+
+// Buckets of field in [from, to) from the finest tier of at least res seconds
+// that still covers from. At most max buckets are returned (the most recent
+// ones); present[i] is false for buckets without samples.
+bool history_query(am7_field_t field, uint32_t from, uint32_t to, uint32_t res, uint32_t max,
+                   am7_hist_stat_t *out, bool *present, history_range_t *range);
@@ -0,0 +1,341 @@
+#include "logstore.h"
+#include "am7_record.h"
+#include "crashlog.h"
+#include "config.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "LOGSTORE";
+
+// RAM ring, left alone by the startup code on every reset except power-on
+// and brownout. The ring struct holds a pointer to its slots, which also
+// tells a ring written by a different firmware image apart.
+#define LOGSTORE_RAM_MAGIC 0x4D41524C  // "LRAM"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t boot;        // boot count that owns the ring
+    uint32_t flushed;     // seq of the newest line already in the journal
+    am7_logring_t ring;
+    am7_logring_slot_t slots[CONFIG_MAX_LOG_LINES];
+} logstore_ram_t;
+
+static __NOINIT_ATTR logstore_ram_t ram;
+static bool capturing = false;
+
+// Flash journal: a ring of sectors with sequence-numbered headers (same
+// scheme as the offline MQTT queue) holding variable-length records. Records
+// are collected in a page buffer and written once it fills or on the flush
+// period, so flash sees one write per page and no padding.
+#define LOGSTORE_SECTOR_SIZE 4096
+#define LOGSTORE_MAGIC 0x31474F4C  // "LOG1"
+#define LOGSTORE_LEN_ERASED 0xFFFF
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t reserved[2];
+} logstore_sector_hdr_t;
+
+typedef struct {
+    uint16_t len;         // text bytes, LOGSTORE_LEN_ERASED = free space
+    uint16_t crc;         // over the text
+    uint16_t boot;
+    uint8_t level;
+    uint8_t reserved;
+    uint32_t uptime_ms;
+} logstore_rec_hdr_t;     // followed by the text, padded to 4 bytes
+
+#define LOGSTORE_REC_SIZE(len) ((sizeof(logstore_rec_hdr_t) + (len) + 3) & ~3u)
+
+static const esp_partition_t *part = NULL;
+static SemaphoreHandle_t journal_mutex = NULL;
+static TaskHandle_t flush_task = NULL;
+static uint32_t sector_count = 0;
+static uint32_t head_sector = 0;
+static uint32_t head_seq = 0;
+static uint32_t head_offset = 0;     // next free byte in the head sector
+static uint8_t page[CONFIG_LOGSTORE_PAGE_SIZE];
+static size_t page_len = 0;
+static uint32_t page_last = 0;       // ring seq of the newest line in page
+
+static int custom_log_vprintf(const char *fmt, va_list args)
+{
+    // args is consumed by vprintf, the ring formats from a copy
+    va_list copy;
+    va_copy(copy, args);
+    int ret = vprintf(fmt, args);
+    am7_logring_vwrite(&ram.ring, (uint32_t)(esp_timer_get_time() / 1000), fmt, copy);
+    va_end(copy);
+
+    // Wake the flush task early before the ring laps unflushed lines
+    if (flush_task && am7_logring_head(&ram.ring) - ram.flushed == CONFIG_MAX_LOG_LINES / 2) {
+        xTaskNotifyGive(flush_task);
+    }
+    return ret;
+}
+
+static int level_rank(char level)
+{
+    switch (level) {
+        case 'E': return ESP_LOG_ERROR;
+        case 'W': return ESP_LOG_WARN;
+        case 'I': return ESP_LOG_INFO;
+        case 'D': return ESP_LOG_DEBUG;
+        default:  return ESP_LOG_VERBOSE;
+    }
+}
+
+static bool read_header(uint32_t sector, logstore_sector_hdr_t *hdr)
+{
+    return esp_partition_read(part, sector * LOGSTORE_SECTOR_SIZE, hdr, sizeof(*hdr)) == ESP_OK &&
+           hdr->magic == LOGSTORE_MAGIC;
+}
+
+static esp_err_t start_sector(uint32_t sector, uint32_t seq)
+{
+    esp_err_t ret = esp_partition_erase_range(part, sector * LOGSTORE_SECTOR_SIZE, LOGSTORE_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    logstore_sector_hdr_t hdr = {.magic = LOGSTORE_MAGIC, .seq = seq};
+    return esp_partition_write(part, sector * LOGSTORE_SECTOR_SIZE, &hdr, sizeof(hdr));
+}
+
+// Next record at *offset of sector; false at free space or a torn record
+static bool read_record(uint32_t sector, uint32_t *offset, logstore_rec_hdr_t *hdr, char *text)
+{
+    size_t base = sector * LOGSTORE_SECTOR_SIZE;
+    if (*offset + sizeof(*hdr) > LOGSTORE_SECTOR_SIZE ||
+        esp_partition_read(part, base + *offset, hdr, sizeof(*hdr)) != ESP_OK ||
+        hdr->len == LOGSTORE_LEN_ERASED || hdr->len > AM7_LOGRING_TEXT_LEN ||
+        *offset + LOGSTORE_REC_SIZE(hdr->len) > LOGSTORE_SECTOR_SIZE ||
+        esp_partition_read(part, base + *offset + sizeof(*hdr), text, hdr->len) != ESP_OK ||
+        hdr->crc != am7_crc16(text, hdr->len)) {
+        return false;
+    }
+    *offset += LOGSTORE_REC_SIZE(hdr->len);
+    return true;
+}
+
+static void journal_open(void)
+{
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                    CONFIG_LOGSTORE_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "No '%s' partition, logs are not persisted", CONFIG_LOGSTORE_PARTITION_LABEL);
+        return;
+    }
+    sector_count = part->size / LOGSTORE_SECTOR_SIZE;
+
+    bool found = false;
+    logstore_sector_hdr_t hdr;
+    for (uint32_t s = 0; s < sector_count; s++) {
+        if (read_header(s, &hdr) && (!found || (int32_t)(hdr.seq - head_seq) > 0)) {
+            head_sector = s;
+            head_seq = hdr.seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        head_sector = 0;
+        head_seq = 1;
+        head_offset = sizeof(logstore_sector_hdr_t);
+        start_sector(0, head_seq);
+        return;
+    }
+
+    // Append after the last intact record; a torn one closes the sector
+    logstore_rec_hdr_t rec;
+    char text[AM7_LOGRING_TEXT_LEN];
+    head_offset = sizeof(logstore_sector_hdr_t);
+    while (read_record(head_sector, &head_offset, &rec, text)) {
+    }
+    if (head_offset + sizeof(rec.len) > LOGSTORE_SECTOR_SIZE ||
+        esp_partition_read(part, head_sector * LOGSTORE_SECTOR_SIZE + head_offset, &rec.len, sizeof(rec.len)) != ESP_OK ||
+        rec.len != LOGSTORE_LEN_ERASED) {
+        head_offset = LOGSTORE_SECTOR_SIZE;
+    }
+}
+
+static void page_write(void)
+{
+    if (page_len == 0) {
+        return;
+    }
+    esp_err_t ret = esp_partition_write(part, head_sector * LOGSTORE_SECTOR_SIZE + head_offset, page, page_len);
+    if (ret != ESP_OK) {
+        // Not logged: this runs with lines pending and would only add more
+        head_offset = LOGSTORE_SECTOR_SIZE;
+    } else {
+        head_offset += page_len;
+    }
+    page_len = 0;
+    ram.flushed = page_last;
+}
+
+static void journal_add(uint32_t boot, const am7_logring_slot_t *slot, uint32_t seq)
+{
+    size_t len;
+    const char *msg = am7_logring_message(slot->text, &len);
+    size_t size = LOGSTORE_REC_SIZE(len);
+
+    if (page_len + size > sizeof(page) || head_offset + page_len + size > LOGSTORE_SECTOR_SIZE) {
+        page_write();
+    }
+    if (head_offset + size > LOGSTORE_SECTOR_SIZE) {
+        uint32_t next = (head_sector + 1) % sector_count;
+        if (start_sector(next, head_seq + 1) != ESP_OK) {
+            return;
+        }
+        head_sector = next;
+        head_seq++;
+        head_offset = sizeof(logstore_sector_hdr_t);
+    }
+
+    logstore_rec_hdr_t hdr = {
+        .len = (uint16_t)len,
+        .crc = am7_crc16(msg, len),
+        .boot = (uint16_t)boot,
+        .level = (uint8_t)slot->text[0],
+        .reserved = 0xFF,
+        .uptime_ms = slot->uptime_ms,
+    };
+    memcpy(&page[page_len], &hdr, sizeof(hdr));
+    memcpy(&page[page_len + sizeof(hdr)], msg, len);
+    memset(&page[page_len + sizeof(hdr) + len], 0xFF, size - sizeof(hdr) - len);
+    page_len += size;
+    page_last = seq;
+}
+
+// Move ring lines after ram.flushed into the journal; caller holds journal_mutex.
+// A line still being written ends a live flush; after a reset its writer is
+// gone for good, so recovery skips it.
+static void journal_flush(uint32_t boot, bool recovery)
+{
+    am7_logring_slot_t slot;
+    uint32_t head = am7_logring_head(&ram.ring);
+
+    for (uint32_t seq = ram.flushed + 1; seq <= head; seq++) {
+        uint32_t at = seq;
+        if (!am7_logring_read(&ram.ring, &at, &slot) || at > head) {
+            if (recovery) {
+                continue;
+            }
+            break;
+        }
+        seq = at;
+        if (level_rank(slot.text[0]) <= CONFIG_LOGSTORE_LEVEL) {
+            journal_add(boot, &slot, seq);
+        } else if (page_len == 0) {
+            ram.flushed = seq;
+        } else {
+            page_last = seq;
+        }
+    }
+    page_write();
+}
+
+static void logstore_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_LOGSTORE_FLUSH_MS));
+        xSemaphoreTake(journal_mutex, portMAX_DELAY);
+        journal_flush(ram.boot, false);
+        xSemaphoreGive(journal_mutex);
+    }
+}
+
+esp_err_t logstore_init(void)
+{
+    journal_mutex = xSemaphoreCreateMutex();
+    if (!journal_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+    journal_open();
+
+    // Lines the previous boot logged but did not get to flush
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool retained = reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT && reason != ESP_RST_UNKNOWN;
+    if (retained && ram.magic == LOGSTORE_RAM_MAGIC && ram.ring.slots == ram.slots &&
+        ram.ring.cap == CONFIG_MAX_LOG_LINES) {
+        uint32_t pending = am7_logring_head(&ram.ring) - ram.flushed;
+        if (part && pending > 0) {
+            journal_flush(ram.boot, true);
+        }
+        ESP_LOGI(TAG, "Previous boot left %lu unflushed lines", (unsigned long)pending);
+    }
+
+    ram.magic = LOGSTORE_RAM_MAGIC;
+    ram.boot = crashlog_get_boot_count();
+    ram.flushed = 0;
+    am7_logring_init(&ram.ring, ram.slots, CONFIG_MAX_LOG_LINES);
+    esp_log_set_vprintf(custom_log_vprintf);
+    capturing = true;
+
+    if (part) {
+        xTaskCreate(logstore_task, "logstore", 3072, NULL, 2, &flush_task);
+    }
+    ESP_LOGI(TAG, "Log capture enabled");
+    return ESP_OK;
+}
+
+bool logstore_read(uint32_t *seq, am7_logring_slot_t *out)
+{
+    return capturing && am7_logring_read(&ram.ring, seq, out);
+}
+
+uint32_t logstore_head(void)
+{
+    return capturing ? am7_logring_head(&ram.ring) : 0;
+}
+
+void logstore_journal_each(logstore_visit_fn fn, void *ctx)
+{
+    if (!part) {
+        return;
+    }
+    char text[AM7_LOGRING_TEXT_LEN];
+    logstore_rec_hdr_t hdr;
+    logstore_sector_hdr_t sector_hdr;
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    journal_flush(ram.boot, false);
+
+    // Oldest sector: walk back while the sequence numbers stay contiguous
+    uint32_t oldest = head_sector;
+    for (uint32_t back = 1; back < sector_count; back++) {
+        uint32_t s = (head_sector + sector_count - back) % sector_count;
+        if (!read_header(s, &sector_hdr) || sector_hdr.seq != head_seq - back) {
+            break;
+        }
+        oldest = s;
+    }
+
+    bool more = true;
+    for (uint32_t s = oldest; more; s = (s + 1) % sector_count) {
+        uint32_t offset = sizeof(logstore_sector_hdr_t);
+        while (more && read_record(s, &offset, &hdr, text)) {
+            logstore_record_t rec = {
+                .boot = hdr.boot,
+                .uptime_ms = hdr.uptime_ms,
+                .level = (char)hdr.level,
+                .len = hdr.len,
+                .text = text,
+            };
+            more = fn(&rec, ctx);
+        }
+        if (s == head_sector) {
+            break;
+        }
+    }
+    xSemaphoreGive(journal_mutex);
+}
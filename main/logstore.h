@@ -0,0 +1,31 @@
+#pragma once
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "am7_logring.h"
+
+// Log capture and persistence. Every ESP_LOG line goes into a lock-free RAM
+// ring kept in .noinit memory, so it survives panics, watchdog and software
+// resets. A background task copies lines at or above CONFIG_LOGSTORE_LEVEL
+// into a flash journal in the "logs" partition in page-sized writes; at boot,
+// lines the previous boot did not flush are recovered from the ring.
+
+typedef struct {
+    uint16_t boot;        // boot count that logged the line (low 16 bits)
+    uint32_t uptime_ms;
+    char level;           // E/W/I/D/V
+    uint16_t len;
+    const char *text;     // "TAG: message", not terminated
+} logstore_record_t;
+
+// Return false to stop the walk
+typedef bool (*logstore_visit_fn)(const logstore_record_t *rec, void *ctx);
+
+esp_err_t logstore_init(void);   // after crashlog_init; installs the log hook
+
+// Live ring, see am7_logring_read
+bool logstore_read(uint32_t *seq, am7_logring_slot_t *out);
+uint32_t logstore_head(void);
+
+// Journal records, oldest first, after flushing pending lines
+void logstore_journal_each(logstore_visit_fn fn, void *ctx);
@@ -5,8 +5,14 @@
 #include "mqtt.h"
 #include "settings.h"
 #include "webserver.h"
+#include "ota_pull.h"
 #include "wifi_manager.h"
 #include "crashlog.h"
+#include "logstore.h"
+#include "sfq.h"
+#include "history.h"
+#include "config.h"
+#include "esp_netif_sntp.h"
 
 static const char *TAG = "MAIN";
 
@@ -20,6 +26,15 @@ void app_main(void)
     // Record crash reset reason to flash if applicable
     crashlog_init();
 
+    // Log capture; saves what the previous boot logged before it went down
+    logstore_init();
+
+    // Offline MQTT buffer; timestamps in it rely on SNTP below
+    sfq_init();
+
+    // Sensor history tiers, restored from flash
+    history_init();
+
     // Initialize WiFi
     wifi_init();
     
@@ -28,6 +43,9 @@ void app_main(void)
     if (ssid && strlen(ssid) > 0) {
         ESP_LOGI(TAG, "WiFi credentials found, connecting to network...");
         wifi_connect(ssid, settings_get_wifi_password());
+
+        esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_SNTP_SERVER);
+        esp_netif_sntp_init(&sntp_config);
     } else {
         ESP_LOGW(TAG, "No WiFi credentials configured.");
         ESP_LOGI(TAG, "Starting Access Point mode for setup...");
@@ -43,5 +61,8 @@ void app_main(void)
     // Start web server
     web_server_start();
 
+    // Scheduled checks for a newer firmware (off until an update URL is set)
+    ota_pull_start();
+
     ESP_LOGI(TAG, "System initialized successfully");
 }
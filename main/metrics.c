@@ -0,0 +1,98 @@
+#include "metrics.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Upper bounds in microseconds: 0.5 ms .. 1 s, roughly 1-2-5 steps
+const uint32_t metrics_bucket_us[METRICS_BUCKETS - 1] = {
+    500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000,
+};
+
+void metrics_observe(metrics_hist_t *hist, uint32_t us)
+{
+    int b = 0;
+    while (b < METRICS_BUCKETS - 1 && us > metrics_bucket_us[b]) {
+        b++;
+    }
+    portENTER_CRITICAL(&hist->lock);
+    hist->counts[b]++;
+    hist->count++;
+    hist->sum_us += us;
+    portEXIT_CRITICAL(&hist->lock);
+}
+
+void metrics_hist_copy(metrics_hist_t *hist, metrics_hist_t *out)
+{
+    portENTER_CRITICAL(&hist->lock);
+    memcpy(out->counts, hist->counts, sizeof(out->counts));
+    out->count = hist->count;
+    out->sum_us = hist->sum_us;
+    portEXIT_CRITICAL(&hist->lock);
+}
+
+// Run time counters from the previous call, by task number. Each call
+// builds a fresh array and swaps it in, taking the old one to match against
+// outside the lock.
+
+typedef struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} task_sample_t;
+
+static task_sample_t *prev_tasks = NULL;
+static size_t prev_count = 0;
+static uint32_t prev_total = 0;
+static portMUX_TYPE prev_lock = portMUX_INITIALIZER_UNLOCKED;
+
+size_t metrics_tasks(metrics_task_t *out, size_t max)
+{
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *status = malloc(capacity * sizeof(TaskStatus_t));
+    task_sample_t *next = malloc(capacity * sizeof(task_sample_t));
+    if (!status || !next) {
+        free(status);
+        free(next);
+        return 0;
+    }
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status, capacity, &total);
+    if (n > max) {
+        n = max;
+    }
+    for (UBaseType_t i = 0; i < n; i++) {
+        next[i] = (task_sample_t){status[i].xTaskNumber, status[i].ulRunTimeCounter};
+    }
+
+    portENTER_CRITICAL(&prev_lock);
+    task_sample_t *before = prev_tasks;
+    size_t before_count = prev_count;
+    uint32_t before_total = prev_total;
+    prev_tasks = next;
+    prev_count = n;
+    prev_total = total;
+    portEXIT_CRITICAL(&prev_lock);
+
+    // Counters are per core and wrap; unsigned deltas stay right between
+    // calls less than one wrap apart. ulRunTimeCounter becomes the delta.
+    uint32_t elapsed = ((uint32_t)total - before_total) * portNUM_PROCESSORS;
+    for (UBaseType_t i = 0; i < n; i++) {
+        uint32_t then = 0;
+        for (size_t j = 0; j < before_count; j++) {
+            if (before[j].number == status[i].xTaskNumber) {
+                then = before[j].runtime;
+                break;
+            }
+        }
+        status[i].ulRunTimeCounter -= then;
+    }
+    free(before);
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        metrics_task_t *t = &out[i];
+        strlcpy(t->name, status[i].pcTaskName, sizeof(t->name));
+        t->stack_free = status[i].usStackHighWaterMark;
+        t->cpu = elapsed ? 100.0f * status[i].ulRunTimeCounter / elapsed : 0;
+    }
+    free(status);
+    return n;
+}
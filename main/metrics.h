@@ -0,0 +1,34 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Latency histogram with fixed bucket bounds (metrics_bucket_us), shared by
+// all producers. Updates take a spinlock for a few instructions, so it is
+// safe from any task and cheap enough for every request or publish.
+#define METRICS_BUCKETS 12   // last bucket is +Inf
+
+typedef struct {
+    portMUX_TYPE lock;
+    uint32_t counts[METRICS_BUCKETS];   // per bucket, not cumulative
+    uint32_t count;
+    uint64_t sum_us;
+} metrics_hist_t;
+
+#define METRICS_HIST_INIT {.lock = portMUX_INITIALIZER_UNLOCKED}
+
+extern const uint32_t metrics_bucket_us[METRICS_BUCKETS - 1];
+
+void metrics_observe(metrics_hist_t *hist, uint32_t us);
+void metrics_hist_copy(metrics_hist_t *hist, metrics_hist_t *out);
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_free;      // high-water mark, bytes never used
+    float cpu;                // % of all cores since the previous call
+} metrics_task_t;
+
+// Per-task CPU share since the previous call (since boot on the first);
+// returns the number of tasks written to out
+size_t metrics_tasks(metrics_task_t *out, size_t max);
@@ -1,13 +1,17 @@
 #include "mqtt.h"
 #include "settings.h"
 #include "am7.h"
+#include "am7_payload.h"
+#include "sfq.h"
+#include "config.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "mqtt_client.h"
-#include "cJSON.h"
+#include "am7_json.h"
 #include "esp_timer.h"
+#include "perf.h"
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
@@ -15,9 +19,52 @@
 static const char *TAG = "MQTT";
 
 bool mqtt_connected = false;
+static mqtt_stats_t stats = {.latency = METRICS_HIST_INIT};
 static esp_mqtt_client_handle_t client = NULL;
-static bool ha_discovery_sent = false;
+static volatile bool ha_discovery_sent = false;
 static uint64_t last_mqtt_publish_time = 0;
+static volatile bool resync_needed = true;  // Send a full keyframe after (re)connect
+static const am7_deadband_t exact_bands[AM7_FIELD_COUNT];  // Zero bands: report any change
+
+PERF_HIST(perf_frame_to_publish, "frame_to_publish");
+PERF_HIST(perf_publish_to_ack, "publish_to_ack");
+
+#if CONFIG_PERF_ENABLED
+// QoS 1 publishes awaiting PUBACK, by message id
+#define PERF_INFLIGHT 8
+static struct {
+    int msg_id;
+    uint32_t sent_us;
+} inflight[PERF_INFLIGHT];
+static int inflight_next = 0;
+static portMUX_TYPE inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void inflight_add(int msg_id)
+{
+    portENTER_CRITICAL(&inflight_lock);
+    inflight[inflight_next].msg_id = msg_id;
+    inflight[inflight_next].sent_us = (uint32_t)esp_timer_get_time();
+    inflight_next = (inflight_next + 1) % PERF_INFLIGHT;
+    portEXIT_CRITICAL(&inflight_lock);
+}
+
+static void inflight_acked(int msg_id)
+{
+    uint32_t sent_us = 0;
+    portENTER_CRITICAL(&inflight_lock);
+    for (int i = 0; i < PERF_INFLIGHT; i++) {
+        if (inflight[i].msg_id == msg_id && msg_id > 0) {
+            sent_us = inflight[i].sent_us;
+            inflight[i].msg_id = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&inflight_lock);
+    if (sent_us != 0) {
+        PERF_RECORD_US(perf_publish_to_ack, (uint32_t)esp_timer_get_time() - sent_us);
+    }
+}
+#endif
 
 // MQTT event handler
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
@@ -28,13 +75,20 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
             mqtt_connected = true;
+            stats.connects++;
             ha_discovery_sent = false; // Reset flag on reconnect
+            resync_needed = true;
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
             mqtt_connected = false;
             ha_discovery_sent = false;
             break;
+#if CONFIG_PERF_ENABLED
+        case MQTT_EVENT_PUBLISHED:
+            inflight_acked(event->msg_id);
+            break;
+#endif
         case MQTT_EVENT_ERROR:
             ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
             mqtt_connected = false;
@@ -85,10 +139,35 @@ bool connect_to_mqtt(const char *broker, int port, const char *user, const char
 }
 
 bool mqtt_publish(const char *topic, const char *payload)
+{
+    return mqtt_publish_ex(topic, payload, 1, false);
+}
+
+bool mqtt_publish_ex(const char *topic, const char *payload, int qos, bool retain)
 {
     if(!client || !mqtt_connected) return false;
-    int msg_id = esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
-    return (msg_id >= 0);
+    int64_t start = esp_timer_get_time();
+    int msg_id = esp_mqtt_client_publish(client, topic, payload, 0, qos, retain ? 1 : 0);
+    metrics_observe(&stats.latency, (uint32_t)(esp_timer_get_time() - start));
+    if (msg_id < 0) {
+        stats.failed++;
+        return false;
+    }
+#if CONFIG_PERF_ENABLED
+    if (qos > 0) {
+        inflight_add(msg_id);
+    }
+#endif
+    stats.published++;
+    return true;
+}
+
+void mqtt_get_stats(mqtt_stats_t *out)
+{
+    out->published = stats.published;
+    out->failed = stats.failed;
+    out->connects = stats.connects;
+    metrics_hist_copy(&stats.latency, &out->latency);
 }
 
 // Publish Home Assistant MQTT Discovery messages
@@ -106,75 +185,111 @@ bool mqtt_publish_ha_discovery(void)
     const char *device_name = settings_get_device_name();
     const char *state_topic = settings_get_mqtt_topic();
 
-    // Array of sensors to create
+    bool deadband = settings_get_publish_mode() == PUBLISH_MODE_DEADBAND;
+    bool fields = settings_get_topic_layout() == TOPIC_LAYOUT_FIELDS;
+
+    // Array of sensors to create; value is a Jinja expression on the JSON payload,
+    // field_value the one for the bare <topic>/<key> payload (NULL = use as is)
     struct {
         const char *name;
         const char *sensor_type;
-        const char *value_template;
+        const char *key;
+        const char *value;
+        const char *field_value;
         const char *unit;
         const char *device_class;
         const char *state_class;
     } sensors[] = {
-        {"Temperature", "temperature", "{{ value_json.temp }}", "°C", "temperature", "measurement"},
-        {"Humidity", "humidity", "{{ value_json.humidity }}", "%", "humidity", "measurement"},
-        {"CO2", "co2", "{{ value_json.co2 }}", "ppm", "carbon_dioxide", "measurement"},
-        {"PM2.5", "pm25", "{{ value_json.pm25 }}", "µg/m³", "pm25", "measurement"},
-        {"PM10", "pm10", "{{ value_json.pm10 }}", "µg/m³", "pm10", "measurement"},
-        {"TVOC", "tvoc", "{{ value_json.tvoc }}", "mg/m³", "volatile_organic_compounds", "measurement"},
-        {"HCHO", "hcho", "{{ value_json.hcho }}", "mg/m³", "volatile_organic_compounds", "measurement"},
-        {"Battery Status", "battery_status", "{{ 'Charging' if value_json.battery_status == 1 else 'Battery' }}", "", NULL, NULL},
-        {"Battery Level", "battery_level", "{{ value_json.battery_level * 25 }}", "%", "battery", "measurement"},
+        {"Temperature", "temperature", "temp", "value_json.temp", NULL, "°C", "temperature", "measurement"},
+        {"Humidity", "humidity", "humidity", "value_json.humidity", NULL, "%", "humidity", "measurement"},
+        {"CO2", "co2", "co2", "value_json.co2", NULL, "ppm", "carbon_dioxide", "measurement"},
+        {"PM2.5", "pm25", "pm25", "value_json.pm25", NULL, "µg/m³", "pm25", "measurement"},
+        {"PM10", "pm10", "pm10", "value_json.pm10", NULL, "µg/m³", "pm10", "measurement"},
+        {"TVOC", "tvoc", "tvoc", "value_json.tvoc", NULL, "mg/m³", "volatile_organic_compounds", "measurement"},
+        {"HCHO", "hcho", "hcho", "value_json.hcho", NULL, "mg/m³", "volatile_organic_compounds", "measurement"},
+        {"Battery Status", "battery_status", "battery_status", "'Charging' if value_json.battery_status == 1 else 'Battery'", "'Charging' if value | int == 1 else 'Battery'", "", NULL, NULL},
+        {"Battery Level", "battery_level", "battery_level", "value_json.battery_level * 25", "value | int * 25", "%", "battery", "measurement"},
         // runtime_hours intentionally excluded from MQTT discovery/payload (always 0 on AM7)
-        {"Particles >0.3µm", "pc03", "{{ value_json.pc03 }}", "", NULL, "measurement"},
-        {"Particles >0.5µm", "pc05", "{{ value_json.pc05 }}", "", NULL, "measurement"},
-        {"Particles >1.0µm", "pc10", "{{ value_json.pc10 }}", "", NULL, "measurement"},
-        {"Particles >2.5µm", "pc25", "{{ value_json.pc25 }}", "", NULL, "measurement"},
-        {"Particles >5.0µm", "pc50", "{{ value_json.pc50 }}", "", NULL, "measurement"},
-        {"Particles >10µm", "pc100", "{{ value_json.pc100 }}", "", NULL, "measurement"},
-        {"Uptime", "uptime", "{{ value_json.uptime }}", "s", "duration", "total_increasing"},
-        {"Last Update", "last_update", "{{ value_json.last_update }}", "s", "duration", "measurement"},
+        {"Particles >0.3µm", "pc03", "pc03", "value_json.pc03", NULL, "", NULL, "measurement"},
+        {"Particles >0.5µm", "pc05", "pc05", "value_json.pc05", NULL, "", NULL, "measurement"},
+        {"Particles >1.0µm", "pc10", "pc10", "value_json.pc10", NULL, "", NULL, "measurement"},
+        {"Particles >2.5µm", "pc25", "pc25", "value_json.pc25", NULL, "", NULL, "measurement"},
+        {"Particles >5.0µm", "pc50", "pc50", "value_json.pc50", NULL, "", NULL, "measurement"},
+        {"Particles >10µm", "pc100", "pc100", "value_json.pc100", NULL, "", NULL, "measurement"},
+        {"Uptime", "uptime", "uptime", "value_json.uptime", NULL, "s", "duration", "total_increasing"},
+        {"Last Update", "last_update", "last_update", "value_json.last_update", NULL, "s", "duration", "measurement"},
     };
 
-    for (int i = 0; i < 18; i++) {
+    // Only ever called from mqtt_task, so one static buffer serves every message
+    static char config_buf[CONFIG_MQTT_DISCOVERY_BUF_SIZE];
+    am7_json_t config;
+
+    for (size_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++) {
         char config_topic[128];
         snprintf(config_topic, sizeof(config_topic), 
                  "homeassistant/sensor/%s_%s/config", device_id, sensors[i].sensor_type);
 
-        cJSON *config = cJSON_CreateObject();
-        cJSON_AddStringToObject(config, "name", sensors[i].name);
+        am7_json_init(&config, config_buf, sizeof(config_buf) - 1, NULL, NULL);
+        am7_json_object_begin(&config, NULL);
+        am7_json_string(&config, "name", sensors[i].name);
         
         char unique_id[64];
         snprintf(unique_id, sizeof(unique_id), "%s_%s", device_id, sensors[i].sensor_type);
-        cJSON_AddStringToObject(config, "unique_id", unique_id);
+        am7_json_string(&config, "unique_id", unique_id);
         
         char default_entity_id[96];
         snprintf(default_entity_id, sizeof(default_entity_id), "sensor.%s_%s", device_id, sensors[i].sensor_type);
-        cJSON_AddStringToObject(config, "default_entity_id", default_entity_id);
+        am7_json_string(&config, "default_entity_id", default_entity_id);
         
-        cJSON_AddStringToObject(config, "state_topic", state_topic);
-        cJSON_AddStringToObject(config, "value_template", sensors[i].value_template);
-        cJSON_AddStringToObject(config, "unit_of_measurement", sensors[i].unit);
+        char field_topic[128];
+        if (fields) {
+            snprintf(field_topic, sizeof(field_topic), "%s/%s", state_topic, sensors[i].key);
+            am7_json_string(&config, "state_topic", field_topic);
+        } else {
+            am7_json_string(&config, "state_topic", state_topic);
+        }
+
+        // Deadband payloads only carry changed fields: keep the current state for absent keys
+        char value_template[160];
+        if (fields) {
+            if (sensors[i].field_value) {
+                snprintf(value_template, sizeof(value_template), "{{ %s }}", sensors[i].field_value);
+            } else {
+                value_template[0] = '\0';  // Bare value needs no template
+            }
+        } else if (deadband) {
+            snprintf(value_template, sizeof(value_template), "{{ (%s) if value_json.%s is defined else this.state }}",
+                     sensors[i].value, sensors[i].key);
+        } else {
+            snprintf(value_template, sizeof(value_template), "{{ %s }}", sensors[i].value);
+        }
+        if (value_template[0]) {
+            am7_json_string(&config, "value_template", value_template);
+        }
+        am7_json_string(&config, "unit_of_measurement", sensors[i].unit);
         if (sensors[i].device_class) {
-            cJSON_AddStringToObject(config, "device_class", sensors[i].device_class);
+            am7_json_string(&config, "device_class", sensors[i].device_class);
         }
         if (sensors[i].state_class) {
-            cJSON_AddStringToObject(config, "state_class", sensors[i].state_class);
+            am7_json_string(&config, "state_class", sensors[i].state_class);
         }
 
         // Device information
-        cJSON *device = cJSON_CreateObject();
-        cJSON_AddStringToObject(device, "identifiers", device_id);
-        cJSON_AddStringToObject(device, "name", device_name);
-        cJSON_AddStringToObject(device, "model", "AM7 Gateway");
-        cJSON_AddStringToObject(device, "manufacturer", "Custom");
-        cJSON_AddStringToObject(device, "sw_version", "1.0.0");
-        cJSON_AddItemToObject(config, "device", device);
-
-        char *config_str = cJSON_PrintUnformatted(config);
-        bool success = mqtt_publish(config_topic, config_str);
-        
-        cJSON_free(config_str);
-        cJSON_Delete(config);
+        am7_json_object_begin(&config, "device");
+        am7_json_string(&config, "identifiers", device_id);
+        am7_json_string(&config, "name", device_name);
+        am7_json_string(&config, "model", "AM7 Gateway");
+        am7_json_string(&config, "manufacturer", "Custom");
+        am7_json_string(&config, "sw_version", "1.0.0");
+        am7_json_object_end(&config);
+        am7_json_object_end(&config);
+
+        if (!am7_json_finish(&config)) {
+            ESP_LOGE(TAG, "Discovery config for %s too long", sensors[i].name);
+            return false;
+        }
+        config_buf[config.len] = '\0';
+        bool success = mqtt_publish(config_topic, config_buf);
 
         if (!success) {
             ESP_LOGE(TAG, "Failed to publish discovery for %s", sensors[i].name);
@@ -188,10 +303,167 @@ bool mqtt_publish_ha_discovery(void)
     return true;
 }
 
+// Field layout: each field in mask as a retained bare value on <topic>/<field>.
+// uptime and last_update are only sent with full keyframes.
+static bool mqtt_publish_fields(const am7_sample_t *sample, uint32_t mask,
+                                uint64_t uptime_sec, int last_update_sec)
+{
+    const char *topic = settings_get_mqtt_topic();
+    char field_topic[128];
+    char value[24];
+
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        snprintf(field_topic, sizeof(field_topic), "%s/%s", topic, am7_field_info[i].name);
+        am7_field_format(value, sizeof(value), &sample->data, (am7_field_t)i);
+        if (!mqtt_publish_ex(field_topic, value, 1, true)) {
+            return false;
+        }
+    }
+
+    if (mask == AM7_FIELD_MASK_ALL) {
+        snprintf(field_topic, sizeof(field_topic), "%s/uptime", topic);
+        snprintf(value, sizeof(value), "%llu", (unsigned long long)uptime_sec);
+        mqtt_publish_ex(field_topic, value, 0, false);
+        snprintf(field_topic, sizeof(field_topic), "%s/last_update", topic);
+        snprintf(value, sizeof(value), "%d", last_update_sec);
+        mqtt_publish_ex(field_topic, value, 0, false);
+    }
+    return true;
+}
+
+void mqtt_request_discovery(void)
+{
+    ha_discovery_sent = false;
+    resync_needed = true;   // The new templates expect a full state first
+}
+
+// Publish one sample as the JSON state payload: all fields, or only those in
+// mask (deadband mode). uptime and last_update are always included.
+static bool mqtt_publish_sample(const am7_sample_t *sample, uint32_t mask)
+{
+    // Send Home Assistant discovery on first connection
+    if (!ha_discovery_sent && settings_get_ha_discovery_enabled()) {
+        mqtt_publish_ha_discovery();
+        ha_discovery_sent = true;
+    }
+
+    // Get uptime in seconds
+    uint64_t uptime_sec = esp_timer_get_time() / 1000000;
+    
+    // Calculate seconds since last successful MQTT publish
+    int last_update_sec = 0;
+    if (last_mqtt_publish_time > 0) {
+        last_update_sec = (int)(uptime_sec - last_mqtt_publish_time);
+    }
+
+    if (settings_get_topic_layout() == TOPIC_LAYOUT_FIELDS) {
+        if (!mqtt_publish_fields(sample, mask, uptime_sec, last_update_sec)) {
+            ESP_LOGW(TAG, "MQTT publish failed");
+            return false;
+        }
+        last_mqtt_publish_time = uptime_sec;
+        ESP_LOGD(TAG, "Published fields 0x%05lx", (unsigned long)mask);
+        return true;
+    }
+
+    char payload[512];
+    if (mask == AM7_FIELD_MASK_ALL) {
+        am7_payload_mqtt_json(payload, sizeof(payload), &sample->data, uptime_sec, last_update_sec);
+    } else {
+        am7_payload_mqtt_fields_json(payload, sizeof(payload), &sample->data, mask, uptime_sec, last_update_sec);
+    }
+
+    if(!mqtt_publish(settings_get_mqtt_topic(), payload)) {
+        ESP_LOGW(TAG, "MQTT publish failed");
+        return false;
+    }
+    last_mqtt_publish_time = uptime_sec; // Update last successful publish time
+    ESP_LOGD(TAG, "Published: %s", payload);
+    return true;
+}
+
+// While the broker is unreachable, keep one sample per heartbeat interval
+// in the flash queue so the outage can be backfilled later
+static void mqtt_spool_sample(void)
+{
+    static uint32_t spooled_seq = 0;
+    static int64_t last_spool_us = 0;
+    am7_sample_t sample;
+    int64_t now_us = esp_timer_get_time();
+
+    if (!am7_connected || !am7_get_sample(&sample) || sample.seq == spooled_seq) {
+        return;
+    }
+    if (last_spool_us != 0 && now_us - last_spool_us < (int64_t)settings_get_interval() * 1000000) {
+        return;
+    }
+    if (sfq_push(&sample.data)) {
+        spooled_seq = sample.seq;
+        last_spool_us = now_us;
+    }
+}
+
+// Offline replacement for vTaskDelay: keeps spooling samples while waiting
+static void mqtt_offline_wait(int ms)
+{
+    int64_t until_us = esp_timer_get_time() + (int64_t)ms * 1000;
+    int64_t now_us;
+    while ((now_us = esp_timer_get_time()) < until_us && !mqtt_connected) {
+        mqtt_spool_sample();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((until_us - now_us) / 1000) + 1);
+    }
+}
+
+// Replay up to one batch of queued samples on <topic>/backfill, oldest first
+static void mqtt_drain_backlog(void)
+{
+    char topic[96];
+    char payload[384];
+    am7_data_t data;
+    uint32_t ts;
+
+    snprintf(topic, sizeof(topic), "%s/backfill", settings_get_mqtt_topic());
+    for (int i = 0; i < CONFIG_SFQ_DRAIN_BATCH && sfq_front(&data, &ts); i++) {
+        am7_payload_backfill_json(payload, sizeof(payload), &data, ts);
+        if (!mqtt_publish(topic, payload)) {
+            return;
+        }
+        sfq_pop();
+    }
+    if (sfq_pending() == 0) {
+        ESP_LOGI(TAG, "Offline backlog drained");
+    }
+}
+
+// Publishing is driven by new samples from am7_task: a fresh sample goes out
+// immediately unless the last publish is younger than min_interval, and the
+// current sample is republished as a keyframe after interval seconds of silence.
+// In deadband mode a fresh sample only publishes the fields that left their
+// deadband; the field topic layout only publishes fields whose value changed.
+// Either way the full keyframe is sent after each (re)connect (resync_needed)
+// and every keyframe_interval seconds, not every interval.
+// Samples taken while the broker is unreachable go to the offline queue and
+// are replayed on <topic>/backfill after reconnecting.
 void mqtt_task(void *arg)
 {
     int backoff = 1;
+    uint32_t published_seq = 0;
+    int64_t last_publish_us = 0;
+    int64_t last_keyframe_us = 0;
+    am7_rbe_t rbe;
+#if CONFIG_PERF_ENABLED
+    int64_t last_perf_us = esp_timer_get_time();
+#endif
     ESP_LOGI(TAG, "MQTT task started");
+
+    PERF_REGISTER(perf_frame_to_publish);
+    PERF_REGISTER(perf_publish_to_ack);
+
+    am7_rbe_reset(&rbe);
+    am7_add_listener(xTaskGetCurrentTaskHandle());
     
     // Wait for network connection
     vTaskDelay(pdMS_TO_TICKS(2000));
@@ -205,52 +477,95 @@ void mqtt_task(void *arg)
                                settings_get_mqtt_user(), settings_get_mqtt_pass())) {
                 backoff = 1;
                 // Wait a bit for connection to establish
-                vTaskDelay(pdMS_TO_TICKS(2000));
+                mqtt_offline_wait(2000);
             } else {
                 ESP_LOGW(TAG, "MQTT connect failed, retry in %d sec", backoff);
-                vTaskDelay(pdMS_TO_TICKS(backoff*1000));
+                mqtt_offline_wait(backoff*1000);
                 backoff = (backoff*2>60)?60:backoff*2;
                 continue;
             }
         }
 
-        if(mqtt_connected && am7_connected) {
-            // Send Home Assistant discovery on first connection
-            if (!ha_discovery_sent && settings_get_ha_discovery_enabled()) {
-                mqtt_publish_ha_discovery();
-                ha_discovery_sent = true;
-            }
+        bool deadband = settings_get_publish_mode() == PUBLISH_MODE_DEADBAND;
+        bool fields = settings_get_topic_layout() == TOPIC_LAYOUT_FIELDS;
+        bool partial = deadband || fields;
+        int64_t keyframe_us = (int64_t)(partial ? settings_get_keyframe_interval() : settings_get_interval()) * 1000000;
+        int64_t min_us = (int64_t)settings_get_min_interval() * 1000000;
+        int64_t wait_us = keyframe_us;
 
-            // Get uptime in seconds
-            uint64_t uptime_sec = esp_timer_get_time() / 1000000;
-            
-            // Calculate seconds since last successful MQTT publish
-            int last_update_sec = 0;
-            if (last_mqtt_publish_time > 0) {
-                last_update_sec = (int)(uptime_sec - last_mqtt_publish_time);
-            }
+        if (resync_needed) {
+            resync_needed = false;
+            last_keyframe_us = 0;
+            am7_rbe_reset(&rbe);
+        }
+
+        am7_sample_t sample;
+        if(mqtt_connected && am7_connected && am7_get_sample(&sample)) {
+            int64_t now_us = esp_timer_get_time();
+            bool fresh = (sample.seq != published_seq);
+            bool keyframe_due = (last_keyframe_us == 0 || now_us - last_keyframe_us >= keyframe_us);
+            bool throttled = (now_us - last_publish_us < min_us);
 
-            char payload[512];
-            snprintf(payload, sizeof(payload),
-                     "{\"temp\":%.1f,\"humidity\":%.1f,\"co2\":%d,\"pm25\":%d,\"pm10\":%d,\"tvoc\":%.2f,\"hcho\":%.3f,"
-                     "\"battery_status\":%d,\"battery_level\":%d,"
-                     "\"pc03\":%d,\"pc05\":%d,\"pc10\":%d,\"pc25\":%d,\"pc50\":%d,\"pc100\":%d,"
-                     "\"uptime\":%llu,\"last_update\":%d}",
-                     am7_data.temp, am7_data.humidity,
-                     am7_data.co2, am7_data.pm25, am7_data.pm10, am7_data.tvoc, am7_data.hcho,
-                     // runtime_hours intentionally omitted from MQTT payload (always 0 on AM7)
-                     am7_data.battery_status, am7_data.battery_level,
-                     am7_data.pc03, am7_data.pc05, am7_data.pc10, am7_data.pc25, am7_data.pc50, am7_data.pc100,
-                     (unsigned long long)uptime_sec, last_update_sec);
-
-            if(!mqtt_publish(settings_get_mqtt_topic(), payload)) {
-                ESP_LOGW(TAG, "MQTT publish failed");
+            if (keyframe_due || (fresh && !throttled)) {
+                uint32_t mask = AM7_FIELD_MASK_ALL;
+                if (partial && !keyframe_due) {
+                    mask = am7_rbe_changed(&rbe, &sample.data, deadband ? settings_get_deadbands() : exact_bands);
+                }
+                if (mask == 0 || mqtt_publish_sample(&sample, mask)) {
+                    if (fresh && mask != 0) {
+                        PERF_RECORD_US(perf_frame_to_publish, esp_timer_get_time() - sample.captured_us);
+                    }
+                    published_seq = sample.seq;
+                    if (mask != 0) {
+                        am7_rbe_commit(&rbe, &sample.data, mask);
+                        last_publish_us = now_us;
+                    }
+                    if (mask == AM7_FIELD_MASK_ALL) {
+                        last_keyframe_us = now_us;
+                    }
+                    wait_us = keyframe_us - (esp_timer_get_time() - last_keyframe_us);  // Sleep until keyframe
+                } else {
+                    wait_us = 1000000;  // Publish failed: retry shortly
+                }
+            } else if (fresh) {
+                wait_us = min_us - (now_us - last_publish_us);  // Throttled: send when min_interval expires
             } else {
-                last_mqtt_publish_time = uptime_sec; // Update last successful publish time
-                ESP_LOGD(TAG, "Published: %s", payload);
+                wait_us = keyframe_us - (now_us - last_keyframe_us);
+            }
+            if (wait_us < 0) {
+                wait_us = 0;
+            }
+        }
+
+        // Backlog from an outage drains in rate-limited batches alongside live data
+        if (mqtt_connected && sfq_pending() > 0) {
+            mqtt_drain_backlog();
+            if (sfq_pending() > 0 && wait_us > CONFIG_SFQ_DRAIN_PERIOD_MS * 1000LL) {
+                wait_us = CONFIG_SFQ_DRAIN_PERIOD_MS * 1000LL;
             }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(settings_get_interval()*1000));
+        if (!mqtt_connected) {
+            mqtt_spool_sample();
+        }
+
+#if CONFIG_PERF_ENABLED
+        // Latency summary for remote diagnostics
+        if (mqtt_connected && esp_timer_get_time() - last_perf_us >= CONFIG_PERF_MQTT_PERIOD_S * 1000000LL) {
+            char topic[96];
+            char payload[768];
+            snprintf(topic, sizeof(topic), "%s/diagnostics", settings_get_mqtt_topic());
+            perf_summary_json(payload, sizeof(payload));
+            mqtt_publish_ex(topic, payload, 0, false);
+            last_perf_us = esp_timer_get_time();
+        }
+        int64_t perf_due_us = CONFIG_PERF_MQTT_PERIOD_S * 1000000LL - (esp_timer_get_time() - last_perf_us);
+        if (mqtt_connected && wait_us > perf_due_us) {
+            wait_us = perf_due_us > 0 ? perf_due_us : 0;
+        }
+#endif
+
+        // Sleep until am7_task signals a new sample or the next deadline
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000) + 1);
     }
-}
\ No newline at end of file
+}
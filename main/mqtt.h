@@ -1,10 +1,25 @@
 #pragma once
 #include <stdbool.h>
 #include "am7.h"
+#include "metrics.h"
 
 extern bool mqtt_connected;
 
 void mqtt_task(void *arg);
 bool mqtt_publish(const char *topic, const char *payload);
+bool mqtt_publish_ex(const char *topic, const char *payload, int qos, bool retain);
 bool mqtt_publish_ha_discovery(void);
+// Re-send discovery (and a full keyframe) before the next sample, after a
+// setting it depends on has changed
+void mqtt_request_discovery(void);
 bool connect_to_mqtt(const char *broker, int port, const char *user, const char *pass);
+
+// Publish counters since boot; latency is the time to hand a message to the client
+typedef struct {
+    uint32_t published;
+    uint32_t failed;
+    uint32_t connects;
+    metrics_hist_t latency;
+} mqtt_stats_t;
+
+void mqtt_get_stats(mqtt_stats_t *out);
@@ -1,10 +1,20 @@
 #include "ota.h"
+#include "www.h"
+#include "am7_delta.h"
+#include "gunzip.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_app_format.h"
 #include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "config.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "mbedtls/sha256.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifndef MIN
@@ -18,7 +28,11 @@ static const esp_partition_t *update_partition = NULL;
 static ota_state_t ota_state = OTA_STATE_IDLE;
 static char error_message[128] = {0};
 static size_t bytes_written = 0;
-static size_t total_size = 0;
+static size_t bytes_received = 0;   // upload bytes consumed, compressed or not
+static size_t total_size = 0;       // upload size
+static bool spiffs_busy = false;
+// Uploads run on httpd worker tasks, so two can arrive at once
+static portMUX_TYPE ota_lock = portMUX_INITIALIZER_UNLOCKED;
 
 void ota_init(void)
 {
@@ -27,7 +41,13 @@ void ota_init(void)
 
 esp_err_t ota_begin(void)
 {
-    if (ota_state == OTA_STATE_IN_PROGRESS) {
+    portENTER_CRITICAL(&ota_lock);
+    bool busy = ota_state == OTA_STATE_IN_PROGRESS;
+    if (!busy) {
+        ota_state = OTA_STATE_IN_PROGRESS;   // claim it before the slow esp_ota_begin
+    }
+    portEXIT_CRITICAL(&ota_lock);
+    if (busy) {
         snprintf(error_message, sizeof(error_message), "OTA already in progress");
         return ESP_ERR_INVALID_STATE;
     }
@@ -41,8 +61,9 @@ esp_err_t ota_begin(void)
         return ESP_FAIL;
     }
 
-    // Begin OTA update
-    esp_err_t err = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &ota_handle);
+    // Begin OTA update. Sectors are erased as the writes reach them, on the
+    // pipeline's writer task, instead of the whole slot up front.
+    esp_err_t err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
     if (err != ESP_OK) {
         snprintf(error_message, sizeof(error_message), "OTA begin failed: %s", esp_err_to_name(err));
         ESP_LOGE(TAG, "%s", error_message);
@@ -51,8 +72,8 @@ esp_err_t ota_begin(void)
     }
 
     bytes_written = 0;
+    bytes_received = 0;
     total_size = 0;
-    ota_state = OTA_STATE_IN_PROGRESS;
     ESP_LOGI(TAG, "OTA update started");
     return ESP_OK;
 }
@@ -78,75 +99,492 @@ esp_err_t ota_write(const uint8_t *data, size_t len)
 
     bytes_written += len;
     
-    if (bytes_written % 102400 == 0) { // Log every 100KB
+    if (bytes_written / 102400 != (bytes_written - len) / 102400) { // Log every 100KB
         ESP_LOGI(TAG, "Written %zu bytes", bytes_written);
     }
 
     return ESP_OK;
 }
 
-// HTTP handler for SPIFFS OTA upload
-esp_err_t ota_spiffs_upload_handler(httpd_req_t *req)
+// Upload pipeline: the receiving task fills CONFIG_OTA_PIPE_BUFS buffers of
+// CONFIG_OTA_PIPE_BUF_SIZE in turn while a writer task programs (and erases)
+// flash from the previous ones, so the socket is not left idle during every
+// flash operation. Buffers circulate between the two queues; a NULL buffer
+// on pipe_full stops the writer.
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} pipe_chunk_t;
+
+typedef esp_err_t (*pipe_sink_fn)(const uint8_t *data, size_t len);
+
+static QueueHandle_t pipe_free = NULL;
+static QueueHandle_t pipe_full = NULL;
+static uint8_t *pipe_mem = NULL;
+static pipe_sink_fn pipe_sink = NULL;
+static TaskHandle_t pipe_owner = NULL;
+static volatile esp_err_t pipe_err = ESP_OK;
+
+static void pipe_writer_task(void *arg)
+{
+    pipe_chunk_t chunk;
+    for (;;) {
+        xQueueReceive(pipe_full, &chunk, portMAX_DELAY);
+        if (!chunk.data) {
+            break;
+        }
+        if (pipe_err == ESP_OK) {
+            esp_err_t err = pipe_sink(chunk.data, chunk.len);
+            if (err != ESP_OK) {
+                pipe_err = err;
+            }
+        }
+        xQueueSend(pipe_free, &chunk, portMAX_DELAY);
+    }
+    xTaskNotifyGive(pipe_owner);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t pipe_start(pipe_sink_fn sink)
+{
+    if (!pipe_free) {
+        pipe_free = xQueueCreate(CONFIG_OTA_PIPE_BUFS, sizeof(pipe_chunk_t));
+        pipe_full = xQueueCreate(CONFIG_OTA_PIPE_BUFS + 1, sizeof(pipe_chunk_t));
+        if (!pipe_free || !pipe_full) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // Internal RAM: flash cannot be programmed straight from PSRAM
+    pipe_mem = heap_caps_malloc(CONFIG_OTA_PIPE_BUFS * CONFIG_OTA_PIPE_BUF_SIZE,
+                                MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!pipe_mem) {
+        return ESP_ERR_NO_MEM;
+    }
+    xQueueReset(pipe_free);
+    xQueueReset(pipe_full);
+    for (int i = 0; i < CONFIG_OTA_PIPE_BUFS; i++) {
+        pipe_chunk_t chunk = {.data = pipe_mem + i * CONFIG_OTA_PIPE_BUF_SIZE};
+        xQueueSend(pipe_free, &chunk, 0);
+    }
+    pipe_sink = sink;
+    pipe_err = ESP_OK;
+    pipe_owner = xTaskGetCurrentTaskHandle();
+    if (xTaskCreate(pipe_writer_task, "ota_writer", CONFIG_OTA_PIPE_STACK, NULL, 5, NULL) != pdPASS) {
+        free(pipe_mem);
+        pipe_mem = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Next empty buffer (CONFIG_OTA_PIPE_BUF_SIZE bytes); waits for the writer
+static uint8_t *pipe_get(void)
+{
+    pipe_chunk_t chunk;
+    xQueueReceive(pipe_free, &chunk, portMAX_DELAY);
+    return chunk.data;
+}
+
+static void pipe_put(uint8_t *data, size_t len)
+{
+    pipe_chunk_t chunk = {.data = data, .len = len};
+    xQueueSend(pipe_full, &chunk, portMAX_DELAY);
+}
+
+// Waits for the writer to drain; the first sink error, if any
+static esp_err_t pipe_finish(void)
+{
+    pipe_chunk_t stop = {0};
+    xQueueSend(pipe_full, &stop, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    free(pipe_mem);
+    pipe_mem = NULL;
+    return pipe_err;
+}
+
+// Expected SHA-256 of a web UI image, from an X-Content-SHA256 header or a
+// sha256 query parameter (64 hex digits). 0 when absent, -1 when malformed.
+static int spiffs_expected_sha(httpd_req_t *req, uint8_t out[32])
+{
+    char hex[65] = {0};
+    if (httpd_req_get_hdr_value_str(req, "X-Content-SHA256", hex, sizeof(hex)) != ESP_OK) {
+        char query[96];
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+            httpd_query_key_value(query, "sha256", hex, sizeof(hex)) != ESP_OK) {
+            return 0;
+        }
+    }
+    if (strlen(hex) != 64) {
+        return -1;
+    }
+    for (int i = 0; i < 32; i++) {
+        unsigned int byte;
+        if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1]) ||
+            sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        out[i] = (uint8_t)byte;
+    }
+    return 1;
+}
+
+// Web UI image being written to the update slot: the first sector into head,
+// the rest as it arrives, each sector erased just before it is reached
+typedef struct {
+    const www_slot_t *slot;
+    uint8_t *head;
+    size_t offset;            // image bytes so far
+    size_t erased;
+    mbedtls_sha256_context sha;
+    bool opened;              // www_update_open done, flash may be written
+    const char *failure;
+    bool rejected;            // failure is the client's (400), not the device's
+} spiffs_writer_t;
+
+// Flash is only touched once the header and index look right, so a stray
+// upload does not stop an older SPIFFS image from being served
+static bool spiffs_open(spiffs_writer_t *w)
+{
+    if (w->opened) {
+        return true;
+    }
+    if (!www_head_valid(w->head, MIN(w->offset, WWW_SECTOR_SIZE), 0)) {
+        w->failure = "Not a web UI bundle";
+        w->rejected = true;
+        return false;
+    }
+    www_update_open();
+    w->opened = true;
+    return true;
+}
+
+static esp_err_t spiffs_put(void *ctx, const uint8_t *data, size_t len)
+{
+    spiffs_writer_t *w = ctx;
+    if (len > w->slot->size - w->offset) {
+        w->failure = "Image larger than a web UI slot";
+        w->rejected = true;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    mbedtls_sha256_update(&w->sha, data, len);
+
+    if (w->offset < WWW_SECTOR_SIZE) {
+        size_t k = MIN(len, WWW_SECTOR_SIZE - w->offset);
+        memcpy(w->head + w->offset, data, k);
+        w->offset += k;
+        data += k;
+        len -= k;
+    }
+    if (len > 0 && !spiffs_open(w)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (len > 0 && w->erased < w->offset + len) {
+        if (esp_partition_erase_range(w->slot->part, w->slot->offset + w->erased, WWW_SECTOR_SIZE) != ESP_OK) {
+            w->failure = "Failed to erase SPIFFS";
+            return ESP_FAIL;
+        }
+        w->erased += WWW_SECTOR_SIZE;
+    }
+    if (len > 0) {
+        if (esp_partition_write(w->slot->part, w->slot->offset + w->offset, data, len) != ESP_OK) {
+            w->failure = "Failed to write SPIFFS";
+            return ESP_FAIL;
+        }
+        w->offset += len;
+    }
+    return ESP_OK;
+}
+
+// Receive the image, gunzipping it on the way if it was sent compressed.
+// The hash covers the image itself. NULL on success, else what went wrong.
+static const char *spiffs_receive(httpd_req_t *req, spiffs_writer_t *w, uint8_t digest[32])
 {
-    esp_err_t err;
     char buf[1024];
-    int received;
-    
-    // Find SPIFFS partition
-    const esp_partition_t *spiffs_partition = esp_partition_find_first(
-        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
-    
-    if (!spiffs_partition) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "SPIFFS partition not found");
+    size_t total = req->content_len;
+    size_t received_total = 0;
+    gunzip_t *gz = NULL;
+
+    mbedtls_sha256_init(&w->sha);
+    mbedtls_sha256_starts(&w->sha, 0);
+    while (received_total < total && !w->failure) {
+        int received = httpd_req_recv(req, buf, MIN(total - received_total, sizeof(buf)));
+        if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (received <= 0) {
+            w->failure = "Failed to receive data";
+            break;
+        }
+        if (received_total == 0 && gunzip_is_gzip((const uint8_t *)buf, received)) {
+            gz = gunzip_new(spiffs_put, w);
+            if (!gz) {
+                w->failure = "Out of memory";
+                break;
+            }
+        }
+        received_total += received;
+
+        esp_err_t err = gz ? gunzip_feed(gz, (const uint8_t *)buf, received)
+                           : spiffs_put(w, (const uint8_t *)buf, received);
+        if (err != ESP_OK && !w->failure) {
+            w->failure = "Corrupt gzip data";
+        }
+    }
+    if (gz) {
+        if (!w->failure && gunzip_finish(gz) != ESP_OK) {
+            w->failure = "Compressed image truncated";
+        }
+        gunzip_free(gz);
+    }
+    mbedtls_sha256_finish(&w->sha, digest);
+    mbedtls_sha256_free(&w->sha);
+    return w->failure;
+}
+
+// Delta patches (am7_delta.h, made with host/tools/am7_delta.c) are uploaded
+// to /api/ota like full images and told apart by their magic. The writer task
+// applies them against the running image into the update slot; the result
+// must match the patch's SHA-256 before the slot is made bootable.
+typedef struct {
+    am7_delta_t dec;
+    const esp_partition_t *base;
+    mbedtls_sha256_context sha;   // of the image produced
+} ota_delta_t;
+
+static ota_delta_t *delta = NULL;
+static bool image_started = false;
+
+static bool delta_begin(void *ctx, const am7_delta_header_t *hdr)
+{
+    ota_delta_t *dl = ctx;
+    if (hdr->old_size > dl->base->size || hdr->new_size > update_partition->size) {
+        return false;
+    }
+
+    uint8_t buf[512];
+    uint8_t digest[32];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    bool ok = true;
+    for (uint32_t offset = 0; offset < hdr->old_size && ok; offset += sizeof(buf)) {
+        size_t n = MIN(sizeof(buf), hdr->old_size - offset);
+        ok = esp_partition_read(dl->base, offset, buf, n) == ESP_OK;
+        mbedtls_sha256_update(&sha, buf, n);
+    }
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (!ok || memcmp(digest, hdr->old_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Delta patch was made for a different firmware");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Applying delta patch: %lu -> %lu bytes", (unsigned long)hdr->old_size,
+             (unsigned long)hdr->new_size);
+    return true;
+}
+
+static bool delta_read_old(void *ctx, uint32_t offset, uint8_t *buf, size_t len)
+{
+    ota_delta_t *dl = ctx;
+    return esp_partition_read(dl->base, offset, buf, len) == ESP_OK;
+}
+
+static bool delta_write(void *ctx, const uint8_t *data, size_t len)
+{
+    ota_delta_t *dl = ctx;
+    mbedtls_sha256_update(&dl->sha, data, len);
+    return ota_write(data, len) == ESP_OK;
+}
+
+static const am7_delta_ops_t delta_ops = {
+    .begin = delta_begin,
+    .read_old = delta_read_old,
+    .write = delta_write,
+};
+
+// Full images go to ota_write, patches through the decoder
+static esp_err_t image_sink(void *ctx, const uint8_t *data, size_t len)
+{
+    if (!image_started) {
+        image_started = true;
+        if (am7_delta_is_patch(data, len)) {
+            delta = malloc(sizeof(*delta));
+            if (!delta) {
+                snprintf(error_message, sizeof(error_message), "Out of memory");
+                return ESP_ERR_NO_MEM;
+            }
+            delta->base = esp_ota_get_running_partition();
+            mbedtls_sha256_init(&delta->sha);
+            mbedtls_sha256_starts(&delta->sha, 0);
+            am7_delta_init(&delta->dec, &delta_ops, delta);
+        }
+    }
+    if (!delta) {
+        return ota_write(data, len);
+    }
+
+    if (!am7_delta_feed(&delta->dec, data, len)) {
+        if (ota_state != OTA_STATE_ERROR) {   // else ota_write has said why
+            snprintf(error_message, sizeof(error_message), "Delta patch: %s",
+                     am7_delta_strerror(delta->dec.error));
+        }
         return ESP_FAIL;
     }
-    
-    ESP_LOGI(TAG, "Starting SPIFFS OTA update (size: 0x%lx)", (unsigned long)spiffs_partition->size);
-    
-    // Erase SPIFFS partition
-    err = esp_partition_erase_range(spiffs_partition, 0, spiffs_partition->size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to erase SPIFFS partition: %s", esp_err_to_name(err));
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to erase SPIFFS");
-        return err;
+    return ESP_OK;
+}
+
+// With check, whether the patch produced its whole image with the expected
+// hash. Frees the decoder either way.
+static esp_err_t delta_finish(bool check)
+{
+    if (!delta) {
+        return ESP_OK;
     }
-    
-    size_t bytes_written = 0;
-    
-    // Receive and write data
-    while (1) {
-        received = httpd_req_recv(req, buf, sizeof(buf));
-        if (received < 0) {
-            if (received == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
+    esp_err_t ret = ESP_OK;
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&delta->sha, digest);
+    if (check && !am7_delta_done(&delta->dec)) {
+        snprintf(error_message, sizeof(error_message), "Delta patch: truncated");
+        ret = ESP_FAIL;
+    } else if (check && memcmp(digest, delta->dec.header.new_sha256, sizeof(digest)) != 0) {
+        snprintf(error_message, sizeof(error_message), "Delta patch: result SHA-256 mismatch");
+        ret = ESP_FAIL;
+    }
+    mbedtls_sha256_free(&delta->sha);
+    free(delta);
+    delta = NULL;
+    return ret;
+}
+
+// Pipeline sink for /api/ota. Images and patches may be sent gzipped; they
+// are inflated here, on the writer task, before image_sink.
+static gunzip_t *upload_gz = NULL;
+static bool upload_started = false;
+
+static esp_err_t upload_sink(const uint8_t *data, size_t len)
+{
+    if (!upload_started) {
+        upload_started = true;
+        image_started = false;
+        if (gunzip_is_gzip(data, len)) {
+            upload_gz = gunzip_new(image_sink, NULL);
+            if (!upload_gz) {
+                snprintf(error_message, sizeof(error_message), "Out of memory");
+                return ESP_ERR_NO_MEM;
             }
-            ESP_LOGE(TAG, "Error receiving SPIFFS data");
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive data");
-            return ESP_FAIL;
         }
-        
-        if (received == 0) {
-            break;
+    }
+    bytes_received += len;
+    if (!upload_gz) {
+        return image_sink(NULL, data, len);
+    }
+
+    esp_err_t ret = gunzip_feed(upload_gz, data, len);
+    if (ret == ESP_ERR_INVALID_RESPONSE) {
+        snprintf(error_message, sizeof(error_message), "Corrupt gzip data");
+    }
+    return ret;
+}
+
+// After the upload: with check, whether everything sent was complete.
+// Frees the decoders either way.
+static esp_err_t upload_finish(bool check)
+{
+    esp_err_t ret = ESP_OK;
+    if (upload_gz) {
+        if (check && gunzip_finish(upload_gz) != ESP_OK) {
+            snprintf(error_message, sizeof(error_message), "Compressed image truncated");
+            ret = ESP_FAIL;
         }
-        
-        // Write to SPIFFS partition
-        err = esp_partition_write(spiffs_partition, bytes_written, buf, received);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write SPIFFS: %s", esp_err_to_name(err));
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write SPIFFS");
-            return err;
+        gunzip_free(upload_gz);
+        upload_gz = NULL;
+    }
+    esp_err_t delta_ret = delta_finish(check && ret == ESP_OK);
+    return ret != ESP_OK ? ret : delta_ret;
+}
+
+// HTTP handler for SPIFFS OTA upload. The web UI bundle goes to the slot not
+// being served and only replaces it once complete and verified, so a failed
+// upload leaves the current UI working.
+esp_err_t ota_spiffs_upload_handler(httpd_req_t *req)
+{
+    uint8_t expected[32];
+    int check = spiffs_expected_sha(req, expected);
+    if (check < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "sha256 must be 64 hex digits");
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&ota_lock);
+    bool busy = spiffs_busy;
+    spiffs_busy = true;
+    portEXIT_CRITICAL(&ota_lock);
+    if (busy) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "SPIFFS update already in progress");
+        return ESP_FAIL;
+    }
+
+    www_slot_t slot;
+    if (www_update_begin(&slot) != ESP_OK) {
+        spiffs_busy = false;
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "SPIFFS partition not found");
+        return ESP_FAIL;
+    }
+    if (req->content_len == 0 || req->content_len > slot.size) {
+        spiffs_busy = false;
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Image empty or larger than a web UI slot");
+        return ESP_FAIL;
+    }
+    uint8_t *head = malloc(WWW_SECTOR_SIZE);
+    if (!head) {
+        spiffs_busy = false;
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Starting SPIFFS OTA update: %zu bytes to offset 0x%lx", req->content_len,
+             (unsigned long)slot.offset);
+
+    uint8_t digest[32];
+    spiffs_writer_t writer = {
+        .slot = &slot,
+        .head = head,
+        .erased = WWW_SECTOR_SIZE,   // the header sector is erased on commit
+    };
+    httpd_err_code_t status = HTTPD_500_INTERNAL_SERVER_ERROR;
+    const char *failure = spiffs_receive(req, &writer, digest);
+    size_t head_len = MIN(writer.offset, WWW_SECTOR_SIZE);
+    if (failure) {
+        if (writer.rejected) {
+            status = HTTPD_400_BAD_REQUEST;
         }
-        
-        bytes_written += received;
+    } else if (check && memcmp(digest, expected, sizeof(digest)) != 0) {
+        failure = "SHA-256 mismatch";
+        status = HTTPD_400_BAD_REQUEST;
+    } else if (!www_head_valid(head, head_len, writer.offset)) {
+        failure = "Not a web UI bundle";
+        status = HTTPD_400_BAD_REQUEST;
+    } else if (!spiffs_open(&writer) || www_update_commit(&slot, head, head_len) != ESP_OK) {
+        failure = "Failed to write SPIFFS";
     }
-    
-    ESP_LOGI(TAG, "SPIFFS OTA complete, %zu bytes written", bytes_written);
+    free(head);
+
+    if (failure) {
+        ESP_LOGE(TAG, "SPIFFS OTA failed: %s", failure);
+        spiffs_busy = false;
+        httpd_resp_send_err(req, status, failure);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "SPIFFS OTA complete, %zu bytes written from %zu received%s", writer.offset, req->content_len,
+             check ? ", SHA-256 verified" : "");
     
     // Send success response
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"ok\":true,\"message\":\"SPIFFS updated successfully\"}");
     
-    // Reboot after 2 seconds to remount SPIFFS
+    // Reboot after 2 seconds to serve the new bundle
     vTaskDelay(pdMS_TO_TICKS(2000));
     esp_restart();
     
@@ -190,6 +628,7 @@ void ota_abort(void)
     }
     ota_state = OTA_STATE_IDLE;
     bytes_written = 0;
+    bytes_received = 0;
     total_size = 0;
 }
 
@@ -206,53 +645,96 @@ const char* ota_get_error_message(void)
 int ota_get_progress_percent(void)
 {
     if (total_size == 0) return 0;
-    return (int)((bytes_written * 100) / total_size);
+    return (int)((bytes_received * 100) / total_size);
+}
+
+esp_err_t ota_stream_begin(size_t total)
+{
+    esp_err_t err = ota_begin();
+    if (err != ESP_OK) {
+        return err;
+    }
+    total_size = total;
+    upload_started = false;
+    err = pipe_start(upload_sink);
+    if (err != ESP_OK) {
+        snprintf(error_message, sizeof(error_message), "Out of memory");
+        ota_abort();
+    }
+    return err;
+}
+
+uint8_t *ota_stream_buffer(size_t *size)
+{
+    *size = CONFIG_OTA_PIPE_BUF_SIZE;
+    return pipe_get();
+}
+
+esp_err_t ota_stream_put(uint8_t *buf, size_t len)
+{
+    pipe_put(buf, len);
+    return pipe_err;
+}
+
+esp_err_t ota_stream_end(bool complete)
+{
+    esp_err_t err = pipe_finish();
+    if (complete && err == ESP_OK) {
+        err = upload_finish(true);
+    } else {
+        upload_finish(false);
+        if (err == ESP_OK) {
+            snprintf(error_message, sizeof(error_message), "Transfer incomplete");
+            err = ESP_FAIL;
+        }
+    }
+    if (err != ESP_OK) {
+        ota_abort();
+        return err;
+    }
+    return ota_end();
 }
 
 // HTTP handler for OTA upload
 esp_err_t ota_upload_handler(httpd_req_t *req)
 {
-    char buf[1024];
     int received;
     int remaining = req->content_len;
 
     ESP_LOGI(TAG, "OTA upload started, size: %d bytes", remaining);
 
-    // Begin OTA
-    esp_err_t err = ota_begin();
+    esp_err_t err = ota_stream_begin(remaining);
     if (err != ESP_OK) {
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, ota_get_error_message());
         return ESP_FAIL;
     }
 
-    total_size = remaining;
-
-    // Receive and write firmware data
-    while (remaining > 0) {
-        received = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)));
-        if (received <= 0) {
-            if (received == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
+    // Receive firmware data into the pipeline, one full buffer at a time
+    bool failed = false;
+    while (remaining > 0 && !failed) {
+        size_t size;
+        uint8_t *buf = ota_stream_buffer(&size);
+        size_t fill = 0;
+        while (fill < size && remaining > 0) {
+            received = httpd_req_recv(req, (char *)buf + fill, MIN(remaining, size - fill));
+            if (received <= 0) {
+                if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+                    continue;
+                }
+                failed = true;
+                break;
             }
-            ota_abort();
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Upload failed");
-            return ESP_FAIL;
+            fill += received;
+            remaining -= received;
         }
-
-        err = ota_write((const uint8_t *)buf, received);
-        if (err != ESP_OK) {
-            ota_abort();
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, ota_get_error_message());
-            return ESP_FAIL;
+        if (ota_stream_put(buf, failed ? 0 : fill) != ESP_OK) {
+            break;
         }
-
-        remaining -= received;
     }
 
-    // Finalize OTA
-    err = ota_end();
+    err = ota_stream_end(!failed && remaining == 0);
     if (err != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, ota_get_error_message());
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, failed ? "Upload failed" : ota_get_error_message());
         return ESP_FAIL;
     }
 
@@ -19,6 +19,18 @@ ota_state_t ota_get_state(void);
 const char* ota_get_error_message(void);
 int ota_get_progress_percent(void);
 
+// Streamed update, for the upload handler and the pull client (ota_pull.h):
+// a full image, a delta patch or either gzipped, written to flash on a
+// separate task while the caller fetches the next buffer. Fill buffers from
+// ota_stream_buffer in order and hand each to ota_stream_put, which returns
+// the first write error so far. ota_stream_end(true) checks and finalizes the
+// image (bootable on the next restart); false aborts it. Errors leave a
+// reason in ota_get_error_message().
+esp_err_t ota_stream_begin(size_t total);   // total: bytes to transfer, for progress
+uint8_t *ota_stream_buffer(size_t *size);
+esp_err_t ota_stream_put(uint8_t *buf, size_t len);
+esp_err_t ota_stream_end(bool complete);
+
 // HTTP handler for OTA upload
 esp_err_t ota_upload_handler(httpd_req_t *req);
 esp_err_t ota_spiffs_upload_handler(httpd_req_t *req);
@@ -0,0 +1,360 @@
+#include "ota_pull.h"
+#include "ota.h"
+#include "settings.h"
+#include "version.h"
+#include "wifi_manager.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mbedtls/sha256.h"
+#include "cJSON.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "OTA_PULL";
+
+#define PULL_URL_LEN 256
+
+static SemaphoreHandle_t pull_wake = NULL;   // given by ota_pull_check_now
+
+typedef struct {
+    char version[16];
+    char url[PULL_URL_LEN];
+    size_t size;
+    uint8_t sha256[32];
+} pull_manifest_t;
+
+// One download, carried across reconnects
+typedef struct {
+    const pull_manifest_t *m;
+    mbedtls_sha256_context sha;
+    uint8_t *buf;           // pipeline buffer being filled
+    size_t buf_size;
+    size_t fill;
+    size_t done;            // bytes of the file received and hashed
+    int64_t range_start;    // from Content-Range, -1 if none
+} pull_download_t;
+
+static bool parse_hex(const char *hex, uint8_t *out, size_t len)
+{
+    if (strlen(hex) != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned int byte;
+        if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1]) ||
+            sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+// Whether "X.Y.Z" is later than the running VERSION_STRING
+static bool version_newer(const char *version)
+{
+    int major, minor, build;
+    if (sscanf(version, "%d.%d.%d", &major, &minor, &build) != 3) {
+        return false;
+    }
+    if (major != VERSION_MAJOR) {
+        return major > VERSION_MAJOR;
+    }
+    if (minor != VERSION_MINOR) {
+        return minor > VERSION_MINOR;
+    }
+    return build > VERSION_BUILD;
+}
+
+// ref resolved against base: absolute, host-relative ("/x") or relative to
+// the manifest's directory
+static bool resolve_url(const char *base, const char *ref, char *out, size_t out_len)
+{
+    size_t keep;
+    if (strstr(ref, "://")) {
+        keep = 0;
+    } else {
+        const char *host = strstr(base, "://");
+        if (!host) {
+            return false;
+        }
+        host += 3;
+        if (ref[0] == '/') {
+            keep = strcspn(host, "/?#") + (host - base);
+        } else {
+            size_t path_end = strcspn(base, "?#");
+            keep = host - base;
+            for (size_t i = keep; i < path_end; i++) {
+                if (base[i] == '/') {
+                    keep = i + 1;
+                }
+            }
+            if (keep == (size_t)(host - base)) {
+                keep = path_end;   // "http://host": no path yet
+            }
+        }
+    }
+    bool slash = keep > 0 && ref[0] != '/' && base[keep - 1] != '/';
+    int n = snprintf(out, out_len, "%.*s%s%s", (int)keep, base, slash ? "/" : "", ref);
+    return n > 0 && (size_t)n < out_len;
+}
+
+static esp_err_t fetch_manifest(const char *url, pull_manifest_t *m)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = CONFIG_OTA_PULL_TIMEOUT_MS,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return ESP_ERR_NO_MEM;
+    }
+    char *body = malloc(CONFIG_OTA_PULL_MANIFEST_LEN);
+    esp_err_t err = body ? esp_http_client_open(client, 0) : ESP_ERR_NO_MEM;
+    int len = 0;
+    if (err == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status != 200) {
+            ESP_LOGW(TAG, "Manifest: HTTP %d", status);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+        while (err == ESP_OK && len < CONFIG_OTA_PULL_MANIFEST_LEN - 1) {
+            int n = esp_http_client_read(client, body + len, CONFIG_OTA_PULL_MANIFEST_LEN - 1 - len);
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+        }
+    }
+    esp_http_client_cleanup(client);
+    if (err != ESP_OK) {
+        free(body);
+        return err;
+    }
+
+    body[len] = '\0';
+    cJSON *root = cJSON_Parse(body);
+    free(body);
+    cJSON *version = cJSON_GetObjectItem(root, "version");
+    cJSON *file = cJSON_GetObjectItem(root, "url");
+    cJSON *size = cJSON_GetObjectItem(root, "size");
+    cJSON *sha = cJSON_GetObjectItem(root, "sha256");
+    if (!cJSON_IsString(version) || !cJSON_IsString(file) || !cJSON_IsNumber(size) || size->valuedouble <= 0 ||
+        !cJSON_IsString(sha) || !parse_hex(sha->valuestring, m->sha256, sizeof(m->sha256)) ||
+        !resolve_url(url, file->valuestring, m->url, sizeof(m->url))) {
+        ESP_LOGW(TAG, "Manifest: missing or malformed fields");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    snprintf(m->version, sizeof(m->version), "%s", version->valuestring);
+    m->size = (size_t)size->valuedouble;
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t download_event(esp_http_client_event_t *evt)
+{
+    pull_download_t *dl = evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Content-Range") == 0) {
+        sscanf(evt->header_value, "bytes %" SCNd64, &dl->range_start);
+    }
+    return ESP_OK;
+}
+
+// One connection: fetch from dl->done onwards. ESP_OK once the whole file is
+// in, ESP_ERR_NOT_FINISHED if the connection dropped (worth retrying), any
+// other error if it is not.
+static esp_err_t download_part(pull_download_t *dl)
+{
+    esp_http_client_config_t config = {
+        .url = dl->m->url,
+        .timeout_ms = CONFIG_OTA_PULL_TIMEOUT_MS,
+        .event_handler = download_event,
+        .user_data = dl,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (dl->done > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%zu-", dl->done);
+        esp_http_client_set_header(client, "Range", range);
+    }
+    dl->range_start = -1;
+    if (esp_http_client_open(client, 0) != ESP_OK) {
+        esp_http_client_cleanup(client);
+        return ESP_ERR_NOT_FINISHED;
+    }
+    esp_http_client_fetch_headers(client);
+
+    // A server that ignores Range resends everything; skip what we have
+    size_t skip = 0;
+    int status = esp_http_client_get_status_code(client);
+    esp_err_t err = ESP_ERR_NOT_FINISHED;
+    if (status == 206 && dl->range_start == (int64_t)dl->done) {
+        skip = 0;
+    } else if (status == 200) {
+        skip = dl->done;
+    } else {
+        ESP_LOGE(TAG, "Download: HTTP %d", status);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    while (err == ESP_ERR_NOT_FINISHED && dl->done < dl->m->size) {
+        size_t want = dl->buf_size - dl->fill;
+        if (skip == 0 && want > dl->m->size - dl->done) {
+            want = dl->m->size - dl->done;
+        }
+        uint8_t *p = dl->buf + dl->fill;
+        int n = esp_http_client_read(client, (char *)p, want);
+        if (n <= 0) {
+            break;
+        }
+        size_t k = skip < (size_t)n ? skip : (size_t)n;
+        if (k > 0) {
+            memmove(p, p + k, n - k);
+            skip -= k;
+            n -= k;
+        }
+        if (dl->done + n > dl->m->size) {
+            ESP_LOGE(TAG, "Download is larger than the manifest says");
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        mbedtls_sha256_update(&dl->sha, p, n);
+        dl->fill += n;
+        dl->done += n;
+        if (dl->fill == dl->buf_size) {
+            if (ota_stream_put(dl->buf, dl->fill) != ESP_OK) {
+                err = ESP_FAIL;
+                break;
+            }
+            dl->buf = ota_stream_buffer(&dl->buf_size);
+            dl->fill = 0;
+        }
+    }
+    if (err == ESP_ERR_NOT_FINISHED && dl->done == dl->m->size) {
+        err = ESP_OK;
+    }
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+static esp_err_t pull_download(const pull_manifest_t *m)
+{
+    esp_err_t err = ota_stream_begin(m->size);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot start update: %s", ota_get_error_message());
+        return err;
+    }
+
+    pull_download_t dl = {.m = m};
+    mbedtls_sha256_init(&dl.sha);
+    mbedtls_sha256_starts(&dl.sha, 0);
+    dl.buf = ota_stream_buffer(&dl.buf_size);
+
+    // Reconnect after a drop, resuming where it stopped; only attempts that
+    // got nothing count against the limit
+    int failures = 0;
+    for (;;) {
+        size_t before = dl.done;
+        err = download_part(&dl);
+        if (err != ESP_ERR_NOT_FINISHED) {
+            break;
+        }
+        failures = dl.done > before ? 1 : failures + 1;
+        if (failures > CONFIG_OTA_PULL_RETRIES) {
+            ESP_LOGE(TAG, "Download stalled at %zu of %zu bytes", dl.done, m->size);
+            break;
+        }
+        ESP_LOGW(TAG, "Connection lost at %zu of %zu bytes, resuming", dl.done, m->size);
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_OTA_PULL_RETRY_MS << (failures - 1)));
+    }
+    if (err == ESP_OK && dl.fill > 0 && ota_stream_put(dl.buf, dl.fill) != ESP_OK) {
+        err = ESP_FAIL;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&dl.sha, digest);
+    mbedtls_sha256_free(&dl.sha);
+    if (err == ESP_OK && memcmp(digest, m->sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "SHA-256 mismatch, discarding download");
+        err = ESP_ERR_INVALID_CRC;
+    }
+
+    esp_err_t end = ota_stream_end(err == ESP_OK);
+    if (end != ESP_OK && err == ESP_OK) {
+        ESP_LOGE(TAG, "Update failed: %s", ota_get_error_message());
+    }
+    return err != ESP_OK ? err : end;
+}
+
+static void pull_check(void)
+{
+    // A copy: the settings buffer can be rewritten by POST /api/settings
+    // while the manifest is fetched and resolved against it
+    char url[PULL_URL_LEN];
+    snprintf(url, sizeof(url), "%s", settings_get_ota_url());
+    if (url[0] == '\0' || !wifi_is_connected()) {
+        return;
+    }
+
+    pull_manifest_t *m = malloc(sizeof(*m));
+    if (!m) {
+        return;
+    }
+    esp_err_t err = fetch_manifest(url, m);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Manifest check failed: %s", esp_err_to_name(err));
+    } else if (!version_newer(m->version)) {
+        ESP_LOGI(TAG, "Up to date (%s, server has %s)", VERSION_STRING, m->version);
+    } else {
+        ESP_LOGI(TAG, "Updating %s -> %s from %s (%zu bytes)", VERSION_STRING, m->version, m->url, m->size);
+        if (pull_download(m) == ESP_OK) {
+            ESP_LOGI(TAG, "Update to %s installed, restarting in 2 seconds...", m->version);
+            vTaskDelay(pdMS_TO_TICKS(2000));
+            esp_restart();
+        }
+    }
+    free(m);
+}
+
+static void pull_task(void *arg)
+{
+    uint32_t wait_s = CONFIG_OTA_PULL_FIRST_S;
+    for (;;) {
+        uint32_t jitter_s = esp_random() % (CONFIG_OTA_PULL_JITTER_S + 1);
+        xSemaphoreTake(pull_wake, (TickType_t)(wait_s + jitter_s) * configTICK_RATE_HZ);
+        pull_check();
+        wait_s = CONFIG_OTA_PULL_PERIOD_S;
+    }
+}
+
+void ota_pull_start(void)
+{
+    pull_wake = xSemaphoreCreateBinary();
+    if (!pull_wake || xTaskCreate(pull_task, "ota_pull", CONFIG_OTA_PULL_STACK, NULL, 3, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start");
+    }
+}
+
+esp_err_t ota_pull_check_now(void)
+{
+    if (!pull_wake || settings_get_ota_url()[0] == '\0') {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreGive(pull_wake);
+    return ESP_OK;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "esp_err.h"
+
+// Pull updates: the device polls a manifest on a local web server (the
+// settings' ota_url) and installs a newer image from it, then restarts.
+//   {"version": "1.5.0", "url": "airmaster-1.5.0.bin", "size": 1234567,
+//    "sha256": "<64 hex digits>"}
+// url may be relative to the manifest and point at anything /api/ota takes:
+// an image, a delta patch or either gzipped. size and sha256 are of that file.
+// The download resumes with a Range request after a dropped connection.
+// Checks are spread by a random delay so a fleet doesn't poll in step.
+
+void ota_pull_start(void);
+// Check now rather than at the next scheduled time; ESP_ERR_INVALID_STATE
+// without a manifest URL
+esp_err_t ota_pull_check_now(void);
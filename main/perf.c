@@ -0,0 +1,107 @@
+#include "perf.h"
+
+#if CONFIG_PERF_ENABLED
+
+#include <stdio.h>
+#include <string.h>
+
+static perf_hist_t *registry = NULL;
+static portMUX_TYPE registry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void perf_register(perf_hist_t *hist)
+{
+    portENTER_CRITICAL(&registry_lock);
+    for (perf_hist_t *h = registry; h; h = h->next) {
+        if (h == hist) {
+            portEXIT_CRITICAL(&registry_lock);
+            return;
+        }
+    }
+    hist->next = registry;
+    registry = hist;
+    portEXIT_CRITICAL(&registry_lock);
+}
+
+void perf_record_ns(perf_hist_t *hist, uint32_t ns)
+{
+    int b = ns ? 31 - __builtin_clz(ns) : 0;
+    portENTER_CRITICAL(&hist->lock);
+    hist->counts[b]++;
+    hist->count++;
+    hist->sum_ns += ns;
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+    portEXIT_CRITICAL(&hist->lock);
+}
+
+void perf_each(perf_visit_fn fn, void *ctx)
+{
+    // Entries are only ever added at the head, so the list is walked unlocked
+    perf_hist_t copy;
+    for (perf_hist_t *h = registry; h; h = h->next) {
+        portENTER_CRITICAL(&h->lock);
+        copy = *h;
+        portEXIT_CRITICAL(&h->lock);
+        if (!fn(&copy, ctx)) {
+            break;
+        }
+    }
+}
+
+uint32_t perf_quantile_ns(const perf_hist_t *hist, float q)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(q * hist->count);
+    uint32_t seen = 0;
+    for (int b = 0; b < PERF_BUCKETS; b++) {
+        seen += hist->counts[b];
+        if (seen > rank) {
+            uint32_t upper = b == 31 ? UINT32_MAX : (2u << b) - 1;
+            return upper < hist->max_ns ? upper : hist->max_ns;
+        }
+    }
+    return hist->max_ns;
+}
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} summary_ctx_t;
+
+static bool summary_visit(const perf_hist_t *hist, void *arg)
+{
+    summary_ctx_t *ctx = arg;
+    if (hist->detail) {
+        return true;
+    }
+    int n = snprintf(ctx->buf + ctx->len, ctx->size - ctx->len,
+                     "%s\"%s\":{\"n\":%lu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+                     ctx->len > 1 ? "," : "", hist->name, (unsigned long)hist->count,
+                     perf_quantile_ns(hist, 0.5f) / 1000.0f, perf_quantile_ns(hist, 0.99f) / 1000.0f,
+                     hist->max_ns / 1000.0f);
+    if (n < 0 || (size_t)n >= ctx->size - ctx->len - 1) {
+        return false;   // Out of room: keep what fits
+    }
+    ctx->len += n;
+    return true;
+}
+
+int perf_summary_json(char *buf, size_t size)
+{
+    if (size < 3) {
+        return 0;
+    }
+    summary_ctx_t ctx = {.buf = buf, .size = size - 1, .len = 1};
+    buf[0] = '{';
+    buf[1] = '\0';
+    perf_each(summary_visit, &ctx);
+    buf[ctx.len++] = '}';
+    buf[ctx.len] = '\0';
+    return (int)ctx.len;
+}
+
+#endif
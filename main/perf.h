@@ -0,0 +1,85 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Hot-path latency probes: log2 histograms in nanoseconds (bucket i counts
+// values in [2^i, 2^(i+1)) ns). Short non-blocking spans are timed with the
+// CPU cycle counter (PERF_BEGIN/PERF_END); the two cores' counters are
+// unrelated, so a span that migrated cores is dropped. Spans that cross
+// tasks or block use esp_timer microseconds (PERF_RECORD_US). With
+// CONFIG_PERF_ENABLED 0 every macro compiles to nothing.
+
+#define PERF_BUCKETS 32
+
+#if CONFIG_PERF_ENABLED
+
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct perf_hist {
+    const char *name;
+    portMUX_TYPE lock;
+    uint32_t counts[PERF_BUCKETS];
+    uint32_t count;
+    uint64_t sum_ns;
+    uint32_t max_ns;
+    bool detail;              // per-route probe, left out of perf_summary_json
+    struct perf_hist *next;   // registry link
+} perf_hist_t;
+
+#define PERF_HIST_INIT(label) {.name = (label), .lock = portMUX_INITIALIZER_UNLOCKED}
+#define PERF_HIST(var, label) static perf_hist_t var = PERF_HIST_INIT(label)
+#define PERF_REGISTER(var) perf_register(&(var))
+typedef struct {
+    uint32_t cycles;
+    int core;
+} perf_span_t;
+
+#define PERF_BEGIN(t) perf_span_t t = {esp_cpu_get_cycle_count(), esp_cpu_get_core_id()}
+#define PERF_END(var, t) perf_span_end(&(var), &(t))
+#define PERF_RECORD_US(var, us) perf_record_ns(&(var), perf_us_to_ns(us))
+
+static inline uint32_t perf_cycles_to_ns(uint32_t cycles)
+{
+    return (uint32_t)((uint64_t)cycles * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+static inline uint32_t perf_us_to_ns(int64_t us)
+{
+    return us <= 0 ? 0 : us >= UINT32_MAX / 1000 ? UINT32_MAX : (uint32_t)us * 1000;
+}
+
+void perf_register(perf_hist_t *hist);
+void perf_record_ns(perf_hist_t *hist, uint32_t ns);
+
+static inline void perf_span_end(perf_hist_t *hist, const perf_span_t *span)
+{
+    uint32_t cycles = esp_cpu_get_cycle_count() - span->cycles;
+    if (esp_cpu_get_core_id() == span->core) {
+        perf_record_ns(hist, perf_cycles_to_ns(cycles));
+    }
+}
+
+// Consistent copy of every registered histogram in turn; return false to stop
+typedef bool (*perf_visit_fn)(const perf_hist_t *hist, void *ctx);
+void perf_each(perf_visit_fn fn, void *ctx);
+
+// Upper bound of the bucket holding quantile q (0..1) of hist, in ns
+uint32_t perf_quantile_ns(const perf_hist_t *hist, float q);
+
+// {"<name>":{"n":..,"p50_us":..,"p99_us":..,"max_us":..},...} for the
+// probes not marked detail; returns length
+int perf_summary_json(char *buf, size_t size);
+
+#else
+
+#define PERF_HIST(var, label) struct perf_unused_##var
+#define PERF_REGISTER(var) ((void)0)
+#define PERF_BEGIN(t) ((void)0)
+#define PERF_END(var, t) ((void)0)
+#define PERF_RECORD_US(var, us) ((void)0)
+
+#endif
@@ -7,7 +7,26 @@
 static const char *TAG = "SETTINGS";
 static const char *NVS_NAMESPACE = "settings";
 
-static int interval = 10;
+static int interval = 10;       // Heartbeat: max seconds between publishes
+static int min_interval = 0;    // Throttle: min seconds between publishes (0 = off)
+static publish_mode_t publish_mode = PUBLISH_MODE_FULL;
+static topic_layout_t topic_layout = TOPIC_LAYOUT_JSON;
+static int keyframe_interval = 300;  // Deadband mode: full state at least this often
+static am7_deadband_t deadbands[AM7_FIELD_COUNT] = {
+    [AM7_FIELD_TEMP]     = {0.2f, 0},
+    [AM7_FIELD_HUMIDITY] = {1.0f, 0},
+    [AM7_FIELD_CO2]      = {20, 0.02f},
+    [AM7_FIELD_PM25]     = {2, 0.1f},
+    [AM7_FIELD_PM10]     = {2, 0.1f},
+    [AM7_FIELD_TVOC]     = {0.02f, 0},
+    [AM7_FIELD_HCHO]     = {0.005f, 0},
+    [AM7_FIELD_PC03]     = {10, 0.1f},
+    [AM7_FIELD_PC05]     = {10, 0.1f},
+    [AM7_FIELD_PC10]     = {10, 0.1f},
+    [AM7_FIELD_PC25]     = {10, 0.1f},
+    [AM7_FIELD_PC50]     = {10, 0.1f},
+    [AM7_FIELD_PC100]    = {10, 0.1f},
+};
 static char mqtt_broker[64] = "192.168.1.94";
 static int mqtt_port = 1883;
 static char mqtt_user[32] = "homeassistant";
@@ -18,6 +37,7 @@ static bool ha_discovery_enabled = true;
 static char wifi_ssid[32] = "ejeg";
 static char wifi_password[64] = "ejmegapass";
 static char hostname[32] = "sh-airmaster-adapter-esp";
+static char ota_url[SETTINGS_OTA_URL_LEN] = "";   // Update manifest polled by ota_pull.c; empty = off
 
 void settings_init(void) {
     esp_err_t ret = nvs_flash_init();
@@ -34,10 +54,31 @@ void settings_init(void) {
     if (ret == ESP_OK) {
         size_t len;
         int32_t temp_interval = interval;
+        int32_t temp_min_interval = min_interval;
         int32_t temp_port = mqtt_port;
         
         nvs_get_i32(handle, "interval", &temp_interval);
         interval = (int)temp_interval;
+
+        nvs_get_i32(handle, "min_interval", &temp_min_interval);
+        min_interval = (int)temp_min_interval;
+
+        uint8_t temp_mode = publish_mode;
+        int32_t temp_keyframe = keyframe_interval;
+        nvs_get_u8(handle, "publish_mode", &temp_mode);
+        publish_mode = temp_mode == PUBLISH_MODE_DEADBAND ? PUBLISH_MODE_DEADBAND : PUBLISH_MODE_FULL;
+        uint8_t temp_layout = topic_layout;
+        nvs_get_u8(handle, "topic_layout", &temp_layout);
+        topic_layout = temp_layout == TOPIC_LAYOUT_FIELDS ? TOPIC_LAYOUT_FIELDS : TOPIC_LAYOUT_JSON;
+        nvs_get_i32(handle, "keyframe_int", &temp_keyframe);
+        keyframe_interval = (int)temp_keyframe;
+
+        // Stored deadbands are only used if the field layout matches
+        am7_deadband_t temp_bands[AM7_FIELD_COUNT];
+        len = sizeof(temp_bands);
+        if (nvs_get_blob(handle, "deadbands", temp_bands, &len) == ESP_OK && len == sizeof(temp_bands)) {
+            memcpy(deadbands, temp_bands, sizeof(deadbands));
+        }
         
         len = sizeof(mqtt_broker);
         nvs_get_str(handle, "mqtt_broker", mqtt_broker, &len);
@@ -70,14 +111,17 @@ void settings_init(void) {
         len = sizeof(hostname);
         nvs_get_str(handle, "hostname", hostname, &len);
         
+        len = sizeof(ota_url);
+        nvs_get_str(handle, "ota_url", ota_url, &len);
+        
         nvs_close(handle);
         ESP_LOGI(TAG, "Settings loaded from NVS");
     } else {
         ESP_LOGW(TAG, "No saved settings found, using defaults");
     }
 
-    ESP_LOGI(TAG, "Interval: %d sec, MQTT: %s:%d, Topic: %s", 
-             interval, mqtt_broker, mqtt_port, mqtt_topic);
+    ESP_LOGI(TAG, "Interval: %d sec (min %d sec), MQTT: %s:%d, Topic: %s", 
+             interval, min_interval, mqtt_broker, mqtt_port, mqtt_topic);
 }
 
 esp_err_t settings_save(void) {
@@ -89,6 +133,11 @@ esp_err_t settings_save(void) {
     }
 
     nvs_set_i32(handle, "interval", (int32_t)interval);
+    nvs_set_i32(handle, "min_interval", (int32_t)min_interval);
+    nvs_set_u8(handle, "publish_mode", (uint8_t)publish_mode);
+    nvs_set_u8(handle, "topic_layout", (uint8_t)topic_layout);
+    nvs_set_i32(handle, "keyframe_int", (int32_t)keyframe_interval);
+    nvs_set_blob(handle, "deadbands", deadbands, sizeof(deadbands));
     nvs_set_str(handle, "mqtt_broker", mqtt_broker);
     nvs_set_i32(handle, "mqtt_port", (int32_t)mqtt_port);
     nvs_set_str(handle, "mqtt_user", mqtt_user);
@@ -99,6 +148,7 @@ esp_err_t settings_save(void) {
     nvs_set_str(handle, "wifi_ssid", wifi_ssid);
     nvs_set_str(handle, "wifi_password", wifi_password);
     nvs_set_str(handle, "hostname", hostname);
+    nvs_set_str(handle, "ota_url", ota_url);
 
     ret = nvs_commit(handle);
     nvs_close(handle);
@@ -108,6 +158,16 @@ esp_err_t settings_save(void) {
 }
 
 void settings_set_interval(int value) { interval = value; }
+void settings_set_min_interval(int value) { min_interval = value; }
+void settings_set_publish_mode(publish_mode_t mode) { publish_mode = mode; }
+void settings_set_topic_layout(topic_layout_t layout) { topic_layout = layout; }
+void settings_set_keyframe_interval(int value) { keyframe_interval = value; }
+void settings_set_deadband(am7_field_t field, float abs, float rel) {
+    if (field < AM7_FIELD_COUNT) {
+        deadbands[field].abs = abs;
+        deadbands[field].rel = rel;
+    }
+}
 void settings_set_mqtt_broker(const char *value) { strncpy(mqtt_broker, value, sizeof(mqtt_broker) - 1); }
 void settings_set_mqtt_port(int value) { mqtt_port = value; }
 void settings_set_mqtt_user(const char *value) { strncpy(mqtt_user, value, sizeof(mqtt_user) - 1); }
@@ -118,8 +178,14 @@ void settings_set_ha_discovery_enabled(bool enabled) { ha_discovery_enabled = en
 void settings_set_wifi_ssid(const char *value) { strncpy(wifi_ssid, value, sizeof(wifi_ssid) - 1); }
 void settings_set_wifi_password(const char *value) { strncpy(wifi_password, value, sizeof(wifi_password) - 1); }
 void settings_set_hostname(const char *value) { strncpy(hostname, value, sizeof(hostname) - 1); }
+void settings_set_ota_url(const char *value) { strncpy(ota_url, value, sizeof(ota_url) - 1); }
 
 int settings_get_interval(void) { return interval; }
+int settings_get_min_interval(void) { return min_interval; }
+publish_mode_t settings_get_publish_mode(void) { return publish_mode; }
+topic_layout_t settings_get_topic_layout(void) { return topic_layout; }
+int settings_get_keyframe_interval(void) { return keyframe_interval; }
+const am7_deadband_t *settings_get_deadbands(void) { return deadbands; }
 const char* settings_get_mqtt_broker(void) { return mqtt_broker; }
 int settings_get_mqtt_port(void) { return mqtt_port; }
 const char* settings_get_mqtt_user(void) { return mqtt_user; }
@@ -130,3 +196,4 @@ bool settings_get_ha_discovery_enabled(void) { return ha_discovery_enabled; }
 const char* settings_get_wifi_ssid(void) { return wifi_ssid; }
 const char* settings_get_wifi_password(void) { return wifi_password; }
 const char* settings_get_hostname(void) { return hostname; }
+const char* settings_get_ota_url(void) { return ota_url; }
@@ -1,11 +1,27 @@
 #pragma once
 #include "esp_err.h"
+#include "am7_fields.h"
+
+typedef enum {
+    PUBLISH_MODE_FULL = 0,      // Full JSON state on every publish
+    PUBLISH_MODE_DEADBAND = 1,  // Only fields outside their deadband, plus periodic keyframes
+} publish_mode_t;
+
+typedef enum {
+    TOPIC_LAYOUT_JSON = 0,      // One JSON document on <topic>
+    TOPIC_LAYOUT_FIELDS = 1,    // Retained bare values on <topic>/<field>
+} topic_layout_t;
 
 void settings_init(void);
 esp_err_t settings_save(void);
 
 // Getters
 int settings_get_interval(void);
+int settings_get_min_interval(void);
+publish_mode_t settings_get_publish_mode(void);
+topic_layout_t settings_get_topic_layout(void);
+int settings_get_keyframe_interval(void);
+const am7_deadband_t *settings_get_deadbands(void);
 const char* settings_get_mqtt_broker(void);
 int settings_get_mqtt_port(void);
 const char* settings_get_mqtt_user(void);
@@ -16,9 +32,16 @@ bool settings_get_ha_discovery_enabled(void);
 const char* settings_get_wifi_ssid(void);
 const char* settings_get_wifi_password(void);
 const char* settings_get_hostname(void);
+const char* settings_get_ota_url(void);
+#define SETTINGS_OTA_URL_LEN 128   // including the terminator
 
 // Setters
 void settings_set_interval(int value);
+void settings_set_min_interval(int value);
+void settings_set_publish_mode(publish_mode_t mode);
+void settings_set_topic_layout(topic_layout_t layout);
+void settings_set_keyframe_interval(int value);
+void settings_set_deadband(am7_field_t field, float abs, float rel);
 void settings_set_mqtt_broker(const char *value);
 void settings_set_mqtt_port(int value);
 void settings_set_mqtt_user(const char *value);
@@ -29,3 +52,4 @@ void settings_set_ha_discovery_enabled(bool enabled);
 void settings_set_wifi_ssid(const char *value);
 void settings_set_wifi_password(const char *value);
 void settings_set_hostname(const char *value);
+void settings_set_ota_url(const char *value);
@@ -0,0 +1,251 @@
+#include "sfq.h"
+#include "am7_record.h"
+#include "crashlog.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "SFQ";
+
+// Partition layout: a ring of sectors, each starting with a header that
+// carries a monotonic sequence number, followed by fixed-size records.
+// Records are appended in order; when the head reaches the next sector it is
+// erased and takes the next sequence number, so every sector is erased once
+// per pass over the partition. A full ring overwrites its oldest sector.
+#define SFQ_SECTOR_SIZE 4096
+#define SFQ_MAGIC 0x31514653  // "SFQ1"
+#define SFQ_RECORDS_PER_SECTOR ((SFQ_SECTOR_SIZE - sizeof(sfq_sector_hdr_t)) / sizeof(am7_record_t))
+
+// Clock counts as set once it is past this point (2020-01-01)
+#define SFQ_MIN_VALID_TIME 1577836800
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t reserved[2];
+} sfq_sector_hdr_t;
+
+typedef struct {
+    uint32_t sector;
+    uint32_t index;
+} sfq_pos_t;
+
+static const esp_partition_t *part = NULL;
+static uint32_t sector_count = 0;
+static uint32_t head_seq = 0;
+static sfq_pos_t head;      // next free record slot
+static sfq_pos_t tail;      // oldest record that may still be unsent
+static uint32_t pending = 0;
+static uint32_t dropped = 0;
+
+static size_t record_offset(sfq_pos_t pos)
+{
+    return pos.sector * SFQ_SECTOR_SIZE + sizeof(sfq_sector_hdr_t) + pos.index * sizeof(am7_record_t);
+}
+
+static void advance(sfq_pos_t *pos)
+{
+    if (++pos->index == SFQ_RECORDS_PER_SECTOR) {
+        pos->index = 0;
+        pos->sector = (pos->sector + 1) % sector_count;
+    }
+}
+
+static bool pos_equal(sfq_pos_t a, sfq_pos_t b)
+{
+    return a.sector == b.sector && a.index == b.index;
+}
+
+static bool read_header(uint32_t sector, sfq_sector_hdr_t *hdr)
+{
+    return esp_partition_read(part, sector * SFQ_SECTOR_SIZE, hdr, sizeof(*hdr)) == ESP_OK &&
+           hdr->magic == SFQ_MAGIC;
+}
+
+static esp_err_t start_sector(uint32_t sector, uint32_t seq)
+{
+    esp_err_t ret = esp_partition_erase_range(part, sector * SFQ_SECTOR_SIZE, SFQ_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    sfq_sector_hdr_t hdr = {.magic = SFQ_MAGIC, .seq = seq};
+    return esp_partition_write(part, sector * SFQ_SECTOR_SIZE, &hdr, sizeof(hdr));
+}
+
+esp_err_t sfq_init(void)
+{
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_SFQ_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "No '%s' partition, offline buffering disabled", CONFIG_SFQ_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    sector_count = part->size / SFQ_SECTOR_SIZE;
+
+    // Head is the sector with the highest sequence number
+    bool found = false;
+    sfq_sector_hdr_t hdr;
+    for (uint32_t s = 0; s < sector_count; s++) {
+        if (read_header(s, &hdr) && (!found || (int32_t)(hdr.seq - head_seq) > 0)) {
+            head.sector = s;
+            head_seq = hdr.seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        head = (sfq_pos_t){0, 0};
+        head_seq = 1;
+        tail = head;
+        ESP_LOGI(TAG, "Formatting queue (%lu sectors)", (unsigned long)sector_count);
+        return start_sector(0, head_seq);
+    }
+
+    // Oldest sector: walk back while the sequence numbers stay contiguous
+    uint32_t oldest = head.sector;
+    for (uint32_t back = 1; back < sector_count; back++) {
+        uint32_t s = (head.sector + sector_count - back) % sector_count;
+        if (!read_header(s, &hdr) || hdr.seq != head_seq - back) {
+            break;
+        }
+        oldest = s;
+    }
+
+    // Scan records from the oldest sector to the first free slot of the head
+    uint8_t *buf = malloc(SFQ_SECTOR_SIZE);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    bool tail_found = false;
+    head.index = SFQ_RECORDS_PER_SECTOR;
+    for (uint32_t s = oldest;; s = (s + 1) % sector_count) {
+        esp_partition_read(part, s * SFQ_SECTOR_SIZE, buf, SFQ_SECTOR_SIZE);
+        const am7_record_t *recs = (const am7_record_t *)(buf + sizeof(sfq_sector_hdr_t));
+        for (uint32_t i = 0; i < SFQ_RECORDS_PER_SECTOR; i++) {
+            if (s == head.sector && recs[i].state == AM7_RECORD_ERASED) {
+                head.index = i;
+                break;
+            }
+            if (recs[i].state == AM7_RECORD_WRITTEN) {
+                if (!tail_found) {
+                    tail = (sfq_pos_t){s, i};
+                    tail_found = true;
+                }
+                pending++;
+            }
+        }
+        if (s == head.sector) {
+            break;
+        }
+    }
+    free(buf);
+
+    if (!tail_found) {
+        tail = head;
+    }
+    ESP_LOGI(TAG, "Queue ready: %lu sectors, %lu pending", (unsigned long)sector_count, (unsigned long)pending);
+    return ESP_OK;
+}
+
+bool sfq_push(const am7_data_t *data)
+{
+    if (!part) {
+        return false;
+    }
+
+    if (head.index == SFQ_RECORDS_PER_SECTOR) {
+        uint32_t next = (head.sector + 1) % sector_count;
+
+        // Ring full: the oldest sector is reclaimed along with its unsent records
+        if (pending > 0 && tail.sector == next) {
+            am7_record_t rec;
+            for (sfq_pos_t pos = tail; pos.sector == next; advance(&pos)) {
+                if (esp_partition_read(part, record_offset(pos), &rec, 1) == ESP_OK &&
+                    rec.state == AM7_RECORD_WRITTEN && pending > 0) {
+                    pending--;
+                    dropped++;
+                }
+            }
+            tail = (sfq_pos_t){(next + 1) % sector_count, 0};
+            ESP_LOGW(TAG, "Queue full, dropped oldest sector (%lu dropped total)", (unsigned long)dropped);
+        }
+
+        if (start_sector(next, head_seq + 1) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start sector %lu", (unsigned long)next);
+            return false;
+        }
+        head_seq++;
+        head = (sfq_pos_t){next, 0};
+    }
+    if (pending == 0) {
+        tail = head;
+    }
+
+    // Unix time when the clock is set, otherwise uptime resolved at drain time
+    time_t now = time(NULL);
+    uint32_t timestamp = (uint32_t)now;
+    uint8_t flags = 0;
+    if (now < SFQ_MIN_VALID_TIME) {
+        timestamp = (uint32_t)(esp_timer_get_time() / 1000000);
+        flags = AM7_RECORD_F_UPTIME;
+    }
+
+    am7_record_t rec;
+    am7_record_encode(&rec, data, timestamp, flags, (uint8_t)crashlog_get_boot_count());
+    esp_err_t ret = esp_partition_write(part, record_offset(head), &rec, sizeof(rec));
+    advance(&head);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Record write failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+    pending++;
+    return true;
+}
+
+bool sfq_front(am7_data_t *data, uint32_t *timestamp)
+{
+    am7_record_t rec;
+
+    while (part && pending > 0 && !pos_equal(tail, head)) {
+        if (esp_partition_read(part, record_offset(tail), &rec, sizeof(rec)) != ESP_OK) {
+            return false;
+        }
+        if (rec.state == AM7_RECORD_WRITTEN && am7_record_decode(&rec, data)) {
+            *timestamp = rec.timestamp;
+            if (rec.flags & AM7_RECORD_F_UPTIME) {
+                // Uptime stamps are only meaningful within the boot that wrote them
+                time_t now = time(NULL);
+                uint32_t uptime = (uint32_t)(esp_timer_get_time() / 1000000);
+                bool same_boot = rec.boot == (uint8_t)crashlog_get_boot_count();
+                *timestamp = (same_boot && now >= SFQ_MIN_VALID_TIME) ? (uint32_t)now - (uptime - rec.timestamp) : 0;
+            }
+            return true;
+        }
+        if (rec.state == AM7_RECORD_WRITTEN) {
+            // Torn or corrupt record: retire it so the queue keeps moving
+            uint8_t state = AM7_RECORD_SENT;
+            esp_partition_write(part, record_offset(tail), &state, 1);
+            pending--;
+            dropped++;
+        }
+        advance(&tail);
+    }
+    return false;
+}
+
+void sfq_pop(void)
+{
+    if (!part || pending == 0 || pos_equal(tail, head)) {
+        return;
+    }
+    // WRITTEN -> SENT only clears bits, so the state byte is rewritten in place
+    uint8_t state = AM7_RECORD_SENT;
+    esp_partition_write(part, record_offset(tail), &state, 1);
+    advance(&tail);
+    pending--;
+}
+
+uint32_t sfq_pending(void) { return pending; }
+uint32_t sfq_dropped(void) { return dropped; }
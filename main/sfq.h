@@ -0,0 +1,16 @@
+#pragma once
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "am7_proto.h"
+
+// Store-and-forward queue: samples taken while MQTT is unreachable are
+// appended to a ring log in the "sfq" flash partition and drained in order
+// once the broker is back. Single user (mqtt_task), no locking.
+esp_err_t sfq_init(void);
+bool sfq_push(const am7_data_t *data);
+// Oldest unsent sample; timestamp is Unix seconds, or 0 if it cannot be recovered
+bool sfq_front(am7_data_t *data, uint32_t *timestamp);
+void sfq_pop(void);   // mark the sample returned by sfq_front as sent
+uint32_t sfq_pending(void);
+uint32_t sfq_dropped(void);
@@ -2,19 +2,38 @@
 #include "version.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
-#include "spiffs.h"
+#include "www.h"
+#include "gunzip.h"
 #include "am7.h"
+#include "am7_payload.h"
+#include "am7_json.h"
+#include "logstore.h"
+#include "crashlog.h"
+#include "esp_core_dump.h"
+#include "esp_partition.h"
 #include "mqtt.h"
+#include "sfq.h"
+#include "history.h"
 #include "settings.h"
 #include "wifi_manager.h"
 #include "ota.h"
+#include "ota_pull.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "metrics.h"
+#include "perf.h"
 #include "esp_timer.h"
 #include "cJSON.h"
 #include "config.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 
 static const char *TAG = "WEB";
@@ -22,84 +41,76 @@ static httpd_handle_t server = NULL;
 
 // Log buffer for storing recent logs
 
+// Entry as rendered for the API
 typedef struct {
+    uint32_t seq;        // Monotonic entry number, 1 = first entry since boot
     char timestamp[32];  // ISO8601 format: 2026-02-02T12:34:56Z
     char level;          // I/W/E/D
     char message[CONFIG_MAX_LOG_MESSAGE_LENGTH];
 } log_entry_t;
 
-static log_entry_t log_buffer[CONFIG_MAX_LOG_LINES];
-static int log_write_index = 0;
-static int log_count = 0;
-static SemaphoreHandle_t log_mutex = NULL;
+// Lines are captured by logstore and only parsed here, when read
+static atomic_uint_least32_t log_cleared;   // entries up to this seq are hidden
 
-// Custom log hook to capture logs with timestamps
-static int custom_log_vprintf(const char *fmt, va_list args)
+static void log_render(const am7_logring_slot_t *slot, log_entry_t *entry)
 {
-    // Call default vprintf first
-    int ret = vprintf(fmt, args);
-    
-    // Capture to buffer if mutex is initialized
-    if (log_mutex && xSemaphoreTake(log_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        log_entry_t *entry = &log_buffer[log_write_index];
-        
-        // Get uptime in milliseconds and format as ISO8601 duration
-        uint64_t uptime_ms = esp_timer_get_time() / 1000;
-        uint32_t total_seconds = uptime_ms / 1000;
-        uint32_t milliseconds = uptime_ms % 1000;
-        uint32_t days = total_seconds / 86400;
-        uint32_t hours = (total_seconds % 86400) / 3600;
-        uint32_t minutes = (total_seconds % 3600) / 60;
-        uint32_t seconds = total_seconds % 60;
-        
-        // Format as ISO 8601 duration: P[n]DT[n]H[n]M[n].[n]S
-        if (days > 0) {
-            snprintf(entry->timestamp, sizeof(entry->timestamp),
-                     "P%luDT%luH%luM%lu.%03luS",
-                     (unsigned long)days, (unsigned long)hours, 
-                     (unsigned long)minutes, (unsigned long)seconds,
-                     (unsigned long)milliseconds);
-        } else {
-            snprintf(entry->timestamp, sizeof(entry->timestamp),
-                     "PT%luH%luM%lu.%03luS",
-                     (unsigned long)hours, (unsigned long)minutes, 
-                     (unsigned long)seconds, (unsigned long)milliseconds);
-        }
-        
-        // Create temporary buffer for full log
-        char temp_buffer[CONFIG_MAX_LOG_MESSAGE_LENGTH + 50];
-        vsnprintf(temp_buffer, sizeof(temp_buffer), fmt, args);
-        
-        // Parse log format: "I (1772) TAG: message"
-        // Extract log level
-        entry->level = temp_buffer[0];
-        
-        // Skip to message after ')'
-        char *msg = strchr(temp_buffer, ')');
-        if (msg) {
-            msg++;
-            while (*msg == ' ') msg++;  // Skip spaces
-        } else {
-            msg = temp_buffer;
-        }
-        
-        // Copy message and remove trailing newline
-        strncpy(entry->message, msg, CONFIG_MAX_LOG_MESSAGE_LENGTH - 1);
-        entry->message[CONFIG_MAX_LOG_MESSAGE_LENGTH - 1] = '\0';
-        size_t len = strlen(entry->message);
-        if (len > 0 && entry->message[len - 1] == '\n') {
-            entry->message[len - 1] = '\0';
-        }
-        
-        log_write_index = (log_write_index + 1) % CONFIG_MAX_LOG_LINES;
-        if (log_count < CONFIG_MAX_LOG_LINES) {
-            log_count++;
-        }
-        
-        xSemaphoreGive(log_mutex);
+    entry->seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+    uint32_t total_seconds = slot->uptime_ms / 1000;
+    uint32_t milliseconds = slot->uptime_ms % 1000;
+    uint32_t days = total_seconds / 86400;
+    uint32_t hours = (total_seconds % 86400) / 3600;
+    uint32_t minutes = (total_seconds % 3600) / 60;
+    uint32_t seconds = total_seconds % 60;
+
+    // Format as ISO 8601 duration: P[n]DT[n]H[n]M[n].[n]S
+    if (days > 0) {
+        snprintf(entry->timestamp, sizeof(entry->timestamp),
+                 "P%luDT%luH%luM%lu.%03luS",
+                 (unsigned long)days, (unsigned long)hours,
+                 (unsigned long)minutes, (unsigned long)seconds,
+                 (unsigned long)milliseconds);
+    } else {
+        snprintf(entry->timestamp, sizeof(entry->timestamp),
+                 "PT%luH%luM%lu.%03luS",
+                 (unsigned long)hours, (unsigned long)minutes,
+                 (unsigned long)seconds, (unsigned long)milliseconds);
     }
-    
-    return ret;
+
+    // Parse log format: "I (1772) TAG: message"
+    entry->level = slot->text[0];
+    size_t len;
+    const char *msg = am7_logring_message(slot->text, &len);
+    if (len > CONFIG_MAX_LOG_MESSAGE_LENGTH - 1) {
+        len = CONFIG_MAX_LOG_MESSAGE_LENGTH - 1;
+    }
+    memcpy(entry->message, msg, len);
+    entry->message[len] = '\0';
+}
+
+// JSON responses stream through a stack buffer: a document that fits goes
+// out in one piece with Content-Length, a longer one as chunks
+static bool json_send_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk(ctx, data, len) == ESP_OK;
+}
+
+static void json_begin(am7_json_t *w, httpd_req_t *req, char *buf, size_t size)
+{
+    httpd_resp_set_type(req, "application/json");
+    am7_json_init(w, buf, size, json_send_chunk, req);
+}
+
+static esp_err_t json_end(am7_json_t *w)
+{
+    httpd_req_t *req = w->ctx;
+    if (w->flushed == 0 && !w->error) {
+        return httpd_resp_send(req, w->buf, w->len);
+    }
+    if (!am7_json_finish(w)) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
 
 // File serving handler
@@ -131,20 +142,150 @@ static esp_err_t serve_file(httpd_req_t *req, const char *filepath, const char *
     return ESP_OK;
 }
 
+static esp_err_t send_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk(ctx, data, len);
+}
+
+// Whether the client takes gzip: listed in Accept-Encoding (or *) without
+// q=0. A header too long to read is assumed to come from a browser.
+static bool accepts_gzip(httpd_req_t *req)
+{
+    char value[128];
+    esp_err_t ret = httpd_req_get_hdr_value_str(req, "Accept-Encoding", value, sizeof(value));
+    if (ret == ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return true;
+    }
+    if (ret != ESP_OK) {
+        return false;
+    }
+    char *save;
+    for (char *tok = strtok_r(value, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        tok += strspn(tok, " \t");
+        size_t len = strcspn(tok, " \t;");
+        if ((len == 4 && strncasecmp(tok, "gzip", 4) == 0) || (len == 1 && tok[0] == '*')) {
+            const char *q = strstr(tok + len, "q=");
+            return !q || strtof(q + 2, NULL) > 0;
+        }
+    }
+    return false;
+}
+
+static esp_err_t send_inflated(void *ctx, const uint8_t *data, size_t len)
+{
+    return httpd_resp_send_chunk(ctx, (const char *)data, len);
+}
+
+static esp_err_t feed_gunzip(void *ctx, const char *data, size_t len)
+{
+    return gunzip_feed(ctx, (const uint8_t *)data, len);
+}
+
+// Bundled files are stored gzipped; clients that don't take gzip get them
+// inflated on the way out
+static esp_err_t send_identity(httpd_req_t *req, const www_entry_t *entry)
+{
+    gunzip_t *gz = gunzip_new(send_inflated, req);
+    if (!gz) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    esp_err_t ret = www_send(entry, feed_gunzip, gz);
+    if (ret == ESP_OK) {
+        ret = gunzip_finish(gz);
+    }
+    gunzip_free(gz);
+    if (ret != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Static asset from the www bundle, gzip-encoded (when accepted) with a
+// strong ETag and 304 on a match. Requests carrying ?v=<etag> (the references tools/www_pack.py
+// writes into the pages) may be cached for good; the rest revalidate.
+static esp_err_t serve_asset_entry(httpd_req_t *req, const char *path)
+{
+    const www_entry_t *entry = www_find(path);
+    if (!entry) {
+        char file[64];
+        snprintf(file, sizeof(file), "%s%s", CONFIG_SPIFFS_BASE_PATH, path);
+        return serve_file(req, file, www_content_type(path));
+    }
+
+    // The inflated copy is another representation, so it gets its own tag
+    bool gzip = accepts_gzip(req);
+    char etag[28];
+    snprintf(etag, sizeof(etag), "\"%s%s\"", entry->etag, gzip ? "" : "-id");
+    char query[48], version[20];
+    bool versioned = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                     httpd_query_key_value(query, "v", version, sizeof(version)) == ESP_OK &&
+                     strcmp(version, entry->etag) == 0;
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    httpd_resp_set_hdr(req, "Cache-Control", versioned ? "public, max-age=31536000, immutable" : "no-cache");
+
+    char match[96];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK &&
+        strstr(match, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, www_content_type(path));
+    if (!gzip) {
+        return send_identity(req, entry);
+    }
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    const void *data = www_data(entry);
+    if (data) {
+        return httpd_resp_send(req, data, entry->size);   // straight from mapped flash
+    }
+    if (www_send(entry, send_chunk, req) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t serve_asset(httpd_req_t *req, const char *path)
+{
+    // Held for the whole response so an update cannot pull the bundle or
+    // SPIFFS from under it
+    if (!www_enter()) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "10");
+        httpd_resp_sendstr(req, "Web UI is being updated");
+        return ESP_FAIL;
+    }
+    esp_err_t ret = serve_asset_entry(req, path);
+    www_leave();
+    return ret;
+}
+
+static bool asset_exists(const char *path)
+{
+    if (!www_enter()) {
+        return false;
+    }
+    bool found = www_find(path) != NULL;
+    www_leave();
+    return found;
+}
+
 // Root handler
 static esp_err_t index_handler(httpd_req_t *req)
 {
     // If in AP mode, redirect to setup page for captive portal
     if (wifi_is_ap_mode()) {
-        return serve_file(req, "/spiffs/setup.html", "text/html");
+        return serve_asset(req, "/setup.html");
     }
-    return serve_file(req, "/spiffs/index.html", "text/html");
+    return serve_asset(req, "/index.html");
 }
 
 // Setup page handler (for AP mode)
 static esp_err_t setup_page_handler(httpd_req_t *req)
 {
-    return serve_file(req, "/spiffs/setup.html", "text/html");
+    return serve_asset(req, "/setup.html");
 }
 
 // Captive portal redirect handler - catches all unknown routes in AP mode
@@ -160,114 +301,312 @@ static esp_err_t captive_portal_handler(httpd_req_t *req)
 // Settings page handler
 static esp_err_t settings_page_handler(httpd_req_t *req)
 {
-    return serve_file(req, "/spiffs/settings.html", "text/html");
+    return serve_asset(req, "/settings.html");
 }
 
 // OTA page handler
 static esp_err_t ota_page_handler(httpd_req_t *req)
 {
-    return serve_file(req, "/spiffs/ota.html", "text/html");
+    return serve_asset(req, "/ota.html");
 }
 
 // Logs page handler
 static esp_err_t logs_page_handler(httpd_req_t *req)
 {
-    return serve_file(req, "/spiffs/logs.html", "text/html");
+    return serve_asset(req, "/logs.html");
 }
 
 static esp_err_t sensor_page_handler(httpd_req_t *req)
 {
-    return serve_file(req, "/spiffs/sensor.html", "text/html");
+    return serve_asset(req, "/sensor.html");
 }
 
-// CSS handler
-static esp_err_t css_handler(httpd_req_t *req)
+// One history value (null for empty buckets) in display units
+static void history_write_value(am7_json_t *w, am7_field_t field, bool present, uint16_t raw)
 {
-    return serve_file(req, "/spiffs/style.css", "text/css");
+    const am7_field_info_t *info = &am7_field_info[field];
+    if (!present) {
+        am7_json_null(w, NULL);
+    } else if (info->scale == 1) {
+        am7_json_uint(w, NULL, raw);
+    } else {
+        am7_json_number(w, NULL, (double)raw / info->scale, info->decimals);
+    }
 }
 
-// JS handlers
-static esp_err_t app_js_handler(httpd_req_t *req)
+// API: Sensor history
+// GET /api/history?field=co2&from=<sec>&to=<sec>&res=<sec>
+// from/to default to the last hour on the device clock ("now" in the reply);
+// span=<sec> instead of from selects the most recent span seconds.
+// Returns packed columns: bucket i starts at from + i * res.
+static esp_err_t api_history_handler(httpd_req_t *req)
 {
-    return serve_file(req, "/spiffs/app.js", "application/javascript");
-}
+    char query[128] = {0};
+    char value[32];
+    uint32_t now = history_now();
+    uint32_t to = now + 1;
+    uint32_t from = now > 3600 ? now - 3600 : 0;
+    uint32_t res = 0;
+    int field = AM7_FIELD_CO2;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "field", value, sizeof(value)) == ESP_OK) {
+            field = am7_field_find(value);
+        }
+        if (httpd_query_key_value(query, "span", value, sizeof(value)) == ESP_OK) {
+            uint32_t span = strtoul(value, NULL, 10);
+            from = now > span ? now - span : 0;
+        }
+        if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+            from = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+            to = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "res", value, sizeof(value)) == ESP_OK) {
+            res = strtoul(value, NULL, 10);
+        }
+    }
+    if (field < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown field");
+        return ESP_FAIL;
+    }
 
-static esp_err_t settings_js_handler(httpd_req_t *req)
-{
-    return serve_file(req, "/spiffs/settings.js", "application/javascript");
+    am7_hist_stat_t *stats = malloc(CONFIG_HISTORY_MAX_POINTS * sizeof(am7_hist_stat_t));
+    bool *present = malloc(CONFIG_HISTORY_MAX_POINTS * sizeof(bool));
+    history_range_t range;
+    if (!stats || !present ||
+        !history_query((am7_field_t)field, from, to, res, CONFIG_HISTORY_MAX_POINTS, stats, present, &range)) {
+        free(stats);
+        free(present);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid range");
+        return ESP_FAIL;
+    }
+
+    // Stream the columns in chunks instead of building the whole document
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    am7_json_t w;
+    json_begin(&w, req, buf, sizeof(buf));
+
+    am7_json_object_begin(&w, NULL);
+    am7_json_string(&w, "field", am7_field_info[field].name);
+    am7_json_uint(&w, "now", now);
+    am7_json_uint(&w, "from", range.from);
+    am7_json_uint(&w, "res", range.res);
+    am7_json_uint(&w, "count", range.count);
+    static const char *columns[] = {"min", "max", "avg"};
+    for (int c = 0; c < 3; c++) {
+        am7_json_array_begin(&w, columns[c]);
+        for (uint32_t i = 0; i < range.count; i++) {
+            uint16_t raw = c == 0 ? stats[i].min : c == 1 ? stats[i].max : stats[i].avg;
+            history_write_value(&w, (am7_field_t)field, present[i], raw);
+        }
+        am7_json_array_end(&w);
+    }
+    am7_json_object_end(&w);
+    esp_err_t ret = json_end(&w);
+
+    free(stats);
+    free(present);
+    return ret;
 }
 
-static esp_err_t sensor_js_handler(httpd_req_t *req)
+// Oldest buffered entry with seq >= *seq, rendered; *seq is moved past any
+// entries already overwritten or cleared
+static bool log_entry_copy(uint32_t *seq, log_entry_t *out)
 {
-    return serve_file(req, "/spiffs/sensor.js", "application/javascript");
+    am7_logring_slot_t slot;
+    uint32_t cleared = atomic_load_explicit(&log_cleared, memory_order_relaxed);
+    if (*seq <= cleared) {
+        *seq = cleared + 1;
+    }
+    if (!logstore_read(seq, &slot)) {
+        return false;
+    }
+    log_render(&slot, out);
+    return true;
 }
 
-// API: Get logs
+// API: Get logs. since=<seq> returns only newer entries, limit caps the count;
+// "next" is the cursor for the following request. Entries are streamed one at
+// a time from the ring, so logging is never blocked for more than one copy.
 static esp_err_t api_logs_handler(httpd_req_t *req)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON *logs_array = cJSON_CreateArray();
-    
-    if (log_mutex && xSemaphoreTake(log_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        int start_index = (log_count < CONFIG_MAX_LOG_LINES) ? 0 : log_write_index;
-        int total_logs = (log_count < CONFIG_MAX_LOG_LINES) ? log_count : CONFIG_MAX_LOG_LINES;
-        
-        for (int i = 0; i < total_logs; i++) {
-            int index = (start_index + i) % CONFIG_MAX_LOG_LINES;
-            log_entry_t *entry = &log_buffer[index];
-            if (entry->message[0] != '\0') {
-                cJSON *log_obj = cJSON_CreateObject();
-                cJSON_AddStringToObject(log_obj, "timestamp", entry->timestamp);
-                cJSON_AddStringToObject(log_obj, "level", (char[]){entry->level, '\0'});
-                cJSON_AddStringToObject(log_obj, "message", entry->message);
-                cJSON_AddItemToArray(logs_array, log_obj);
-            }
+    char query[64] = {0};
+    char value[16];
+    uint32_t since = 0;
+    uint32_t limit = CONFIG_MAX_LOG_LINES;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            since = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "limit", value, sizeof(value)) == ESP_OK) {
+            limit = strtoul(value, NULL, 10);
         }
-        
-        xSemaphoreGive(log_mutex);
     }
-    
-    cJSON_AddItemToObject(root, "logs", logs_array);
-    cJSON_AddNumberToObject(root, "count", log_count);
-    
-    char *json_str = cJSON_Print(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    am7_json_t w;
+    json_begin(&w, req, buf, sizeof(buf));
+    am7_json_object_begin(&w, NULL);
+    am7_json_array_begin(&w, "logs");
+
+    if (since > logstore_head()) {
+        since = 0;  // Cursor from before a reboot
+    }
+    uint32_t seq = since + 1;
+    uint32_t count = 0;
+    log_entry_t entry;
+    while (count < limit && !w.error && log_entry_copy(&seq, &entry)) {
+        am7_json_object_begin(&w, NULL);
+        am7_json_uint(&w, "seq", entry.seq);
+        am7_json_string(&w, "timestamp", entry.timestamp);
+        am7_json_string(&w, "level", (char[]){entry.level, '\0'});
+        am7_json_string(&w, "message", entry.message);
+        am7_json_object_end(&w);
+        seq = entry.seq + 1;
+        count++;
+    }
+
+    am7_json_array_end(&w);
+    am7_json_uint(&w, "count", count);
+    am7_json_uint(&w, "next", seq - 1);
+    am7_json_object_end(&w);
+    return json_end(&w);
 }
 
 // API: Clear logs
 static esp_err_t api_logs_clear_handler(httpd_req_t *req)
 {
-    if (log_mutex && xSemaphoreTake(log_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        memset(log_buffer, 0, sizeof(log_buffer));
-        log_write_index = 0;
-        log_count = 0;
-        xSemaphoreGive(log_mutex);
-        ESP_LOGI(TAG, "Logs cleared");
+    atomic_store(&log_cleared, logstore_head());
+    ESP_LOGI(TAG, "Logs cleared");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"ok\":true}");
+    return ESP_OK;
+}
+
+typedef struct {
+    httpd_req_t *req;
+    uint16_t boot;
+    uint32_t skip;        // matching lines to pass over before sending
+    uint32_t count;       // matching lines seen
+    esp_err_t ret;
+} journal_tail_t;
+
+static bool journal_count_cb(const logstore_record_t *rec, void *ctx)
+{
+    journal_tail_t *tail = ctx;
+    if (rec->boot == tail->boot) {
+        tail->count++;
     }
-    
-    cJSON *response = cJSON_CreateObject();
-    cJSON_AddBoolToObject(response, "ok", true);
-    char *json_str = cJSON_Print(response);
+    return true;
+}
+
+static bool journal_send_cb(const logstore_record_t *rec, void *ctx)
+{
+    journal_tail_t *tail = ctx;
+    if (rec->boot != tail->boot || tail->count++ < tail->skip) {
+        return true;
+    }
+    char line[AM7_LOGRING_TEXT_LEN + 32];
+    int len = snprintf(line, sizeof(line), "[%lu.%03lu] %c %.*s\n",
+                       (unsigned long)(rec->uptime_ms / 1000), (unsigned long)(rec->uptime_ms % 1000),
+                       rec->level, (int)rec->len, rec->text);
+    if (len >= (int)sizeof(line)) {
+        len = sizeof(line) - 1;
+    }
+    tail->ret = httpd_resp_send_chunk(tail->req, line, len);
+    return tail->ret == ESP_OK;
+}
+
+// API: Last lines of an earlier boot from the flash journal as plain text;
+// boot defaults to the previous one, lines to CONFIG_LOGSTORE_TAIL_LINES
+static esp_err_t api_logs_previous_handler(httpd_req_t *req)
+{
+    char query[64] = {0};
+    char value[16];
+    uint32_t boot = crashlog_get_boot_count() - 1;
+    uint32_t lines = CONFIG_LOGSTORE_TAIL_LINES;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "boot", value, sizeof(value)) == ESP_OK) {
+            boot = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "lines", value, sizeof(value)) == ESP_OK) {
+            lines = strtoul(value, NULL, 10);
+        }
+    }
+
+    journal_tail_t tail = {.req = req, .boot = (uint16_t)boot, .ret = ESP_OK};
+    logstore_journal_each(journal_count_cb, &tail);
+    tail.skip = tail.count > lines ? tail.count - lines : 0;
+    tail.count = 0;
+
+    char header[80];
+    snprintf(header, sizeof(header), "# boot %lu, %lu lines\n",
+             (unsigned long)boot, (unsigned long)(tail.skip ? lines : tail.count));
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_send_chunk(req, header, HTTPD_RESP_USE_STRLEN);
+    logstore_journal_each(journal_send_cb, &tail);
+    if (tail.ret == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return tail.ret;
+}
+
+// API: Download the core dump (ELF) straight from its partition in chunks
+static esp_err_t api_coredump_handler(httpd_req_t *req)
+{
+    size_t addr = 0;
+    size_t size = 0;
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_DATA_COREDUMP, NULL);
+    if (!part || !crashlog_get_coredump()->present || esp_core_dump_image_get(&addr, &size) != ESP_OK ||
+        addr < part->address || addr - part->address + size > part->size) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No core dump");
+        return ESP_FAIL;
+    }
+
+    char *buf = malloc(CONFIG_COREDUMP_CHUNK_SIZE);
+    if (!buf) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"coredump.elf\"");
+
+    esp_err_t ret = ESP_OK;
+    size_t offset = addr - part->address;
+    for (size_t sent = 0; sent < size && ret == ESP_OK;) {
+        size_t len = size - sent < CONFIG_COREDUMP_CHUNK_SIZE ? size - sent : CONFIG_COREDUMP_CHUNK_SIZE;
+        ret = esp_partition_read(part, offset + sent, buf, len);
+        if (ret == ESP_OK) {
+            ret = httpd_resp_send_chunk(req, buf, len);
+        }
+        sent += len;
+    }
+    if (ret == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    free(buf);
+    return ret;
+}
+
+// API: Erase the stored core dump
+static esp_err_t api_coredump_erase_handler(httpd_req_t *req)
+{
+    crashlog_erase_coredump();
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(response);
+    httpd_resp_sendstr(req, "{\"ok\":true}");
     return ESP_OK;
 }
 
 // API: Toggle debug mode (runtime only, not persisted)
 static esp_err_t api_debug_handler(httpd_req_t *req)
 {
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "POST, OPTIONS");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type");
-    
     char buffer[128];
     int ret = httpd_req_recv(req, buffer, sizeof(buffer) - 1);
     if (ret <= 0) {
@@ -294,137 +633,172 @@ static esp_err_t api_debug_handler(httpd_req_t *req)
 
     cJSON_Delete(root);
 
-    cJSON *response = cJSON_CreateObject();
-    cJSON_AddBoolToObject(response, "ok", true);
-    char *json_str = cJSON_Print(response);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(response);
+    httpd_resp_sendstr(req, "{\"ok\":true}");
     return ESP_OK;
 }
 
 // API: Get status
 static esp_err_t api_status_handler(httpd_req_t *req)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "version", VERSION_STRING);
-    cJSON_AddNumberToObject(root, "build", VERSION_BUILD);
-    cJSON_AddStringToObject(root, "build_date", BUILD_DATE);
-    cJSON_AddStringToObject(root, "git_hash", GIT_HASH);
-    cJSON_AddNumberToObject(root, "uptime", esp_timer_get_time() / 1000000);
-    cJSON_AddNumberToObject(root, "interval", settings_get_interval());
-    cJSON_AddNumberToObject(root, "free_heap", esp_get_free_heap_size());
-
-    cJSON *am7 = cJSON_CreateObject();
-    cJSON_AddBoolToObject(am7, "connected", am7_connected);
-    cJSON_AddNumberToObject(am7, "last_rx_sec", last_rx_sec);
-    cJSON_AddItemToObject(root, "am7", am7);
-
-    cJSON *mqtt = cJSON_CreateObject();
-    cJSON_AddBoolToObject(mqtt, "connected", mqtt_connected);
-    cJSON_AddItemToObject(root, "mqtt", mqtt);
-
-    cJSON *wifi = cJSON_CreateObject();
-    cJSON_AddBoolToObject(wifi, "connected", wifi_is_connected());
-    cJSON_AddNumberToObject(wifi, "rssi", wifi_get_rssi());
-    cJSON_AddItemToObject(root, "wifi", wifi);
-
-    char *json_str = cJSON_Print(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    am7_json_t w;
+    json_begin(&w, req, buf, sizeof(buf));
+
+    am7_json_object_begin(&w, NULL);
+    am7_json_string(&w, "version", VERSION_STRING);
+    am7_json_int(&w, "build", VERSION_BUILD);
+    am7_json_string(&w, "build_date", BUILD_DATE);
+    am7_json_string(&w, "git_hash", GIT_HASH);
+    am7_json_uint(&w, "uptime", esp_timer_get_time() / 1000000);
+    am7_json_int(&w, "interval", settings_get_interval());
+    am7_json_uint(&w, "free_heap", esp_get_free_heap_size());
+
+    am7_json_object_begin(&w, "am7");
+    am7_json_bool(&w, "connected", am7_connected);
+    am7_json_int(&w, "last_rx_sec", last_rx_sec);
+    am7_json_object_end(&w);
+
+    am7_json_object_begin(&w, "mqtt");
+    am7_json_bool(&w, "connected", mqtt_connected);
+    am7_json_uint(&w, "backlog", sfq_pending());
+    am7_json_uint(&w, "backlog_dropped", sfq_dropped());
+    am7_json_object_end(&w);
+
+    am7_json_object_begin(&w, "wifi");
+    am7_json_bool(&w, "connected", wifi_is_connected());
+    am7_json_int(&w, "rssi", wifi_get_rssi());
+    am7_json_object_end(&w);
+
+    const crashlog_coredump_t *dump = crashlog_get_coredump();
+    if (dump->present) {
+        char hex[12];
+        am7_json_object_begin(&w, "crash");
+        am7_json_string(&w, "task", dump->task);
+        snprintf(hex, sizeof(hex), "0x%08lx", (unsigned long)dump->pc);
+        am7_json_string(&w, "pc", hex);
+        am7_json_array_begin(&w, "backtrace");
+        for (uint32_t i = 0; i < dump->depth; i++) {
+            snprintf(hex, sizeof(hex), "0x%08lx", (unsigned long)dump->backtrace[i]);
+            am7_json_string(&w, NULL, hex);
+        }
+        am7_json_array_end(&w);
+        am7_json_bool(&w, "backtrace_corrupted", dump->corrupted);
+        am7_json_string(&w, "app_sha256", dump->app_sha256);
+        am7_json_uint(&w, "size", dump->size);
+        am7_json_object_end(&w);
+    }
+
+    am7_json_object_end(&w);
+    return json_end(&w);
 }
 
 // API: Sensor values
 static esp_err_t api_sensor_handler(httpd_req_t *req)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "version", VERSION_STRING);
-    cJSON_AddBoolToObject(root, "connected", am7_connected);
-    cJSON_AddNumberToObject(root, "last_rx_sec", last_rx_sec);
-
-    cJSON *data = cJSON_CreateObject();
-    cJSON_AddNumberToObject(data, "temp", am7_data.temp);
-    cJSON_AddNumberToObject(data, "humidity", am7_data.humidity);
-    cJSON_AddNumberToObject(data, "co2", am7_data.co2);
-    cJSON_AddNumberToObject(data, "pm25", am7_data.pm25);
-    cJSON_AddNumberToObject(data, "pm10", am7_data.pm10);
-    cJSON_AddNumberToObject(data, "tvoc", am7_data.tvoc);
-    cJSON_AddNumberToObject(data, "hcho", am7_data.hcho);
-    cJSON_AddNumberToObject(data, "battery_status", am7_data.battery_status);
-    cJSON_AddNumberToObject(data, "battery_level", am7_data.battery_level);
-    cJSON_AddNumberToObject(data, "runtime_hours", am7_data.runtime_hours);
-    cJSON_AddNumberToObject(data, "pc03", am7_data.pc03);
-    cJSON_AddNumberToObject(data, "pc05", am7_data.pc05);
-    cJSON_AddNumberToObject(data, "pc10", am7_data.pc10);
-    cJSON_AddNumberToObject(data, "pc25", am7_data.pc25);
-    cJSON_AddNumberToObject(data, "pc50", am7_data.pc50);
-    cJSON_AddNumberToObject(data, "pc100", am7_data.pc100);
-    cJSON_AddItemToObject(root, "data", data);
-
-    char *json_str = cJSON_Print(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    am7_sample_t sample = {0};
+    am7_get_sample(&sample);
+
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    am7_json_t w;
+    json_begin(&w, req, buf, sizeof(buf));
+
+    am7_json_object_begin(&w, NULL);
+    am7_json_string(&w, "version", VERSION_STRING);
+    am7_json_bool(&w, "connected", am7_connected);
+    am7_json_int(&w, "last_rx_sec", last_rx_sec);
+    am7_json_uint(&w, "seq", sample.seq);
+    am7_payload_sensor_write(&w, "data", &sample.data);
+    am7_json_object_end(&w);
+    return json_end(&w);
 }
 
 // API: Get settings
 static esp_err_t api_get_settings_handler(httpd_req_t *req)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "version", VERSION_STRING);
-    
-    cJSON *wifi = cJSON_CreateObject();
-    cJSON_AddStringToObject(wifi, "ssid", settings_get_wifi_ssid());
-    cJSON_AddItemToObject(root, "wifi", wifi);
-
-    cJSON *mqtt = cJSON_CreateObject();
-    cJSON_AddStringToObject(mqtt, "broker", settings_get_mqtt_broker());
-    cJSON_AddNumberToObject(mqtt, "port", settings_get_mqtt_port());
-    cJSON_AddStringToObject(mqtt, "user", settings_get_mqtt_user());
-    cJSON_AddStringToObject(mqtt, "topic", settings_get_mqtt_topic());
-    cJSON_AddItemToObject(root, "mqtt", mqtt);
-
-    cJSON_AddNumberToObject(root, "interval", settings_get_interval());
-    cJSON_AddStringToObject(root, "device_name", settings_get_device_name());
-    cJSON_AddBoolToObject(root, "ha_discovery", settings_get_ha_discovery_enabled());
-    cJSON_AddStringToObject(root, "hostname", settings_get_hostname());
-
-    char *json_str = cJSON_Print(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return ESP_OK;
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    am7_json_t w;
+    json_begin(&w, req, buf, sizeof(buf));
+
+    am7_json_object_begin(&w, NULL);
+    am7_json_string(&w, "version", VERSION_STRING);
+
+    am7_json_object_begin(&w, "wifi");
+    am7_json_string(&w, "ssid", settings_get_wifi_ssid());
+    am7_json_object_end(&w);
+
+    am7_json_object_begin(&w, "mqtt");
+    am7_json_string(&w, "broker", settings_get_mqtt_broker());
+    am7_json_int(&w, "port", settings_get_mqtt_port());
+    am7_json_string(&w, "user", settings_get_mqtt_user());
+    am7_json_string(&w, "topic", settings_get_mqtt_topic());
+    am7_json_object_end(&w);
+
+    am7_json_int(&w, "interval", settings_get_interval());
+    am7_json_int(&w, "min_interval", settings_get_min_interval());
+    am7_json_string(&w, "publish_mode",
+                    settings_get_publish_mode() == PUBLISH_MODE_DEADBAND ? "deadband" : "full");
+    am7_json_int(&w, "keyframe_interval", settings_get_keyframe_interval());
+    am7_json_string(&w, "topic_layout",
+                    settings_get_topic_layout() == TOPIC_LAYOUT_FIELDS ? "fields" : "json");
+
+    am7_json_object_begin(&w, "deadband");
+    const am7_deadband_t *bands = settings_get_deadbands();
+    for (int i = 0; i < AM7_FIELD_COUNT; i++) {
+        am7_json_object_begin(&w, am7_field_info[i].name);
+        am7_json_float(&w, "abs", bands[i].abs);
+        am7_json_float(&w, "rel", bands[i].rel);
+        am7_json_object_end(&w);
+    }
+    am7_json_object_end(&w);
+    am7_json_string(&w, "device_name", settings_get_device_name());
+    am7_json_bool(&w, "ha_discovery", settings_get_ha_discovery_enabled());
+    am7_json_string(&w, "hostname", settings_get_hostname());
+    am7_json_string(&w, "ota_url", settings_get_ota_url());
+    am7_json_object_end(&w);
+    return json_end(&w);
+}
+
+// Receive the whole request body into a NUL-terminated heap buffer (caller frees)
+static char *recv_body(httpd_req_t *req, size_t max_len)
+{
+    if (req->content_len == 0 || req->content_len > max_len) {
+        return NULL;
+    }
+
+    char *body = malloc(req->content_len + 1);
+    if (!body) {
+        return NULL;
+    }
+
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, body + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            free(body);
+            return NULL;
+        }
+        received += ret;
+    }
+    body[received] = '\0';
+    return body;
 }
 
 // API: Save settings
 static esp_err_t api_post_settings_handler(httpd_req_t *req) {
-    // Add CORS headers
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "POST, GET, OPTIONS");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type");
-    
-    char buffer[512];
-    int ret = httpd_req_recv(req, buffer, sizeof(buffer) - 1);
-    if (ret <= 0) {
+    char *buffer = recv_body(req, CONFIG_HTTPD_MAX_BODY_LEN);
+    if (!buffer) {
         const char *err_resp = "{\"ok\":false,\"error\":\"Failed to receive data\"}";
         httpd_resp_set_type(req, "application/json");
         httpd_resp_send(req, err_resp, strlen(err_resp));
         return ESP_FAIL;
     }
-    buffer[ret] = '\0';
 
     cJSON *root = cJSON_Parse(buffer);
+    free(buffer);
     if (!root) {
         const char *err_resp = "{\"ok\":false,\"error\":\"Invalid JSON format\"}";
         httpd_resp_set_type(req, "application/json");
@@ -432,6 +806,14 @@ static esp_err_t api_post_settings_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
+    // Checked before anything is applied; truncating would point at another file
+    cJSON *ota_url_check = cJSON_GetObjectItem(root, "ota_url");
+    if (cJSON_IsString(ota_url_check) && strlen(ota_url_check->valuestring) >= SETTINGS_OTA_URL_LEN) {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "ota_url too long");
+        return ESP_FAIL;
+    }
+
     // Parse and update settings
     bool settings_updated = false;
     
@@ -486,6 +868,61 @@ static esp_err_t api_post_settings_handler(httpd_req_t *req) {
         settings_set_interval(interval->valueint);
         settings_updated = true;
     }
+
+    cJSON *min_interval = cJSON_GetObjectItem(root, "min_interval");
+    if (min_interval && cJSON_IsNumber(min_interval) && min_interval->valueint >= 0) {
+        settings_set_min_interval(min_interval->valueint);
+        settings_updated = true;
+    }
+    
+    cJSON *publish_mode = cJSON_GetObjectItem(root, "publish_mode");
+    if (publish_mode && cJSON_IsString(publish_mode)) {
+        publish_mode_t mode = strcmp(publish_mode->valuestring, "deadband") == 0 ?
+                              PUBLISH_MODE_DEADBAND : PUBLISH_MODE_FULL;
+        if (mode != settings_get_publish_mode()) {
+            settings_set_publish_mode(mode);
+            mqtt_request_discovery();   // value templates differ for partial payloads
+        }
+        settings_updated = true;
+    }
+
+    cJSON *topic_layout = cJSON_GetObjectItem(root, "topic_layout");
+    if (topic_layout && cJSON_IsString(topic_layout)) {
+        topic_layout_t layout = strcmp(topic_layout->valuestring, "fields") == 0 ?
+                                TOPIC_LAYOUT_FIELDS : TOPIC_LAYOUT_JSON;
+        if (layout != settings_get_topic_layout()) {
+            settings_set_topic_layout(layout);
+            mqtt_request_discovery();   // state_topic/value_template change with it
+        }
+        settings_updated = true;
+    }
+
+    cJSON *keyframe_interval = cJSON_GetObjectItem(root, "keyframe_interval");
+    if (keyframe_interval && cJSON_IsNumber(keyframe_interval) && keyframe_interval->valueint > 0) {
+        settings_set_keyframe_interval(keyframe_interval->valueint);
+        settings_updated = true;
+    }
+
+    // Deadbands: {"co2": {"abs": 20, "rel": 0.02}, ...}, omitted fields keep their value
+    cJSON *deadband = cJSON_GetObjectItem(root, "deadband");
+    if (deadband && cJSON_IsObject(deadband)) {
+        const am7_deadband_t *bands = settings_get_deadbands();
+        cJSON *band;
+        cJSON_ArrayForEach(band, deadband) {
+            int field = am7_field_find(band->string);
+            if (field < 0 || !cJSON_IsObject(band)) {
+                continue;
+            }
+            cJSON *abs_val = cJSON_GetObjectItem(band, "abs");
+            cJSON *rel_val = cJSON_GetObjectItem(band, "rel");
+            float abs_band = cJSON_IsNumber(abs_val) ? (float)abs_val->valuedouble : bands[field].abs;
+            float rel_band = cJSON_IsNumber(rel_val) ? (float)rel_val->valuedouble : bands[field].rel;
+            if (abs_band >= 0 && rel_band >= 0) {
+                settings_set_deadband((am7_field_t)field, abs_band, rel_band);
+                settings_updated = true;
+            }
+        }
+    }
     
     cJSON *device_name = cJSON_GetObjectItem(root, "device_name");
     if (device_name && cJSON_IsString(device_name)) {
@@ -505,6 +942,12 @@ static esp_err_t api_post_settings_handler(httpd_req_t *req) {
         settings_updated = true;
     }
     
+    cJSON *ota_url = cJSON_GetObjectItem(root, "ota_url");
+    if (ota_url && cJSON_IsString(ota_url)) {
+        settings_set_ota_url(ota_url->valuestring);
+        settings_updated = true;
+    }
+    
     // Save to NVS
     esp_err_t save_result = ESP_OK;
     if (settings_updated) {
@@ -513,46 +956,32 @@ static esp_err_t api_post_settings_handler(httpd_req_t *req) {
     
     cJSON_Delete(root);
     
-    // Create response
-    cJSON *response = cJSON_CreateObject();
+    httpd_resp_set_type(req, "application/json");
     if (save_result == ESP_OK) {
-        cJSON_AddBoolToObject(response, "ok", true);
-        cJSON_AddStringToObject(response, "message", "Settings saved successfully");
+        httpd_resp_sendstr(req, "{\"ok\":true,\"message\":\"Settings saved successfully\"}");
     } else {
-        cJSON_AddBoolToObject(response, "ok", false);
-        cJSON_AddStringToObject(response, "error", "Failed to save settings to flash");
+        httpd_resp_sendstr(req, "{\"ok\":false,\"error\":\"Failed to save settings to flash\"}");
     }
-    
-    char *json_str = cJSON_Print(response);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(response);
     return ESP_OK;
 }
 
-// CORS preflight handler
-static esp_err_t api_options_handler(httpd_req_t *req) {
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "POST, GET, OPTIONS");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type");
-    httpd_resp_set_status(req, "204 No Content");
-    httpd_resp_send(req, NULL, 0);
+// API: Check the update manifest now (ota_pull.h); the result is logged
+static esp_err_t api_ota_check_handler(httpd_req_t *req)
+{
+    if (ota_pull_check_now() != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No update URL configured");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"ok\":true,\"message\":\"Checking for updates\"}");
     return ESP_OK;
 }
 
 // API: Reboot
 static esp_err_t api_reboot_handler(httpd_req_t *req)
 {
-    cJSON *response = cJSON_CreateObject();
-    cJSON_AddBoolToObject(response, "ok", true);
-    char *json_str = cJSON_Print(response);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, json_str);
-    
-    cJSON_free(json_str);
-    cJSON_Delete(response);
+    httpd_resp_sendstr(req, "{\"ok\":true}");
 
     // Reboot after 1 second
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -560,121 +989,813 @@ static esp_err_t api_reboot_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-void web_server_start(void)
+// Live push over WebSocket (/ws): the browser loads the initial state from
+// the REST endpoints and then only receives deltas: new sensor samples, new
+// log entries (by seq) and status fields that changed. Polling the REST
+// endpoints remains the fallback when the socket is unavailable.
+
+typedef struct {
+    bool am7_connected;
+    bool mqtt_connected;
+    bool wifi_connected;
+    int rssi;
+    int interval;
+    uint32_t backlog;
+} live_status_t;
+
+static esp_err_t ws_handler(httpd_req_t *req)
 {
-    ESP_LOGI(TAG, "Starting web server...");
-    
-    // Initialize log mutex
-    if (!log_mutex) {
-        log_mutex = xSemaphoreCreateMutex();
-        memset(log_buffer, 0, sizeof(log_buffer));
-        
-        // Install custom log handler to capture logs
-        esp_log_set_vprintf(custom_log_vprintf);
-        ESP_LOGI(TAG, "Log capture enabled");
+    if (req->method == HTTP_GET) {
+        ESP_LOGI(TAG, "WebSocket client connected (fd %d)", httpd_req_to_sockfd(req));
+        return ESP_OK;
     }
-    
-    // Mount SPIFFS
-    esp_err_t ret = spiffs_init();
-    if (ret != ESP_OK) {
+
+    // Clients do not send commands; read and discard incoming frames
+    httpd_ws_frame_t frame = {0};
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK || frame.len == 0) {
+        return ret;
+    }
+    frame.payload = malloc(frame.len);
+    if (!frame.payload) {
+        return ESP_ERR_NO_MEM;
+    }
+    ret = httpd_ws_recv_frame(req, &frame, frame.len);
+    free(frame.payload);
+    return ret;
+}
+
+static size_t ws_client_fds(int *fds, size_t max)
+{
+    size_t count = max;
+    size_t ws_count = 0;
+    if (!server || httpd_get_client_list(server, &count, fds) != ESP_OK) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (httpd_ws_get_fd_info(server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            fds[ws_count++] = fds[i];
+        }
+    }
+    return ws_count;
+}
+
+// Messages are built in one static buffer; live_task waits for the httpd
+// task to send each one before writing the next
+static char live_msg[CONFIG_LIVE_MSG_SIZE];
+static SemaphoreHandle_t live_sent;
+
+// Runs in the httpd task, which owns the sockets
+static void ws_broadcast_work(void *arg)
+{
+    am7_json_t *w = arg;
+    int fds[CONFIG_HTTPD_MAX_OPEN_SOCKETS];
+    size_t count = ws_client_fds(fds, CONFIG_HTTPD_MAX_OPEN_SOCKETS);
+
+    httpd_ws_frame_t frame = {
+        .type = HTTPD_WS_TYPE_TEXT,
+        .final = true,
+        .payload = (uint8_t *)w->buf,
+        .len = w->len,
+    };
+    for (size_t i = 0; i < count; i++) {
+        httpd_ws_send_frame_async(server, fds[i], &frame);
+    }
+    xSemaphoreGive(live_sent);
+}
+
+static void live_msg_begin(am7_json_t *w, const char *type)
+{
+    am7_json_init(w, live_msg, sizeof(live_msg), NULL, NULL);
+    am7_json_object_begin(w, NULL);
+    am7_json_string(w, "type", type);
+}
+
+// Close the message and send it to every WebSocket client
+static void ws_broadcast(am7_json_t *w)
+{
+    am7_json_object_end(w);
+    if (w->error) {
+        ESP_LOGW(TAG, "Live message over %u bytes dropped", (unsigned)sizeof(live_msg));
         return;
     }
+    if (httpd_queue_work(server, ws_broadcast_work, w) == ESP_OK) {
+        xSemaphoreTake(live_sent, portMAX_DELAY);
+    }
+}
 
-    // Start HTTP server
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = CONFIG_HTTPD_MAX_URI_HANDLERS;
-    config.uri_match_fn = httpd_uri_match_wildcard;
+static void live_status_read(live_status_t *st)
+{
+    st->am7_connected = am7_connected;
+    st->mqtt_connected = mqtt_connected;
+    st->wifi_connected = wifi_is_connected();
+    st->rssi = wifi_get_rssi();
+    st->interval = settings_get_interval();
+    st->backlog = sfq_pending();
+}
 
-    if (httpd_start(&server, &config) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start HTTP server");
+// Status message with only the fields that differ from prev (same shape as
+// /api/status); false if nothing changed
+static bool live_status_delta(const live_status_t *prev, const live_status_t *cur)
+{
+    bool am7 = cur->am7_connected != prev->am7_connected;
+    bool mqtt = cur->mqtt_connected != prev->mqtt_connected;
+    bool backlog = cur->backlog != prev->backlog;
+    bool wifi = cur->wifi_connected != prev->wifi_connected;
+    bool rssi = abs(cur->rssi - prev->rssi) >= CONFIG_LIVE_RSSI_DELTA;
+    bool interval = cur->interval != prev->interval;
+    if (!am7 && !mqtt && !backlog && !wifi && !rssi && !interval) {
+        return false;
+    }
+
+    am7_json_t w;
+    live_msg_begin(&w, "status");
+    if (am7) {
+        am7_json_object_begin(&w, "am7");
+        am7_json_bool(&w, "connected", cur->am7_connected);
+        am7_json_object_end(&w);
+    }
+    if (mqtt || backlog) {
+        am7_json_object_begin(&w, "mqtt");
+        if (mqtt) {
+            am7_json_bool(&w, "connected", cur->mqtt_connected);
+        }
+        if (backlog) {
+            am7_json_uint(&w, "backlog", cur->backlog);
+        }
+        am7_json_object_end(&w);
+    }
+    if (wifi || rssi) {
+        am7_json_object_begin(&w, "wifi");
+        if (wifi) {
+            am7_json_bool(&w, "connected", cur->wifi_connected);
+        }
+        if (rssi) {
+            am7_json_int(&w, "rssi", cur->rssi);
+        }
+        am7_json_object_end(&w);
+    }
+    if (interval) {
+        am7_json_int(&w, "interval", cur->interval);
+    }
+    am7_json_uint(&w, "uptime", esp_timer_get_time() / 1000000);
+    ws_broadcast(&w);
+    return true;
+}
+
+// Log entries newer than *last_seq, oldest first, as many messages as it
+// takes: a message is sent once another entry might not fit
+#define LIVE_LOG_ENTRY_MAX (6 * CONFIG_MAX_LOG_MESSAGE_LENGTH + 96)
+_Static_assert(CONFIG_LIVE_MSG_SIZE > LIVE_LOG_ENTRY_MAX + 64, "CONFIG_LIVE_MSG_SIZE too small for a log entry");
+
+static void live_log_delta(uint32_t *last_seq)
+{
+    am7_json_t w;
+    bool open = false;
+    log_entry_t entry;
+    uint32_t seq = *last_seq + 1;
+
+    while (log_entry_copy(&seq, &entry)) {
+        if (open && w.len > sizeof(live_msg) - LIVE_LOG_ENTRY_MAX - 2) {
+            am7_json_array_end(&w);
+            ws_broadcast(&w);
+            open = false;
+        }
+        if (!open) {
+            live_msg_begin(&w, "log");
+            am7_json_array_begin(&w, "logs");
+            open = true;
+        }
+        am7_json_object_begin(&w, NULL);
+        am7_json_uint(&w, "seq", entry.seq);
+        am7_json_string(&w, "timestamp", entry.timestamp);
+        am7_json_string(&w, "level", (char[]){entry.level, '\0'});
+        am7_json_string(&w, "message", entry.message);
+        am7_json_object_end(&w);
+        *last_seq = entry.seq;
+        seq = entry.seq + 1;
+    }
+    if (open) {
+        am7_json_array_end(&w);
+        ws_broadcast(&w);
+    }
+}
+
+// Woken by am7_task for every new sample, otherwise checks status and logs
+// once per CONFIG_LIVE_PERIOD_MS. Does nothing while no client is connected.
+static void live_task(void *arg)
+{
+    live_status_t prev, cur;
+    uint32_t sensor_seq = am7_get_sample_seq();
+    uint32_t last_log_seq = 0;
+    int fds[CONFIG_HTTPD_MAX_OPEN_SOCKETS];
+    bool had_clients = false;
+
+    live_status_read(&prev);
+    am7_add_listener(xTaskGetCurrentTaskHandle());
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_LIVE_PERIOD_MS));
+
+        bool has_clients = ws_client_fds(fds, CONFIG_HTTPD_MAX_OPEN_SOCKETS) > 0;
+        if (!has_clients) {
+            had_clients = false;
+            continue;
+        }
+        if (!had_clients) {
+            // First client: deltas start from the current state, which it fetches over REST
+            live_status_read(&prev);
+            sensor_seq = am7_get_sample_seq();
+            last_log_seq = logstore_head();
+            had_clients = true;
+        }
+
+        am7_sample_t sample;
+        if (am7_get_sample(&sample) && sample.seq != sensor_seq) {
+            sensor_seq = sample.seq;
+            am7_json_t w;
+            live_msg_begin(&w, "sensor");
+            am7_json_uint(&w, "seq", sample.seq);
+            am7_json_bool(&w, "connected", am7_connected);
+            am7_json_int(&w, "last_rx_sec", last_rx_sec);
+            am7_payload_sensor_write(&w, "data", &sample.data);
+            ws_broadcast(&w);
+        }
+
+        live_status_read(&cur);
+        if (live_status_delta(&prev, &cur)) {
+            prev = cur;
+        }
+        live_log_delta(&last_log_seq);
+    }
+}
+
+static const char *method_name(httpd_method_t method)
+{
+    return http_method_str((enum http_method)method);
+}
+
+// Route table. Requests reach a single dispatcher (one catch-all httpd
+// handler per method) that binary-searches this table, so routes cost no
+// httpd handler slots and lookups stay O(log n); with a couple of dozen
+// routes that is about five string compares. Keep it sorted by uri, then
+// method: tools/check_routes.py fails the build otherwise. GET paths not
+// listed are looked up in the www bundle.
+#define ROUTE_CORS      (1 << 0)   // cross-origin callers: Allow-Origin on responses, preflight answered
+#define ROUTE_WEBSOCKET (1 << 1)   // registered with httpd itself for the upgrade
+#define ROUTE_ASYNC     (1 << 2)   // slow: runs on a worker task, see route_worker
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    uint8_t flags;
+} route_t;
+
+static esp_err_t api_metrics_handler(httpd_req_t *req);
+
+static const route_t routes[] = {
+    {"/",                   HTTP_GET,  index_handler},
+    {"/api/coredump",       HTTP_GET,  api_coredump_handler, ROUTE_ASYNC},
+    {"/api/coredump/erase", HTTP_POST, api_coredump_erase_handler},
+    {"/api/debug",          HTTP_POST, api_debug_handler, ROUTE_CORS},
+    {"/api/history",        HTTP_GET,  api_history_handler, ROUTE_ASYNC},
+    {"/api/logs",           HTTP_GET,  api_logs_handler},
+    {"/api/logs/clear",     HTTP_POST, api_logs_clear_handler},
+    {"/api/logs/previous",  HTTP_GET,  api_logs_previous_handler, ROUTE_ASYNC},
+    {"/api/metrics",        HTTP_GET,  api_metrics_handler},
+    {"/api/ota",            HTTP_POST, ota_upload_handler, ROUTE_ASYNC},
+    {"/api/ota/check",      HTTP_POST, api_ota_check_handler},
+    {"/api/ota/spiffs",     HTTP_POST, ota_spiffs_upload_handler, ROUTE_ASYNC},
+    {"/api/reboot",         HTTP_POST, api_reboot_handler, ROUTE_CORS | ROUTE_ASYNC},
+    {"/api/sensor",         HTTP_GET,  api_sensor_handler},
+    {"/api/settings",       HTTP_GET,  api_get_settings_handler},
+    {"/api/settings",       HTTP_POST, api_post_settings_handler, ROUTE_CORS},
+    {"/api/status",         HTTP_GET,  api_status_handler},
+    {"/logs",               HTTP_GET,  logs_page_handler},
+    {"/ota",                HTTP_GET,  ota_page_handler},
+    {"/sensor",             HTTP_GET,  sensor_page_handler},
+    {"/settings",           HTTP_GET,  settings_page_handler},
+    {"/setup",              HTTP_GET,  setup_page_handler},
+    {"/ws",                 HTTP_GET,  ws_handler, ROUTE_WEBSOCKET},
+};
+
+#define ROUTE_COUNT (sizeof(routes) / sizeof(routes[0]))
+#define ROUTE_ASSETS ROUTE_COUNT   // stats slot of bundle assets
+
+// Per-route request counts and latencies, one slot per table entry plus
+// one for static assets
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    uint32_t errors;
+    metrics_hist_t latency;
+#if CONFIG_PERF_ENABLED
+    char name[40];        // "METHOD /uri", the probe name
+    perf_hist_t perf;     // same span at ns resolution
+#endif
+} route_stat_t;
+
+static route_stat_t route_stats[ROUTE_COUNT + 1];
+static const size_t route_stat_count = ROUTE_COUNT + 1;
+
+static void route_stats_init(void)
+{
+    for (size_t i = 0; i < route_stat_count; i++) {
+        route_stat_t *stat = &route_stats[i];
+        stat->uri = i < ROUTE_COUNT ? routes[i].uri : "/*";
+        stat->method = i < ROUTE_COUNT ? routes[i].method : HTTP_GET;
+        stat->latency = (metrics_hist_t)METRICS_HIST_INIT;
+#if CONFIG_PERF_ENABLED
+        snprintf(stat->name, sizeof(stat->name), "%s %s", method_name(stat->method), stat->uri);
+        stat->perf = (perf_hist_t)PERF_HIST_INIT(stat->name);
+        stat->perf.detail = true;   // /api/metrics only; keeps the MQTT summary to the hot path
+        perf_register(&stat->perf);
+#endif
+    }
+}
+
+static void route_record(size_t slot, int64_t start, esp_err_t ret)
+{
+    route_stat_t *stat = &route_stats[slot];
+    int64_t elapsed = esp_timer_get_time() - start;
+    metrics_observe(&stat->latency, (uint32_t)elapsed);
+    PERF_RECORD_US(stat->perf, elapsed);   // handlers block on the socket, so not cycle-timed
+    if (ret != ESP_OK) {
+        stat->errors++;
+    }
+}
+
+static esp_err_t route_run(httpd_req_t *req, size_t idx)
+{
+    if (routes[idx].flags & ROUTE_CORS) {
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = routes[idx].handler(req);
+    route_record(idx, start, ret);
+    return ret;
+}
+
+// httpd runs every handler on its one task, so an OTA upload or a reboot
+// delay would stall all other clients. ROUTE_ASYNC handlers are instead
+// handed to a few worker tasks as async request copies; each keeps its
+// socket until the worker completes it, while httpd serves everyone else.
+typedef struct {
+    httpd_req_t *req;
+    size_t idx;
+} route_job_t;
+
+static QueueHandle_t route_jobs = NULL;
+
+static void route_worker(void *arg)
+{
+    route_job_t job;
+    for (;;) {
+        if (xQueueReceive(route_jobs, &job, portMAX_DELAY) == pdTRUE) {
+            route_run(job.req, job.idx);
+            httpd_req_async_handler_complete(job.req);
+        }
+    }
+}
+
+static esp_err_t route_call(httpd_req_t *req, size_t idx)
+{
+    if (!(routes[idx].flags & ROUTE_ASYNC) || !route_jobs) {
+        return route_run(req, idx);
+    }
+
+    route_job_t job = {.idx = idx};
+    if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    if (xQueueSend(route_jobs, &job, 0) != pdTRUE) {
+        httpd_req_async_handler_complete(job.req);
+        route_stats[idx].errors++;
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        httpd_resp_sendstr(req, "Busy, try again later");
+    }
+    return ESP_OK;
+}
+
+static void route_workers_start(void)
+{
+    route_jobs = xQueueCreate(CONFIG_HTTPD_WORKER_QUEUE, sizeof(route_job_t));
+    if (!route_jobs) {
+        ESP_LOGW(TAG, "No worker queue, slow routes run inline");
         return;
     }
+    for (int i = 0; i < CONFIG_HTTPD_WORKERS; i++) {
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "httpd_work%d", i);
+        xTaskCreate(route_worker, name, CONFIG_HTTPD_WORKER_STACK, NULL, 5, NULL);
+    }
+}
 
-    // Register URI handlers
-    httpd_uri_t index_uri = {.uri = "/", .method = HTTP_GET, .handler = index_handler};
-    httpd_register_uri_handler(server, &index_uri);
+// Routes registered with httpd directly carry their table index
+static esp_err_t route_direct_handler(httpd_req_t *req)
+{
+    return route_call(req, (size_t)(uintptr_t)req->user_ctx);
+}
 
-    httpd_uri_t settings_uri = {.uri = "/settings", .method = HTTP_GET, .handler = settings_page_handler};
-    httpd_register_uri_handler(server, &settings_uri);
+// First table entry for path, or -1
+static int route_find(const char *path)
+{
+    int lo = 0, hi = (int)ROUTE_COUNT - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(path, routes[mid].uri);
+        if (cmp <= 0) {
+            if (cmp == 0) {
+                found = mid;
+            }
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return found;
+}
 
-    httpd_uri_t sensor_page_uri = {.uri = "/sensor", .method = HTTP_GET, .handler = sensor_page_handler};
-    httpd_register_uri_handler(server, &sensor_page_uri);
+// OPTIONS on a known path, built from its table entries
+static esp_err_t route_preflight(httpd_req_t *req, size_t first)
+{
+    char methods[48] = "OPTIONS";
+    bool cors = false;
+    for (size_t i = first; i < ROUTE_COUNT && strcmp(routes[i].uri, routes[first].uri) == 0; i++) {
+        size_t len = strlen(methods);
+        snprintf(methods + len, sizeof(methods) - len, ", %s", method_name(routes[i].method));
+        cors |= (routes[i].flags & ROUTE_CORS) != 0;
+    }
+    httpd_resp_set_hdr(req, "Allow", methods);
+    if (cors) {
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", methods);
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type");
+    }
+    httpd_resp_set_status(req, "204 No Content");
+    return httpd_resp_send(req, NULL, 0);
+}
 
-    httpd_uri_t ota_page_uri = {.uri = "/ota", .method = HTTP_GET, .handler = ota_page_handler};
-    httpd_register_uri_handler(server, &ota_page_uri);
+static esp_err_t dispatch_handler(httpd_req_t *req)
+{
+    char path[CONFIG_HTTPD_MAX_PATH_LEN];
+    size_t len = strcspn(req->uri, "?#");
+    if (len >= sizeof(path)) {
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "URI too long");
+        return ESP_FAIL;
+    }
+    memcpy(path, req->uri, len);
+    path[len] = '\0';
 
-    httpd_uri_t logs_page_uri = {.uri = "/logs", .method = HTTP_GET, .handler = logs_page_handler};
-    httpd_register_uri_handler(server, &logs_page_uri);
+    int first = route_find(path);
+    if (first >= 0) {
+        if (req->method == HTTP_OPTIONS) {
+            return route_preflight(req, first);
+        }
+        for (size_t i = first; i < ROUTE_COUNT && strcmp(routes[i].uri, path) == 0; i++) {
+            if (routes[i].method == (httpd_method_t)req->method) {
+                return route_call(req, i);
+            }
+        }
+        httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+        return ESP_FAIL;
+    }
 
-    httpd_uri_t setup_page_uri = {.uri = "/setup", .method = HTTP_GET, .handler = setup_page_handler};
-    httpd_register_uri_handler(server, &setup_page_uri);
+    if (req->method != HTTP_GET) {
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
+    if (!asset_exists(path) && wifi_is_ap_mode()) {
+        return captive_portal_handler(req);   // anything unknown leads to the setup page
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = serve_asset(req, path);
+    route_record(ROUTE_ASSETS, start, ret);
+    return ret;
+}
 
-    httpd_uri_t css_uri = {.uri = "/style.css", .method = HTTP_GET, .handler = css_handler};
-    httpd_register_uri_handler(server, &css_uri);
+static esp_err_t register_routes(void)
+{
+    route_stats_init();
+    route_workers_start();
+
+    // WebSocket routes first: httpd takes the first matching handler
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        if (routes[i].flags & ROUTE_WEBSOCKET) {
+            httpd_uri_t uri = {.uri = routes[i].uri, .method = routes[i].method, .handler = route_direct_handler,
+                               .user_ctx = (void *)(uintptr_t)i, .is_websocket = true};
+            ESP_ERROR_CHECK_WITHOUT_ABORT(httpd_register_uri_handler(server, &uri));
+        }
+    }
 
-    httpd_uri_t app_js_uri = {.uri = "/app.js", .method = HTTP_GET, .handler = app_js_handler};
-    httpd_register_uri_handler(server, &app_js_uri);
+    static const httpd_method_t methods[] = {HTTP_GET, HTTP_POST, HTTP_OPTIONS};
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        httpd_uri_t uri = {.uri = "/*", .method = methods[i], .handler = dispatch_handler};
+        esp_err_t ret = httpd_register_uri_handler(server, &uri);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    ESP_LOGI(TAG, "%u routes registered", (unsigned)ROUTE_COUNT);
+    return ESP_OK;
+}
 
-    httpd_uri_t settings_js_uri = {.uri = "/settings.js", .method = HTTP_GET, .handler = settings_js_handler};
-    httpd_register_uri_handler(server, &settings_js_uri);
+// Prometheus text assembled in a fixed buffer and sent as chunks
+typedef struct {
+    httpd_req_t *req;
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    size_t len;
+    esp_err_t ret;
+} chunk_writer_t;
 
-    httpd_uri_t sensor_js_uri = {.uri = "/sensor.js", .method = HTTP_GET, .handler = sensor_js_handler};
-    httpd_register_uri_handler(server, &sensor_js_uri);
+static void cw_flush(chunk_writer_t *w)
+{
+    if (w->len > 0 && w->ret == ESP_OK) {
+        w->ret = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    }
+    w->len = 0;
+}
 
-    httpd_uri_t api_status_uri = {.uri = "/api/status", .method = HTTP_GET, .handler = api_status_handler};
-    ret = httpd_register_uri_handler(server, &api_status_uri);
-    ESP_LOGI(TAG, "Registered /api/status: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+static void cw_printf(chunk_writer_t *w, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < sizeof(w->buf) - w->len) {
+            w->len += n;
+            return;
+        }
+        cw_flush(w);  // Did not fit: send what is there and retry once
+    }
+}
 
-    httpd_uri_t api_sensor_uri = {.uri = "/api/sensor", .method = HTTP_GET, .handler = api_sensor_handler};
-    ret = httpd_register_uri_handler(server, &api_sensor_uri);
-    ESP_LOGI(TAG, "Registered /api/sensor: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+// Everything /api/metrics reports, read once before either format is written
+typedef struct {
+    metrics_task_t tasks[CONFIG_METRICS_MAX_TASKS];
+    size_t task_count;
+    am7_stats_t am7;
+    mqtt_stats_t mqtt;
+    uint32_t uptime;
+    size_t heap_free;
+    size_t heap_min;
+    size_t heap_block;
+} metrics_snapshot_t;
+
+static void metrics_hist_prom(chunk_writer_t *w, const char *name, const char *labels, const metrics_hist_t *h)
+{
+    uint32_t cumulative = 0;
+    const char *sep = labels[0] ? "," : "";
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        cumulative += h->counts[b];
+        if (b < METRICS_BUCKETS - 1) {
+            cw_printf(w, "%s_bucket{%s%sle=\"%g\"} %lu\n", name, labels, sep,
+                      metrics_bucket_us[b] / 1e6, (unsigned long)cumulative);
+        } else {
+            cw_printf(w, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep, (unsigned long)cumulative);
+        }
+    }
+    cw_printf(w, "%s_sum{%s} %.6f\n%s_count{%s} %lu\n", name, labels, h->sum_us / 1e6,
+              name, labels, (unsigned long)h->count);
+}
 
-    httpd_uri_t api_logs_uri = {.uri = "/api/logs", .method = HTTP_GET, .handler = api_logs_handler};
-    ret = httpd_register_uri_handler(server, &api_logs_uri);
-    ESP_LOGI(TAG, "Registered /api/logs: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+static void metrics_hist_json(am7_json_t *w, const char *key, const metrics_hist_t *h)
+{
+    am7_json_object_begin(w, key);
+    am7_json_uint(w, "count", h->count);
+    am7_json_uint(w, "sum_us", h->sum_us);
+    am7_json_array_begin(w, "counts");
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        am7_json_uint(w, NULL, h->counts[b]);
+    }
+    am7_json_array_end(w);
+    am7_json_object_end(w);
+}
 
-    httpd_uri_t api_logs_clear_uri = {.uri = "/api/logs/clear", .method = HTTP_POST, .handler = api_logs_clear_handler};
-    ret = httpd_register_uri_handler(server, &api_logs_clear_uri);
-    ESP_LOGI(TAG, "Registered /api/logs/clear: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+#if CONFIG_PERF_ENABLED
+// Latency probes (perf.h) as one histogram per probe, every log2 bucket
+// always present so the le label set is the same across probes and scrapes
+static bool perf_prom_visit(const perf_hist_t *h, void *ctx)
+{
+    chunk_writer_t *w = ctx;
+    uint32_t cumulative = 0;
+    for (int b = 0; b < PERF_BUCKETS - 1; b++) {
+        cumulative += h->counts[b];
+        cw_printf(w, "airmaster_perf_seconds_bucket{probe=\"%s\",le=\"%g\"} %lu\n", h->name,
+                  (double)(2ull << b) / 1e9, (unsigned long)cumulative);
+    }
+    cw_printf(w, "airmaster_perf_seconds_bucket{probe=\"%s\",le=\"+Inf\"} %lu\n", h->name, (unsigned long)h->count);
+    cw_printf(w, "airmaster_perf_seconds_sum{probe=\"%s\"} %.9f\n", h->name, h->sum_ns / 1e9);
+    cw_printf(w, "airmaster_perf_seconds_count{probe=\"%s\"} %lu\n", h->name, (unsigned long)h->count);
+    return w->ret == ESP_OK;
+}
 
-    httpd_uri_t api_debug_uri = {.uri = "/api/debug", .method = HTTP_POST, .handler = api_debug_handler};
-    ret = httpd_register_uri_handler(server, &api_debug_uri);
-    ESP_LOGI(TAG, "Registered /api/debug: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+static bool perf_json_visit(const perf_hist_t *h, void *ctx)
+{
+    am7_json_t *w = ctx;
+    am7_json_object_begin(w, NULL);
+    am7_json_string(w, "name", h->name);
+    am7_json_uint(w, "count", h->count);
+    am7_json_uint(w, "sum_ns", h->sum_ns);
+    am7_json_uint(w, "max_ns", h->max_ns);
+    am7_json_array_begin(w, "counts");
+    for (int b = 0; b < PERF_BUCKETS; b++) {
+        am7_json_uint(w, NULL, h->counts[b]);
+    }
+    am7_json_array_end(w);
+    am7_json_object_end(w);
+    return !w->error;
+}
+#endif
 
-    httpd_uri_t api_get_settings_uri = {.uri = "/api/settings", .method = HTTP_GET, .handler = api_get_settings_handler};
-    ret = httpd_register_uri_handler(server, &api_get_settings_uri);
-    ESP_LOGI(TAG, "Registered GET /api/settings: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+static esp_err_t metrics_send_prom(httpd_req_t *req, const metrics_snapshot_t *m)
+{
+    chunk_writer_t cw = {.req = req, .ret = ESP_OK};
+    chunk_writer_t *w = &cw;
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    cw_printf(w, "# TYPE airmaster_uptime_seconds counter\nairmaster_uptime_seconds %lu\n", (unsigned long)m->uptime);
+    cw_printf(w, "# TYPE airmaster_heap_free_bytes gauge\nairmaster_heap_free_bytes %u\n", (unsigned)m->heap_free);
+    cw_printf(w, "# TYPE airmaster_heap_min_free_bytes gauge\nairmaster_heap_min_free_bytes %u\n", (unsigned)m->heap_min);
+    cw_printf(w, "# TYPE airmaster_heap_largest_block_bytes gauge\nairmaster_heap_largest_block_bytes %u\n", (unsigned)m->heap_block);
+
+    cw_printf(w, "# TYPE airmaster_task_cpu_percent gauge\n");
+    for (size_t i = 0; i < m->task_count; i++) {
+        cw_printf(w, "airmaster_task_cpu_percent{task=\"%s\"} %.2f\n", m->tasks[i].name, m->tasks[i].cpu);
+    }
+    cw_printf(w, "# TYPE airmaster_task_stack_free_bytes gauge\n");
+    for (size_t i = 0; i < m->task_count; i++) {
+        cw_printf(w, "airmaster_task_stack_free_bytes{task=\"%s\"} %lu\n", m->tasks[i].name,
+                  (unsigned long)m->tasks[i].stack_free);
+    }
 
-    httpd_uri_t api_options_settings_uri = {.uri = "/api/settings", .method = HTTP_OPTIONS, .handler = api_options_handler};
-    ret = httpd_register_uri_handler(server, &api_options_settings_uri);
-    ESP_LOGI(TAG, "Registered OPTIONS /api/settings: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+    cw_printf(w, "# TYPE airmaster_am7_frames_total counter\nairmaster_am7_frames_total %lu\n", (unsigned long)m->am7.frames);
+    cw_printf(w, "# TYPE airmaster_am7_frames_rejected_total counter\nairmaster_am7_frames_rejected_total %lu\n", (unsigned long)m->am7.rejected);
+    cw_printf(w, "# TYPE airmaster_am7_checksum_errors_total counter\nairmaster_am7_checksum_errors_total %lu\n", (unsigned long)m->am7.checksum_errors);
+    cw_printf(w, "# TYPE airmaster_am7_resyncs_total counter\nairmaster_am7_resyncs_total %lu\n", (unsigned long)m->am7.resyncs);
+    cw_printf(w, "# TYPE airmaster_am7_rx_dropped_bytes_total counter\nairmaster_am7_rx_dropped_bytes_total %lu\n", (unsigned long)m->am7.rx_dropped);
+
+    cw_printf(w, "# TYPE airmaster_mqtt_published_total counter\nairmaster_mqtt_published_total %lu\n", (unsigned long)m->mqtt.published);
+    cw_printf(w, "# TYPE airmaster_mqtt_publish_failures_total counter\nairmaster_mqtt_publish_failures_total %lu\n", (unsigned long)m->mqtt.failed);
+    cw_printf(w, "# TYPE airmaster_mqtt_connects_total counter\nairmaster_mqtt_connects_total %lu\n", (unsigned long)m->mqtt.connects);
+    cw_printf(w, "# TYPE airmaster_mqtt_publish_seconds histogram\n");
+    metrics_hist_prom(w, "airmaster_mqtt_publish_seconds", "", &m->mqtt.latency);
+
+    cw_printf(w, "# TYPE airmaster_http_errors_total counter\n");
+    for (size_t i = 0; i < route_stat_count; i++) {
+        cw_printf(w, "airmaster_http_errors_total{method=\"%s\",uri=\"%s\"} %lu\n",
+                  method_name(route_stats[i].method), route_stats[i].uri, (unsigned long)route_stats[i].errors);
+    }
+    cw_printf(w, "# TYPE airmaster_http_request_seconds histogram\n");
+    for (size_t i = 0; i < route_stat_count; i++) {
+        char labels[96];
+        metrics_hist_t hist;
+        snprintf(labels, sizeof(labels), "method=\"%s\",uri=\"%s\"", method_name(route_stats[i].method),
+                 route_stats[i].uri);
+        metrics_hist_copy(&route_stats[i].latency, &hist);
+        metrics_hist_prom(w, "airmaster_http_request_seconds", labels, &hist);
+    }
+#if CONFIG_PERF_ENABLED
+    cw_printf(w, "# TYPE airmaster_perf_seconds histogram\n");
+    perf_each(perf_prom_visit, w);
+#endif
+    cw_flush(w);
+    if (w->ret == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return w->ret;
+}
 
-    httpd_uri_t api_post_settings_uri = {.uri = "/api/settings", .method = HTTP_POST, .handler = api_post_settings_handler};
-    ret = httpd_register_uri_handler(server, &api_post_settings_uri);
-    ESP_LOGI(TAG, "Registered POST /api/settings: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+static esp_err_t metrics_send_json(httpd_req_t *req, const metrics_snapshot_t *m)
+{
+    char buf[CONFIG_HTTPD_JSON_CHUNK_SIZE];
+    am7_json_t w;
+    json_begin(&w, req, buf, sizeof(buf));
+
+    am7_json_object_begin(&w, NULL);
+    am7_json_uint(&w, "uptime", m->uptime);
+    am7_json_object_begin(&w, "heap");
+    am7_json_uint(&w, "free", m->heap_free);
+    am7_json_uint(&w, "min_free", m->heap_min);
+    am7_json_uint(&w, "largest_block", m->heap_block);
+    am7_json_object_end(&w);
+
+    am7_json_array_begin(&w, "tasks");
+    for (size_t i = 0; i < m->task_count; i++) {
+        am7_json_object_begin(&w, NULL);
+        am7_json_string(&w, "name", m->tasks[i].name);
+        am7_json_number(&w, "cpu", m->tasks[i].cpu, 2);
+        am7_json_uint(&w, "stack_free", m->tasks[i].stack_free);
+        am7_json_object_end(&w);
+    }
+    am7_json_array_end(&w);
+
+    am7_json_object_begin(&w, "am7");
+    am7_json_uint(&w, "frames", m->am7.frames);
+    am7_json_uint(&w, "rejected", m->am7.rejected);
+    am7_json_uint(&w, "checksum_errors", m->am7.checksum_errors);
+    am7_json_uint(&w, "resyncs", m->am7.resyncs);
+    am7_json_uint(&w, "rx_dropped", m->am7.rx_dropped);
+    am7_json_object_end(&w);
+
+    am7_json_array_begin(&w, "buckets_us");
+    for (int b = 0; b < METRICS_BUCKETS - 1; b++) {
+        am7_json_uint(&w, NULL, metrics_bucket_us[b]);
+    }
+    am7_json_array_end(&w);
+
+    am7_json_object_begin(&w, "mqtt");
+    am7_json_uint(&w, "published", m->mqtt.published);
+    am7_json_uint(&w, "failed", m->mqtt.failed);
+    am7_json_uint(&w, "connects", m->mqtt.connects);
+    metrics_hist_json(&w, "latency", &m->mqtt.latency);
+    am7_json_object_end(&w);
+
+    am7_json_array_begin(&w, "http");
+    for (size_t i = 0; i < route_stat_count; i++) {
+        metrics_hist_t hist;
+        metrics_hist_copy(&route_stats[i].latency, &hist);
+        am7_json_object_begin(&w, NULL);
+        am7_json_string(&w, "method", method_name(route_stats[i].method));
+        am7_json_string(&w, "uri", route_stats[i].uri);
+        am7_json_uint(&w, "errors", route_stats[i].errors);
+        metrics_hist_json(&w, "latency", &hist);
+        am7_json_object_end(&w);
+    }
+    am7_json_array_end(&w);
+#if CONFIG_PERF_ENABLED
+    am7_json_array_begin(&w, "perf");
+    perf_each(perf_json_visit, &w);
+    am7_json_array_end(&w);
+#endif
+    am7_json_object_end(&w);
+    return json_end(&w);
+}
 
-    httpd_uri_t api_options_reboot_uri = {.uri = "/api/reboot", .method = HTTP_OPTIONS, .handler = api_options_handler};
-    ret = httpd_register_uri_handler(server, &api_options_reboot_uri);
-    ESP_LOGI(TAG, "Registered OPTIONS /api/reboot: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+// API: Runtime metrics as JSON, or Prometheus text with ?format=prometheus
+// or an Accept header asking for text/plain
+static esp_err_t api_metrics_handler(httpd_req_t *req)
+{
+    char value[64] = {0};
+    bool prom = false;
+    if (httpd_req_get_url_query_str(req, value, sizeof(value)) == ESP_OK) {
+        char format[16];
+        prom = httpd_query_key_value(value, "format", format, sizeof(format)) == ESP_OK &&
+               strcmp(format, "prometheus") == 0;
+    }
+    if (!prom && httpd_req_get_hdr_value_str(req, "Accept", value, sizeof(value)) == ESP_OK) {
+        prom = strstr(value, "text/plain") != NULL;
+    }
+
+    metrics_snapshot_t m;
+    m.task_count = metrics_tasks(m.tasks, CONFIG_METRICS_MAX_TASKS);
+    am7_get_stats(&m.am7);
+    mqtt_get_stats(&m.mqtt);
+    m.uptime = esp_timer_get_time() / 1000000;
+    m.heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    m.heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    m.heap_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    return prom ? metrics_send_prom(req, &m) : metrics_send_json(req, &m);
+}
 
-    httpd_uri_t api_reboot_uri = {.uri = "/api/reboot", .method = HTTP_POST, .handler = api_reboot_handler};
-    ret = httpd_register_uri_handler(server, &api_reboot_uri);
-    ESP_LOGI(TAG, "Registered POST /api/reboot: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+void web_server_start(void)
+{
+    ESP_LOGI(TAG, "Starting web server...");
+    
+    // Web UI: bundle mapped from flash, or a SPIFFS image
+    esp_err_t ret = www_init();
+    if (ret != ESP_OK) {
+        return;
+    }
 
-    httpd_uri_t api_ota_uri = {.uri = "/api/ota", .method = HTTP_POST, .handler = ota_upload_handler};
-    ret = httpd_register_uri_handler(server, &api_ota_uri);
-    ESP_LOGI(TAG, "Registered /api/ota: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+    // Start HTTP server
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = CONFIG_HTTPD_MAX_URI_HANDLERS;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_open_sockets = CONFIG_HTTPD_MAX_OPEN_SOCKETS;
 
-    httpd_uri_t api_ota_spiffs_uri = {.uri = "/api/ota/spiffs", .method = HTTP_POST, .handler = ota_spiffs_upload_handler};
-    ret = httpd_register_uri_handler(server, &api_ota_spiffs_uri);
-    ESP_LOGI(TAG, "Registered /api/ota/spiffs: %s", ret == ESP_OK ? "OK" : esp_err_to_name(ret));
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start HTTP server");
+        return;
+    }
 
-    // Wildcard handler for captive portal (must be last)
+    ret = register_routes();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register routes: %s", esp_err_to_name(ret));
+        httpd_stop(server);
+        server = NULL;
+        return;
+    }
     if (wifi_is_ap_mode()) {
-        httpd_uri_t wildcard_uri = {.uri = "/*", .method = HTTP_GET, .handler = captive_portal_handler};
-        httpd_register_uri_handler(server, &wildcard_uri);
-        ESP_LOGI(TAG, "Captive portal active - wildcard redirect enabled");
+        ESP_LOGI(TAG, "Captive portal active - unknown URLs redirect to /setup");
     }
 
+    live_sent = xSemaphoreCreateBinary();
+    xTaskCreate(live_task, "live_task", 4096, NULL, 4, NULL);
+
     ESP_LOGI(TAG, "Web server started");
 }
@@ -0,0 +1,348 @@
+#include "www.h"
+#include "spiffs.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "WWW";
+
+#define WWW_MAGIC 0x42575757u   // "WWWB"
+#define WWW_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t total_size;
+} www_header_t;
+
+_Static_assert(sizeof(www_header_t) == 12, "bundle header layout");
+_Static_assert(sizeof(www_entry_t) == 64, "bundle entry layout");
+
+// Index and data straight from mapped flash, or (fallback) an index loaded
+// from a bundle file in SPIFFS
+static const www_entry_t *entries = NULL;
+static uint16_t entry_count = 0;
+static const uint8_t *mapped = NULL;
+static esp_partition_mmap_handle_t map_handle;
+static www_entry_t *loaded = NULL;
+static int active_slot = -1;   // slot the mapping comes from, -1 when not mapped
+
+// Requests reading the bundle or SPIFFS right now (www_enter/www_leave), on
+// any httpd or worker task. Once closed no new ones start, so the storage can
+// be pulled after the count drops to zero.
+static portMUX_TYPE users_lock = portMUX_INITIALIZER_UNLOCKED;
+static int users = 0;
+static bool closed = false;
+
+static bool header_valid(const www_header_t *hdr, uint32_t limit)
+{
+    return hdr->magic == WWW_MAGIC && hdr->version == WWW_VERSION && hdr->count > 0 &&
+           hdr->count <= CONFIG_WWW_MAX_FILES &&
+           hdr->total_size >= sizeof(*hdr) + hdr->count * sizeof(www_entry_t) && hdr->total_size <= limit;
+}
+
+static bool index_valid(const www_entry_t *table, uint16_t count, uint32_t total_size)
+{
+    for (uint16_t i = 0; i < count; i++) {
+        if (!memchr(table[i].path, '\0', sizeof(table[i].path)) ||
+            !memchr(table[i].etag, '\0', sizeof(table[i].etag)) ||
+            table[i].offset > total_size || table[i].size > total_size - table[i].offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The partition is split into two slots, each holding one bundle (what
+// spiffs_image builds now). An update is written to the slot not in use and
+// its header sector last; once that is in place the other slot's header is
+// erased. The first slot with a valid header is the one served, so an
+// interrupted update leaves the old bundle, and an image flashed at the
+// partition start over a stale second slot wins.
+static const esp_partition_t *www_partition(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_WWW_PARTITION_LABEL);
+}
+
+static uint32_t slot_size(const esp_partition_t *part)
+{
+    return (part->size / 2) & ~(WWW_SECTOR_SIZE - 1);
+}
+
+static esp_err_t www_map_slot(const esp_partition_t *part, int slot)
+{
+    uint32_t base_offset = slot * slot_size(part);
+    www_header_t hdr;
+    if (esp_partition_read(part, base_offset, &hdr, sizeof(hdr)) != ESP_OK || !header_valid(&hdr, slot_size(part))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *base;
+    esp_err_t ret = esp_partition_mmap(part, base_offset, hdr.total_size, ESP_PARTITION_MMAP_DATA, &base, &map_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map bundle (%s)", esp_err_to_name(ret));
+        return ret;
+    }
+    const www_entry_t *table = (const www_entry_t *)((const uint8_t *)base + sizeof(hdr));
+    if (!index_valid(table, hdr.count, hdr.total_size)) {
+        ESP_LOGE(TAG, "Invalid bundle index");
+        esp_partition_munmap(map_handle);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    mapped = base;
+    entries = table;
+    entry_count = hdr.count;
+    active_slot = slot;
+    ESP_LOGI(TAG, "Bundle mapped from slot %d: %u files, %lu bytes", slot, entry_count,
+             (unsigned long)hdr.total_size);
+    return ESP_OK;
+}
+
+static esp_err_t www_map(void)
+{
+    const esp_partition_t *part = www_partition();
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (int slot = 0; slot < 2; slot++) {
+        if (www_map_slot(part, slot) == ESP_OK) {
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Older images: a SPIFFS file system holding www.bin, or just plain files
+static void www_load_file(void)
+{
+    FILE *f = fopen(CONFIG_WWW_BUNDLE_PATH, "rb");
+    if (!f) {
+        ESP_LOGW(TAG, "No bundle, serving plain files from SPIFFS");
+        return;
+    }
+
+    www_header_t hdr;
+    www_entry_t *table = NULL;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || !header_valid(&hdr, UINT32_MAX) ||
+        !(table = malloc(hdr.count * sizeof(www_entry_t))) ||
+        fread(table, sizeof(www_entry_t), hdr.count, f) != hdr.count ||
+        !index_valid(table, hdr.count, hdr.total_size)) {
+        ESP_LOGE(TAG, "Invalid bundle in %s", CONFIG_WWW_BUNDLE_PATH);
+        free(table);
+        fclose(f);
+        return;
+    }
+    fclose(f);
+
+    loaded = table;
+    entries = table;
+    entry_count = hdr.count;
+    ESP_LOGI(TAG, "Bundle in SPIFFS: %u files, %lu bytes", entry_count, (unsigned long)hdr.total_size);
+}
+
+esp_err_t www_init(void)
+{
+    if (entries) {
+        return ESP_OK;
+    }
+    if (www_map() == ESP_OK) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = spiffs_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    www_load_file();
+    return ESP_OK;
+}
+
+bool www_enter(void)
+{
+    portENTER_CRITICAL(&users_lock);
+    bool open = !closed;
+    if (open) {
+        users++;
+    }
+    portEXIT_CRITICAL(&users_lock);
+    return open;
+}
+
+void www_leave(void)
+{
+    portENTER_CRITICAL(&users_lock);
+    users--;
+    portEXIT_CRITICAL(&users_lock);
+}
+
+// Turn new requests away and wait for those still serving
+static void www_close(void)
+{
+    portENTER_CRITICAL(&users_lock);
+    closed = true;
+    portEXIT_CRITICAL(&users_lock);
+    for (;;) {
+        portENTER_CRITICAL(&users_lock);
+        int busy = users;
+        portEXIT_CRITICAL(&users_lock);
+        if (busy == 0) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+void www_release(void)
+{
+    www_close();
+    // The mapping itself stays, unused until the restart
+    entries = NULL;
+    entry_count = 0;
+    mapped = NULL;
+    active_slot = -1;
+    if (loaded) {
+        free(loaded);
+        loaded = NULL;
+    }
+    spiffs_deinit();
+}
+
+const www_entry_t *www_find(const char *path)
+{
+    // Entries are sorted by path (tools/www_pack.py)
+    int lo = 0, hi = (int)entry_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(path, entries[mid].path);
+        if (cmp == 0) {
+            return &entries[mid];
+        }
+        if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+const char *www_content_type(const char *path)
+{
+    static const struct {
+        const char *ext;
+        const char *type;
+    } types[] = {
+        {".html", "text/html"},
+        {".js", "application/javascript"},
+        {".css", "text/css"},
+        {".json", "application/json"},
+        {".svg", "image/svg+xml"},
+        {".png", "image/png"},
+        {".ico", "image/x-icon"},
+    };
+    const char *ext = strrchr(path, '.');
+    if (ext) {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+            if (strcmp(ext, types[i].ext) == 0) {
+                return types[i].type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+const void *www_data(const www_entry_t *entry)
+{
+    return mapped ? mapped + entry->offset : NULL;
+}
+
+esp_err_t www_send(const www_entry_t *entry, www_send_fn fn, void *ctx)
+{
+    if (mapped) {
+        return fn(ctx, (const char *)mapped + entry->offset, entry->size);
+    }
+
+    FILE *f = fopen(CONFIG_WWW_BUNDLE_PATH, "rb");
+    if (!f) {
+        return ESP_FAIL;
+    }
+    if (fseek(f, entry->offset, SEEK_SET) != 0) {
+        fclose(f);
+        return ESP_FAIL;
+    }
+
+    char buf[CONFIG_WWW_CHUNK_SIZE];
+    uint32_t left = entry->size;
+    esp_err_t ret = ESP_OK;
+    while (left > 0 && ret == ESP_OK) {
+        size_t n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), f);
+        if (n == 0) {
+            ret = ESP_FAIL;
+            break;
+        }
+        ret = fn(ctx, buf, n);
+        left -= n;
+    }
+    fclose(f);
+    return ret;
+}
+
+esp_err_t www_update_begin(www_slot_t *slot)
+{
+    const esp_partition_t *part = www_partition();
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    int target = active_slot == 0 ? 1 : 0;
+    slot->part = part;
+    slot->offset = target * slot_size(part);
+    slot->size = slot_size(part);
+    return ESP_OK;
+}
+
+esp_err_t www_update_open(void)
+{
+    // Without a mapped bundle the partition may hold a mounted SPIFFS image,
+    // which the update overwrites
+    if (active_slot < 0) {
+        www_release();
+    }
+    return ESP_OK;
+}
+
+bool www_head_valid(const void *head, size_t len, uint32_t total_size)
+{
+    const www_header_t *hdr = head;
+    if (len < sizeof(*hdr) || !header_valid(hdr, total_size ? total_size : UINT32_MAX) ||
+        (total_size && hdr->total_size != total_size) ||
+        len < sizeof(*hdr) + hdr->count * sizeof(www_entry_t)) {
+        return false;
+    }
+    return index_valid((const www_entry_t *)(hdr + 1), hdr->count, hdr->total_size);
+}
+
+esp_err_t www_update_commit(const www_slot_t *slot, const void *head, size_t len)
+{
+    esp_err_t ret = esp_partition_erase_range(slot->part, slot->offset, WWW_SECTOR_SIZE);
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(slot->part, slot->offset, head, len);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // The new slot is complete; retire the other one so it is not picked.
+    // That erases the index being served, so requests are turned away first;
+    // the mapping and state stay as they are until the restart.
+    uint32_t other = slot->offset == 0 ? slot->size : 0;
+    www_close();
+    return esp_partition_erase_range(slot->part, other, WWW_SECTOR_SIZE);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_partition.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Web UI bundle built by tools/www_pack.py from spiffs/: every file gzipped,
+// behind an index carrying a content hash per file that serves as its ETag.
+// The bundle is stored raw in one half (slot) of the "spiffs" partition and is
+// memory-mapped, so index lookups and responses read flash directly. Updates
+// go to the other slot, so a failed upload keeps the current one. Partitions
+// still holding a SPIFFS image from an older build are mounted instead,
+// serving a www.bin in it or else the plain files.
+
+typedef struct {
+    char path[32];        // "/app.js"
+    char etag[20];        // 16 hex digits of the SHA-256 of the gzip data
+    uint32_t offset;      // from the start of the bundle
+    uint32_t size;        // gzip bytes
+    uint32_t raw_size;
+} www_entry_t;
+
+esp_err_t www_init(void);   // maps the bundle, or mounts SPIFFS
+void www_release(void);     // before the partition is rewritten; serving stops
+
+// Bracket every use of the functions below. www_enter is false once the
+// bundle is being released; the request should then be turned away.
+bool www_enter(void);
+void www_leave(void);
+
+// Bundle entry for a request path, NULL when it is not bundled
+const www_entry_t *www_find(const char *path);
+
+// MIME type by file extension
+const char *www_content_type(const char *path);
+
+// Entry data in mapped flash, NULL when the bundle is read from SPIFFS
+const void *www_data(const www_entry_t *entry);
+
+// Hand an entry's gzip data to fn: in one piece from mapped flash, else read
+// from SPIFFS in pieces of up to CONFIG_WWW_CHUNK_SIZE
+typedef esp_err_t (*www_send_fn)(void *ctx, const char *data, size_t len);
+esp_err_t www_send(const www_entry_t *entry, www_send_fn fn, void *ctx);
+
+// Bundle update: www_update_begin picks the slot not being served. Once the
+// first sector (header and index) has been received and checked, the caller
+// calls www_update_open before touching flash: with an older SPIFFS image in
+// the partition that stops serving it, as slot 0 overlaps it. The caller then
+// erases and writes everything but the first sector, checks the image and
+// hands that sector to www_update_commit, which writes it, waits for requests
+// serving the old bundle to finish, turns new ones away and invalidates it.
+// The new one is served after a restart.
+#define WWW_SECTOR_SIZE 4096   // flash erase unit, also the part held back for commit
+
+typedef struct {
+    const esp_partition_t *part;
+    uint32_t offset;      // of the slot in the partition, sector-aligned
+    uint32_t size;        // largest bundle that fits
+} www_slot_t;
+
+esp_err_t www_update_begin(www_slot_t *slot);
+esp_err_t www_update_open(void);
+// True when the first len bytes of an image hold a valid header and index
+// for a bundle of total_size bytes (0: any size)
+bool www_head_valid(const void *head, size_t len, uint32_t total_size);
+esp_err_t www_update_commit(const www_slot_t *slot, const void *head, size_t len);
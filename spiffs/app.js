@@ -9,6 +9,8 @@ function formatUptime(sec) {
   return `${h.toString().padStart(2,'0')}:${m.toString().padStart(2,'0')}:${s.toString().padStart(2,'0')}`;
 }
 
+let status = {};
+
 async function refresh() {
   try {
     const r = await fetch("/api/status");
@@ -16,37 +18,51 @@ async function refresh() {
       console.error("Status fetch failed:", r.status);
       return;
     }
-    const s = await r.json();
-
-    document.getElementById("version").textContent = "v" + (s.version || "?");
-    setStatus("am7", s.am7?.connected, s.am7?.connected ? "Online" : "Offline");
-    setStatus("mqtt", s.mqtt?.connected, s.mqtt?.connected ? "Connected" : "Disconnected");
-    setStatus("wifi", s.wifi?.connected, s.wifi?.connected ? "Connected" : "Disconnected");
-
-    // Display WiFi signal strength
-    const rssi = s.wifi?.rssi || 0;
-    let signalQuality = "Unknown";
-    if (rssi < -100) {
-      signalQuality = "Very Weak ≡";
-    } else if (rssi < -80) {
-      signalQuality = "Weak ≡≡";
-    } else if (rssi < -60) {
-      signalQuality = "Good ≡≡≡";
-    } else if (rssi < -30) {
-      signalQuality = "Excellent ≡≡≡≡";
-    } else {
-      signalQuality = "Strong ≡≡≡≡≡";
-    }
-    document.getElementById("rssi").textContent = signalQuality + " (" + rssi + " dBm)";
-
-    document.getElementById("interval").textContent = (s.interval || 0) + " sec";
-    document.getElementById("uptime").textContent = formatUptime(s.uptime || 0);
-
+    status = await r.json();
+    render(status);
   } catch(e) { 
     console.error("Status fetch exception:", e);
   }
 }
 
+function render(s) {
+  document.getElementById("version").textContent = "v" + (s.version || "?");
+  setStatus("am7", s.am7?.connected, s.am7?.connected ? "Online" : "Offline");
+  setStatus("mqtt", s.mqtt?.connected, s.mqtt?.connected ? "Connected" : "Disconnected");
+  setStatus("wifi", s.wifi?.connected, s.wifi?.connected ? "Connected" : "Disconnected");
+
+  // Display WiFi signal strength
+  const rssi = s.wifi?.rssi || 0;
+  let signalQuality = "Unknown";
+  if (rssi < -100) {
+    signalQuality = "Very Weak ≡";
+  } else if (rssi < -80) {
+    signalQuality = "Weak ≡≡";
+  } else if (rssi < -60) {
+    signalQuality = "Good ≡≡≡";
+  } else if (rssi < -30) {
+    signalQuality = "Excellent ≡≡≡≡";
+  } else {
+    signalQuality = "Strong ≡≡≡≡≡";
+  }
+  document.getElementById("rssi").textContent = signalQuality + " (" + rssi + " dBm)";
+
+  document.getElementById("interval").textContent = (s.interval || 0) + " sec";
+  document.getElementById("uptime").textContent = formatUptime(s.uptime || 0);
+
+  document.getElementById("crash").style.display = s.crash ? "" : "none";
+  if (s.crash) {
+    document.getElementById("crashTask").textContent = s.crash.task;
+    document.getElementById("crashPc").textContent = s.crash.pc;
+  }
+}
+
+function eraseCoredump() {
+  if (confirm('Erase the stored core dump?')) {
+    fetch('/api/coredump/erase', { method: 'POST' }).then(() => refresh());
+  }
+}
+
 function rebootDevice() {
   if (confirm('Are you sure you want to reboot the device?')) {
     fetch('/api/reboot', { method: 'POST' })
@@ -57,5 +73,20 @@ function rebootDevice() {
   }
 }
 
-setInterval(refresh, 2000);
-refresh();
+liveConnect({
+  poll: refresh,
+  onOpen: refresh,
+  onMessage: (msg) => {
+    if (msg.type !== "status") return;
+    delete msg.type;
+    render(liveMerge(status, msg));
+  }
+});
+
+// Status deltas only arrive on change, so uptime ticks locally in between
+setInterval(() => {
+  if (status.uptime !== undefined) {
+    status.uptime++;
+    document.getElementById("uptime").textContent = formatUptime(status.uptime);
+  }
+}, 1000);
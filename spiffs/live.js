@@ -0,0 +1,55 @@
+// Live updates over the /ws WebSocket. onMessage(msg) gets every pushed delta,
+// onOpen() runs after each (re)connect so the page can resync over REST.
+// While the socket is down, poll() runs every pollMs as the fallback and the
+// socket is retried every 10 s.
+function liveConnect({ onMessage, onOpen, poll, pollMs = 2000 }) {
+  let timer = null;
+
+  function startPolling() {
+    if (timer) return;
+    poll();
+    timer = setInterval(poll, pollMs);
+  }
+
+  function stopPolling() {
+    clearInterval(timer);
+    timer = null;
+  }
+
+  function connect() {
+    if (!("WebSocket" in window) || location.protocol === "file:") {
+      startPolling();
+      return;
+    }
+    const ws = new WebSocket(`ws://${location.host}/ws`);
+    ws.onopen = () => {
+      stopPolling();
+      if (onOpen) onOpen();
+    };
+    ws.onmessage = (e) => {
+      try {
+        onMessage(JSON.parse(e.data));
+      } catch (err) {
+        console.error("Live message error:", err);
+      }
+    };
+    ws.onclose = () => {
+      startPolling();
+      setTimeout(connect, 10000);
+    };
+  }
+
+  connect();
+}
+
+// Merge a partial status object into the full one, recursively
+function liveMerge(target, delta) {
+  for (const [k, v] of Object.entries(delta)) {
+    if (v && typeof v === "object" && !Array.isArray(v)) {
+      target[k] = liveMerge(target[k] || {}, v);
+    } else {
+      target[k] = v;
+    }
+  }
+  return target;
+}
@@ -184,42 +184,117 @@ async function refreshSensor() {
       }
       s = await r.json();
     }
-
-    document.getElementById("version").textContent = "v" + (s.version || "?");
-    document.getElementById("last_update").textContent = (s.last_rx_sec || 0) + " sec ago";
-
-    const d = s.data || {};
-    document.getElementById("pm25").textContent = formatValue(d.pm25, "", 0);
-    document.getElementById("pm10").textContent = formatValue(d.pm10, "", 0);
-    document.getElementById("co2").textContent = formatValue(d.co2, "", 0);
-    document.getElementById("tvoc").textContent = formatValue(d.tvoc, "", 2);
-    document.getElementById("hcho").textContent = formatValue(d.hcho, "", 2);
-    updateAirQualityStatus("pm25", d.pm25);
-    updateAirQualityStatus("pm10", d.pm10);
-    updateAirQualityStatus("co2", d.co2);
-    updateAirQualityStatus("tvoc", d.tvoc);
-    updateAirQualityStatus("hcho", d.hcho);
-    drawGauge("gauge-pm25", d.pm25, 100, 35, 55);
-    drawGauge("gauge-pm10", d.pm10, 150, 50, 100);
-    drawGauge("gauge-co2", d.co2, 2000, 1000, 1500);
-    drawGauge("gauge-tvoc", d.tvoc, 1.0, 0.3, 0.6);
-    drawGauge("gauge-hcho", d.hcho, 0.5, 0.1, 0.3);
-    document.getElementById("temp").textContent = formatValue(d.temp, "", 1);
-    document.getElementById("humidity").textContent = formatValue(d.humidity, "", 1);
-
-    const batteryStatus = d.battery_status === 1 ? "Charging" : (d.battery_status === 0 ? "Battery" : "–");
-    document.getElementById("battery_status").textContent = batteryStatus;
-    document.getElementById("battery_level").textContent = formatValue(d.battery_level, "", 0);
-    document.getElementById("pc03").textContent = formatValue(d.pc03, "", 0);
-    document.getElementById("pc05").textContent = formatValue(d.pc05, "", 0);
-    document.getElementById("pc10").textContent = formatValue(d.pc10, "", 0);
-    document.getElementById("pc25").textContent = formatValue(d.pc25, "", 0);
-    document.getElementById("pc50").textContent = formatValue(d.pc50, "", 0);
-    document.getElementById("pc100").textContent = formatValue(d.pc100, "", 0);
+    renderSensor(s);
   } catch (e) {
     console.error("Sensor fetch exception:", e);
   }
 }
 
-setInterval(refreshSensor, 2000);
-refreshSensor();
+function renderSensor(s) {
+  if (s.version) {
+    document.getElementById("version").textContent = "v" + s.version;
+  }
+  document.getElementById("last_update").textContent = (s.last_rx_sec || 0) + " sec ago";
+
+  const d = s.data || {};
+  document.getElementById("pm25").textContent = formatValue(d.pm25, "", 0);
+  document.getElementById("pm10").textContent = formatValue(d.pm10, "", 0);
+  document.getElementById("co2").textContent = formatValue(d.co2, "", 0);
+  document.getElementById("tvoc").textContent = formatValue(d.tvoc, "", 2);
+  document.getElementById("hcho").textContent = formatValue(d.hcho, "", 2);
+  updateAirQualityStatus("pm25", d.pm25);
+  updateAirQualityStatus("pm10", d.pm10);
+  updateAirQualityStatus("co2", d.co2);
+  updateAirQualityStatus("tvoc", d.tvoc);
+  updateAirQualityStatus("hcho", d.hcho);
+  drawGauge("gauge-pm25", d.pm25, 100, 35, 55);
+  drawGauge("gauge-pm10", d.pm10, 150, 50, 100);
+  drawGauge("gauge-co2", d.co2, 2000, 1000, 1500);
+  drawGauge("gauge-tvoc", d.tvoc, 1.0, 0.3, 0.6);
+  drawGauge("gauge-hcho", d.hcho, 0.5, 0.1, 0.3);
+  document.getElementById("temp").textContent = formatValue(d.temp, "", 1);
+  document.getElementById("humidity").textContent = formatValue(d.humidity, "", 1);
+
+  const batteryStatus = d.battery_status === 1 ? "Charging" : (d.battery_status === 0 ? "Battery" : "–");
+  document.getElementById("battery_status").textContent = batteryStatus;
+  document.getElementById("battery_level").textContent = formatValue(d.battery_level, "", 0);
+  document.getElementById("pc03").textContent = formatValue(d.pc03, "", 0);
+  document.getElementById("pc05").textContent = formatValue(d.pc05, "", 0);
+  document.getElementById("pc10").textContent = formatValue(d.pc10, "", 0);
+  document.getElementById("pc25").textContent = formatValue(d.pc25, "", 0);
+  document.getElementById("pc50").textContent = formatValue(d.pc50, "", 0);
+  document.getElementById("pc100").textContent = formatValue(d.pc100, "", 0);
+}
+
+// History chart: min/max band with the average line, one request per refresh
+function drawHistory(h) {
+  const canvas = document.getElementById("history-chart");
+  const ctx = canvas.getContext("2d");
+  canvas.width = canvas.clientWidth * window.devicePixelRatio;
+  canvas.height = canvas.clientHeight * window.devicePixelRatio;
+  ctx.clearRect(0, 0, canvas.width, canvas.height);
+
+  const values = h.min.concat(h.max).filter(v => v !== null);
+  if (!h.count || values.length === 0) {
+    ctx.fillStyle = "#999";
+    ctx.font = (14 * window.devicePixelRatio) + "px sans-serif";
+    ctx.fillText("No data yet", 10 * window.devicePixelRatio, 24 * window.devicePixelRatio);
+    return;
+  }
+
+  let lo = Math.min(...values), hi = Math.max(...values);
+  if (hi === lo) { hi += 1; lo -= 1; }
+  const pad = 16 * window.devicePixelRatio;
+  const x = i => pad + (canvas.width - 2 * pad) * (h.count > 1 ? i / (h.count - 1) : 0.5);
+  const y = v => canvas.height - pad - (canvas.height - 2 * pad) * (v - lo) / (hi - lo);
+
+  ctx.fillStyle = "rgba(2, 119, 189, 0.15)";
+  for (let i = 0; i < h.count; i++) {
+    if (h.min[i] === null) continue;
+    const w = Math.max(1, (canvas.width - 2 * pad) / h.count);
+    ctx.fillRect(x(i) - w / 2, y(h.max[i]), w, Math.max(1, y(h.min[i]) - y(h.max[i])));
+  }
+
+  ctx.strokeStyle = "#0277bd";
+  ctx.lineWidth = 2 * window.devicePixelRatio;
+  ctx.beginPath();
+  let drawing = false;
+  for (let i = 0; i < h.count; i++) {
+    if (h.avg[i] === null) { drawing = false; continue; }
+    if (drawing) ctx.lineTo(x(i), y(h.avg[i])); else ctx.moveTo(x(i), y(h.avg[i]));
+    drawing = true;
+  }
+  ctx.stroke();
+
+  ctx.fillStyle = "#666";
+  ctx.font = (11 * window.devicePixelRatio) + "px sans-serif";
+  ctx.fillText(hi, 2, pad);
+  ctx.fillText(lo, 2, canvas.height - 4);
+}
+
+async function refreshHistory() {
+  if (location.protocol === "file:") return;
+  const field = document.getElementById("history-field").value;
+  const span = parseInt(document.getElementById("history-range").value);
+  try {
+    // Ask for the span only; the device answers relative to its own clock
+    const r = await fetch(`/api/history?field=${field}&res=${Math.ceil(span / 1440)}&span=${span}`);
+    if (!r.ok) return;
+    drawHistory(await r.json());
+  } catch (e) {
+    console.error("History fetch exception:", e);
+  }
+}
+
+document.getElementById("history-field").addEventListener("change", refreshHistory);
+document.getElementById("history-range").addEventListener("change", refreshHistory);
+setInterval(refreshHistory, 60000);
+refreshHistory();
+
+liveConnect({
+  poll: refreshSensor,
+  onOpen: refreshSensor,
+  onMessage: (msg) => {
+    if (msg.type === "sensor") renderSensor(msg);
+  }
+});
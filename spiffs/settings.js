@@ -29,14 +29,46 @@ async function loadSettings() {
     document.getElementById("topic").value = s.mqtt?.topic || "airmaster/sensors";
     document.getElementById("device_name").value = s.device_name || "AirMaster Gateway";
     document.getElementById("hostname").value = s.hostname || "sh-airmaster-adapter-esp";
+    document.getElementById("ota_url").value = s.ota_url || "";
     document.getElementById("interval").value = s.interval || 10;
+    document.getElementById("min_interval").value = s.min_interval || 0;
     document.getElementById("ha_discovery").checked = s.ha_discovery !== false;
+    document.getElementById("publish_mode").value = s.publish_mode || "full";
+    document.getElementById("topic_layout").value = s.topic_layout || "json";
+    document.getElementById("keyframe_interval").value = s.keyframe_interval || 300;
+    renderDeadbands(s.deadband || {});
 
   } catch(e) { 
     showError("Failed to load settings: " + e.message);
   }
 }
 
+// One row per field: absolute band and relative band (percent of last value)
+function renderDeadbands(bands) {
+  const box = document.getElementById("deadbands");
+  box.innerHTML = "";
+  for (const [name, b] of Object.entries(bands)) {
+    const row = document.createElement("div");
+    row.className = "row deadband";
+    row.dataset.field = name;
+    row.innerHTML = "<label>" + name + " deadband (abs / %)</label>" +
+      "<input type='number' class='db-abs' step='any' min='0' value='" + b.abs + "'>" +
+      "<input type='number' class='db-rel' step='any' min='0' value='" + (b.rel * 100) + "'>";
+    box.appendChild(row);
+  }
+}
+
+function collectDeadbands() {
+  const bands = {};
+  document.querySelectorAll("#deadbands .deadband").forEach(row => {
+    bands[row.dataset.field] = {
+      abs: parseFloat(row.querySelector(".db-abs").value) || 0,
+      rel: (parseFloat(row.querySelector(".db-rel").value) || 0) / 100
+    };
+  });
+  return bands;
+}
+
 async function saveSettings(event) {
   event.preventDefault();
   const btn = document.querySelector("button[type='submit']");
@@ -56,8 +88,14 @@ async function saveSettings(event) {
     },
     device_name: document.getElementById("device_name").value,
     hostname: document.getElementById("hostname").value,
+    ota_url: document.getElementById("ota_url").value,
     interval: parseInt(document.getElementById("interval").value),
-    ha_discovery: document.getElementById("ha_discovery").checked
+    min_interval: parseInt(document.getElementById("min_interval").value),
+    ha_discovery: document.getElementById("ha_discovery").checked,
+    publish_mode: document.getElementById("publish_mode").value,
+    topic_layout: document.getElementById("topic_layout").value,
+    keyframe_interval: parseInt(document.getElementById("keyframe_interval").value),
+    deadband: collectDeadbands()
   };
 
   try {
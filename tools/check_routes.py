@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Check that the route table in main/webserver.c is sorted.
+
+Usage: check_routes.py WEBSERVER_C
+
+The dispatcher binary-searches routes[] by uri, then method, so the table
+must be in strcmp() order of uri and http_parser enum order of method. Run
+by main/CMakeLists.txt before webserver.c is compiled; exits non-zero (and
+fails the build) naming the first entry out of place.
+"""
+import re
+import sys
+
+# http_parser's enum http_method values, which httpd_method_t is
+METHODS = {"HTTP_DELETE": 0, "HTTP_GET": 1, "HTTP_HEAD": 2, "HTTP_POST": 3,
+           "HTTP_PUT": 4, "HTTP_CONNECT": 5, "HTTP_OPTIONS": 6, "HTTP_TRACE": 7,
+           "HTTP_PATCH": 28}
+
+TABLE = re.compile(r"static const route_t routes\[\] = \{(.*?)\n\};", re.S)
+ENTRY = re.compile(r'\{\s*"([^"]*)"\s*,\s*(HTTP_\w+)\s*,')
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__.strip().splitlines()[2])
+    with open(sys.argv[1], encoding="utf-8") as f:
+        src = f.read()
+    table = TABLE.search(src)
+    if not table:
+        sys.exit("%s: route table not found" % sys.argv[1])
+
+    entries = []
+    for uri, method in ENTRY.findall(table.group(1)):
+        if method not in METHODS:
+            sys.exit("%s: unknown method %s for %s" % (sys.argv[1], method, uri))
+        # strcmp() compares bytes
+        entries.append((uri.encode(), METHODS[method], uri, method))
+    if not entries:
+        sys.exit("%s: route table is empty" % sys.argv[1])
+
+    for prev, cur in zip(entries, entries[1:]):
+        if cur[:2] <= prev[:2]:
+            sys.exit("%s: route table out of order: %s %s must come before %s %s"
+                     % (sys.argv[1], cur[3], cur[2], prev[3], prev[2]))
+
+
+if __name__ == "__main__":
+    main()
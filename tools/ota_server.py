@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Serve firmware for pull updates (main/ota_pull.c) from a local machine.
+
+Usage: ota_server.py [--port N] [--drop-after BYTES] [--no-range] FILE VERSION
+
+Serves FILE (an image, a .patch from am7_delta, or either gzipped) and a
+/manifest.json describing it, so the device's update URL can be set to
+http://<this host>:<port>/manifest.json. Range requests are answered with 206
+so interrupted downloads resume. For testing:
+  --drop-after BYTES  close each connection after sending that many bytes
+  --no-range          ignore Range and always send the whole file (200)
+"""
+import argparse
+import hashlib
+import http.server
+import json
+import os
+import re
+
+RANGE = re.compile(r"bytes=(\d+)-(\d*)$")
+
+
+def make_handler(args, data, manifest):
+    name = "/" + os.path.basename(args.file)
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path == "/manifest.json":
+                body = json.dumps(manifest, indent=2).encode()
+                self.send_response(200)
+                self.send_header("Content-Type", "application/json")
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+            elif self.path == name:
+                self.send_file()
+            else:
+                self.send_error(404)
+
+        def send_file(self):
+            start, end = 0, len(data) - 1
+            m = RANGE.match(self.headers.get("Range", ""))
+            if m and not args.no_range:
+                start = int(m.group(1))
+                if m.group(2):
+                    end = min(int(m.group(2)), end)
+                if start > end:
+                    self.send_response(416)
+                    self.send_header("Content-Range", "bytes */%d" % len(data))
+                    self.end_headers()
+                    return
+                self.send_response(206)
+                self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, len(data)))
+            else:
+                self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(end + 1 - start))
+            self.send_header("Accept-Ranges", "none" if args.no_range else "bytes")
+            self.end_headers()
+
+            body = data[start:end + 1]
+            if args.drop_after is not None and args.drop_after < len(body):
+                self.wfile.write(body[:args.drop_after])
+                self.wfile.flush()
+                self.close_connection = True
+                self.log_message("dropped after %d bytes", args.drop_after)
+                return
+            self.wfile.write(body)
+
+    return Handler
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file")
+    ap.add_argument("version", help="X.Y.Z, compared with the device's VERSION_STRING")
+    ap.add_argument("--port", type=int, default=8000)
+    ap.add_argument("--drop-after", type=int, metavar="BYTES")
+    ap.add_argument("--no-range", action="store_true")
+    args = ap.parse_args()
+
+    if not re.fullmatch(r"\d+\.\d+\.\d+", args.version):
+        ap.error("version must be X.Y.Z")
+    with open(args.file, "rb") as f:
+        data = f.read()
+    manifest = {
+        "version": args.version,
+        "url": os.path.basename(args.file),
+        "size": len(data),
+        "sha256": hashlib.sha256(data).hexdigest(),
+    }
+    print(json.dumps(manifest, indent=2))
+
+    server = http.server.ThreadingHTTPServer(("", args.port), make_handler(args, data, manifest))
+    print("Manifest at http://<this host>:%d/manifest.json" % args.port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
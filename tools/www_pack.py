@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Pack the web UI into one gzip bundle with an index (main/www.c maps it).
+
+Usage: www_pack.py SRC_DIR OUT_FILE
+
+Every file in SRC_DIR is gzipped (deterministically, so unchanged files keep
+their ETag). References to bundled .js/.css files in HTML get a ?v=<etag>
+suffix, which the firmware answers with immutable caching.
+
+Layout, little-endian:
+  header  magic "WWWB", u16 version, u16 count, u32 total size
+  entries count x {char path[32], char etag[20], u32 offset, u32 size, u32 raw_size}
+  data    gzip streams, each starting on a 4-byte boundary
+"""
+import gzip
+import hashlib
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"WWWB"
+VERSION = 1
+HEADER = struct.Struct("<4sHHI")
+ENTRY = struct.Struct("<32s20sIII")
+PATH_MAX = 31
+ETAG_LEN = 16
+
+
+def gz(data):
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def etag(data):
+    return hashlib.sha256(data).hexdigest()[:ETAG_LEN]
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    src, out = sys.argv[1], sys.argv[2]
+
+    files = {}
+    for name in sorted(os.listdir(src)):
+        path = os.path.join(src, name)
+        if os.path.isfile(path) and not name.startswith("."):
+            if len(name) + 1 > PATH_MAX:
+                sys.exit(f"{name}: name too long")
+            with open(path, "rb") as f:
+                files["/" + name] = f.read()
+
+    # Assets first, so HTML can reference their final ETags
+    packed = {}
+    for path, data in files.items():
+        if not path.endswith(".html"):
+            packed[path] = (gz(data), len(data))
+
+    def versioned(match):
+        ref = match.group(2)
+        asset = packed.get("/" + ref)
+        if asset is None:
+            return match.group(0)
+        return f'{match.group(1)}"{ref}?v={etag(asset[0])}"'
+
+    for path, data in files.items():
+        if path.endswith(".html"):
+            text = re.sub(r'((?:src|href)=)"([^"/?#:]+\.(?:js|css))"', versioned, data.decode("utf-8"))
+            data = text.encode("utf-8")
+            packed[path] = (gz(data), len(data))
+
+    paths = sorted(packed)
+    offset = HEADER.size + ENTRY.size * len(paths)
+    index, blobs = [], []
+    for path in paths:
+        offset = (offset + 3) & ~3
+        blob, raw_size = packed[path]
+        index.append(ENTRY.pack(path.encode(), etag(blob).encode(), offset, len(blob), raw_size))
+        blobs.append((offset, blob))
+        offset += len(blob)
+
+    image = bytearray(HEADER.pack(MAGIC, VERSION, len(paths), offset))
+    image += b"".join(index)
+    for pos, blob in blobs:
+        image += b"\0" * (pos - len(image))
+        image += blob
+
+    os.makedirs(os.path.dirname(os.path.abspath(out)), exist_ok=True)
+    with open(out, "wb") as f:
+        f.write(image)
+
+    raw = sum(size for _, size in packed.values())
+    print(f"{out}: {len(paths)} files, {raw} -> {len(image)} bytes")
+
+
+if __name__ == "__main__":
+    main()
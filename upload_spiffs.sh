@@ -40,9 +40,11 @@ fi
 
 echo "Uploading SPIFFS to $IP..."
 
-# Upload SPIFFS image
+# Upload SPIFFS image; the device checks it against this hash
+SHA256=$(sha256sum build/spiffs.bin | cut -d' ' -f1)
 curl -sS -X POST http://$IP/api/ota/spiffs \
     -H "Content-Type: application/octet-stream" \
+    -H "X-Content-SHA256: $SHA256" \
     --data-binary @build/spiffs.bin | jq .
 
 echo "✓ SPIFFS uploaded - device rebooting..."